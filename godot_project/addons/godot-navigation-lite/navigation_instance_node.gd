@@ -31,6 +31,12 @@ func _enter_tree():
 		preload("res://addons/godot-navigation-lite/detour_navigation_bootstrap.gd"), 
 		get_editor_interface().get_base_control().get_icon("Navigation", "EditorIcons")
 	)
+	add_custom_type(
+		"DetourCrowd",
+		"Node",
+		preload("res://addons/godot-navigation-lite/bin/detour_crowd.gdns"),
+		get_editor_interface().get_base_control().get_icon("Navigation", "EditorIcons")
+	)
 	navmesh = preload("res://addons/godot-navigation-lite/bin/detour_navigation_mesh_cached.gdns")
 
 	var editor_interface = get_editor_interface()
@@ -76,6 +82,7 @@ func _exit_tree():
 	_navigation_menu_button = null
 	
 	remove_custom_type("DetourNavigation")
+	remove_custom_type("DetourCrowd")
 
 
 func _on_navigation_menu_id_pressed(id):
@@ -0,0 +1,148 @@
+#include <algorithm>
+#include "area_volume.h"
+#include "navigation.h"
+
+using namespace godot;
+
+static const float DEFAULT_HEIGHT = 2.f;
+static const int DEFAULT_AREA = 1;
+
+void DetourAreaVolume::_register_methods()
+{
+	register_method("_notification", &DetourAreaVolume::_notification);
+
+	register_property<DetourAreaVolume, PoolVector2Array>("polygon", &DetourAreaVolume::set_polygon, &DetourAreaVolume::get_polygon, PoolVector2Array());
+	register_property<DetourAreaVolume, float>("height", &DetourAreaVolume::set_height, &DetourAreaVolume::get_height, DEFAULT_HEIGHT);
+	register_property<DetourAreaVolume, int>("area", &DetourAreaVolume::set_area, &DetourAreaVolume::get_area, DEFAULT_AREA);
+}
+
+DetourAreaVolume::DetourAreaVolume()
+{
+}
+
+DetourAreaVolume::~DetourAreaVolume()
+{
+}
+
+void DetourAreaVolume::_init()
+{
+	height = DEFAULT_HEIGHT;
+	area = DEFAULT_AREA;
+	set_notify_transform(true);
+}
+
+void DetourAreaVolume::_notification(int p_what)
+{
+	switch (p_what)
+	{
+	case NOTIFICATION_ENTER_TREE:
+	case NOTIFICATION_TRANSFORM_CHANGED:
+	{
+		changed();
+	}
+	break;
+	case NOTIFICATION_EXIT_TREE:
+	{
+		DetourNavigation *navigation = find_navigation();
+		if (navigation != nullptr)
+		{
+			navigation->remove_area_volume(this);
+		}
+	}
+	break;
+	}
+}
+
+void DetourAreaVolume::set_polygon(PoolVector2Array p_polygon)
+{
+	polygon = p_polygon;
+	changed();
+}
+
+PoolVector2Array DetourAreaVolume::get_polygon()
+{
+	return polygon;
+}
+
+void DetourAreaVolume::set_height(float p_height)
+{
+	height = std::max(p_height, 0.f);
+	changed();
+}
+
+float DetourAreaVolume::get_height()
+{
+	return height;
+}
+
+void DetourAreaVolume::set_area(int p_area)
+{
+	area = std::min(std::max(p_area, 0), (int)RC_WALKABLE_AREA);
+	changed();
+}
+
+int DetourAreaVolume::get_area()
+{
+	return area;
+}
+
+/**
+ * The volume with global points, bounds cover the transformed points.
+ * Generators move it into the space of their tiles.
+ */
+AreaVolume DetourAreaVolume::get_area_volume()
+{
+	AreaVolume volume;
+	volume.id = get_instance_id();
+	volume.area = (unsigned char)area;
+
+	Transform transform = get_global_transform();
+
+	PoolVector2Array::Read points = polygon.read();
+	for (int i = 0; i < polygon.size(); i++)
+	{
+		Vector3 point = transform.xform(Vector3(points[i].x, 0.f, points[i].y));
+		volume.verts.push_back(point.x);
+		volume.verts.push_back(point.y);
+		volume.verts.push_back(point.z);
+		if (i == 0)
+		{
+			volume.bounds = AABB(point, Vector3());
+		}
+		else
+		{
+			volume.bounds.expand_to(point);
+		}
+	}
+	volume.hmin = transform.origin.y;
+	volume.hmax = transform.origin.y + height * transform.basis.get_scale().y;
+	volume.bounds.position.y = volume.hmin;
+	volume.bounds.size.y = volume.hmax - volume.hmin;
+	return volume;
+}
+
+DetourNavigation *DetourAreaVolume::find_navigation()
+{
+	for (Node *node = get_parent(); node != nullptr; node = node->get_parent())
+	{
+		DetourNavigation *navigation = Object::cast_to<DetourNavigation>(node);
+		if (navigation != nullptr)
+		{
+			return navigation;
+		}
+	}
+	return nullptr;
+}
+
+void DetourAreaVolume::changed()
+{
+	if (!is_inside_tree())
+	{
+		return;
+	}
+	DetourNavigation *navigation = find_navigation();
+	if (navigation != nullptr)
+	{
+		navigation->update_area_volume(this);
+	}
+}
@@ -0,0 +1,52 @@
+#ifndef AREA_VOLUME_H
+#define AREA_VOLUME_H
+
+#include <Godot.hpp>
+#include <Spatial.hpp>
+#include <PoolArrays.hpp>
+#include "navmesh_generator.h"
+
+namespace godot
+{
+
+class DetourNavigation;
+
+/**
+ * Convex prism that gives the navmesh inside it another area id, like
+ * shallow water or a doorway. The polygon is in the local x/z plane and
+ * the volume reaches height up from the node. Must be a child (at any
+ * depth) of DetourNavigation, moving it rebuilds only the tiles under it.
+ */
+class DetourAreaVolume : public Spatial
+{
+	GODOT_CLASS(DetourAreaVolume, Spatial);
+
+public:
+	DetourAreaVolume();
+	~DetourAreaVolume();
+
+	void _init();
+	static void _register_methods();
+	void _notification(int p_what);
+
+	void set_polygon(PoolVector2Array p_polygon);
+	PoolVector2Array get_polygon();
+	void set_height(float p_height);
+	float get_height();
+	/* 1..62 as in area_layers, 0 makes the volume unwalkable */
+	void set_area(int p_area);
+	int get_area();
+
+	AreaVolume get_area_volume();
+
+private:
+	PoolVector2Array polygon;
+	float height;
+	int area;
+
+	DetourNavigation *find_navigation();
+	void changed();
+};
+
+} // namespace godot
+#endif
@@ -1,6 +1,11 @@
 #include "navigation.h"
 #include "navigation_mesh.h"
 #include "tilecache_navmesh.h"
+#include "navigation_crowd.h"
+#include "navigation_corridor.h"
+#include "query_filter.h"
+#include "area_volume.h"
+#include "offmesh_link.h"
 
 extern "C" void GDN_EXPORT godot_gdnative_init(godot_gdnative_init_options *o)
 {
@@ -20,4 +25,9 @@ extern "C" void GDN_EXPORT godot_nativescript_init(void *handle)
 	godot::register_tool_class<godot::NavmeshParameters>();
 	godot::register_tool_class<godot::CachedNavmeshParameters>();
 	godot::register_tool_class<godot::DetourNavigationMeshCached>();
+	godot::register_class<godot::DetourCrowd>();
+	godot::register_class<godot::DetourPathCorridor>();
+	godot::register_tool_class<godot::DetourQueryFilter>();
+	godot::register_tool_class<godot::DetourAreaVolume>();
+	godot::register_tool_class<godot::DetourOffMeshLink>();
 }
\ No newline at end of file
@@ -0,0 +1,137 @@
+#include "DetourAlloc.h"
+#include "mapped_file.h"
+
+#ifdef _WIN32
+#ifndef WIN32_LEAN_AND_MEAN
+#define WIN32_LEAN_AND_MEAN
+#endif
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+using namespace godot;
+
+MappedFile::~MappedFile()
+{
+	close();
+}
+
+/**
+ * Maps the whole file, the mapping starts on a page boundary
+ *
+ * @return false if the file is missing, empty or can't be mapped
+ */
+bool MappedFile::map(const std::string &path)
+{
+	close();
+#ifdef _WIN32
+	/* Paths are UTF-8 like Godot's */
+	int length = MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, nullptr, 0);
+	if (length <= 0)
+	{
+		return false;
+	}
+	std::wstring wide_path(length, L'\0');
+	MultiByteToWideChar(CP_UTF8, 0, path.c_str(), -1, &wide_path[0], length);
+	HANDLE file = CreateFileW(wide_path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+	{
+		return false;
+	}
+	LARGE_INTEGER file_size;
+	if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart == 0)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	/* Copy-on-write needs a read-only mapping viewed with FILE_MAP_COPY */
+	HANDLE mapping = CreateFileMappingW(file, nullptr, PAGE_WRITECOPY, 0, 0, nullptr);
+	if (mapping == nullptr)
+	{
+		CloseHandle(file);
+		return false;
+	}
+	void *view = MapViewOfFile(mapping, FILE_MAP_COPY, 0, 0, 0);
+	if (view == nullptr)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		return false;
+	}
+	file_handle = file;
+	mapping_handle = mapping;
+	data = (unsigned char *)view;
+	size = (size_t)file_size.QuadPart;
+#else
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0)
+	{
+		return false;
+	}
+	struct stat file_stat;
+	if (fstat(fd, &file_stat) != 0 || file_stat.st_size <= 0)
+	{
+		::close(fd);
+		return false;
+	}
+	void *view = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	/* The mapping keeps the file referenced */
+	::close(fd);
+	if (view == MAP_FAILED)
+	{
+		return false;
+	}
+	data = (unsigned char *)view;
+	size = (size_t)file_stat.st_size;
+#endif
+	mapped = true;
+	return true;
+}
+
+/**
+ * Fallback for files that can't be mapped, the caller fills the block
+ */
+unsigned char *MappedFile::allocate(size_t block_size)
+{
+	close();
+	data = (unsigned char *)dtAlloc(block_size, DT_ALLOC_PERM);
+	size = data != nullptr ? block_size : 0;
+	return data;
+}
+
+/**
+ * Nothing may point into the data anymore, navmeshes using it must be freed first
+ */
+void MappedFile::close()
+{
+	if (data == nullptr)
+	{
+		return;
+	}
+	if (!mapped)
+	{
+		dtFree(data);
+	}
+	else
+	{
+#ifdef _WIN32
+		UnmapViewOfFile(data);
+		CloseHandle((HANDLE)mapping_handle);
+		CloseHandle((HANDLE)file_handle);
+		mapping_handle = nullptr;
+		file_handle = nullptr;
+#else
+		munmap(data, size);
+#endif
+	}
+	data = nullptr;
+	size = 0;
+	mapped = false;
+}
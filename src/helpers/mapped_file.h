@@ -0,0 +1,43 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <cstddef>
+#include <string>
+
+namespace godot
+{
+
+/**
+ * File mapped copy-on-write. Detour writes links into tile data it's given,
+ * written pages become private to the process, the rest stay shared with
+ * every process that maps the same file. Files that can't be mapped (in a
+ * pck) can be read into an allocated block instead, owned the same way.
+ */
+class MappedFile
+{
+public:
+	MappedFile() {}
+	~MappedFile();
+	MappedFile(const MappedFile &) = delete;
+	MappedFile &operator=(const MappedFile &) = delete;
+
+	bool map(const std::string &path);
+	unsigned char *allocate(size_t size);
+	void close();
+
+	unsigned char *get_data() { return data; }
+	size_t get_size() const { return size; }
+	bool is_mapped() const { return mapped; }
+
+private:
+	unsigned char *data = nullptr;
+	size_t size = 0;
+	bool mapped = false;
+#ifdef _WIN32
+	void *file_handle = nullptr;
+	void *mapping_handle = nullptr;
+#endif
+};
+
+} // namespace godot
+#endif
@@ -137,8 +137,148 @@ dtNavMesh *Serializer::deserializeNavigationMesh(PoolByteArray byte_data)
 	return mesh;
 }
 
+static const int NAVMESHFILE_MAGIC = 'M' << 24 | 'F' << 16 | 'I' << 8 | 'L'; //'MFIL';
+static const int NAVMESHFILE_VERSION = 1;
+/* Tiles start on page boundaries, so a mapped tile shares no page with another */
+static const int NAVMESHFILE_ALIGNMENT = 4096;
+
+struct NavMeshFileHeader
+{
+	int magic;
+	int version;
+	int numTiles;
+	int alignment;
+	dtNavMeshParams params;
+};
+
+/* Follows the header once per tile, fixed size fields so files don't depend on DT_POLYREF64 */
+struct NavMeshFileTile
+{
+	uint64_t tileRef;
+	uint64_t offset;
+	uint64_t dataSize;
+};
+
+static uint64_t align_offset(uint64_t offset, uint64_t alignment)
+{
+	return (offset + alignment - 1) / alignment * alignment;
+}
+
+/**
+ * Same tiles as serializeNavigationMesh, laid out for mapNavigationMesh:
+ * a table of tiles after the header and every tile on its own pages
+ */
+PoolByteArray Serializer::serializeNavigationMeshFile(const dtNavMesh *mesh)
+{
+	PoolByteArray file_pba;
+	if (!mesh)
+		return file_pba;
+
+	std::vector<NavMeshFileTile> tiles;
+	std::vector<const dtMeshTile *> sources;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile *tile = mesh->getTile(i);
+		if (!tile || !tile->header || !tile->dataSize)
+			continue;
+		NavMeshFileTile fileTile;
+		fileTile.tileRef = mesh->getTileRef(tile);
+		fileTile.dataSize = tile->dataSize;
+		tiles.push_back(fileTile);
+		sources.push_back(tile);
+	}
+
+	uint64_t offset = sizeof(NavMeshFileHeader) + tiles.size() * sizeof(NavMeshFileTile);
+	for (NavMeshFileTile &fileTile : tiles)
+	{
+		fileTile.offset = align_offset(offset, NAVMESHFILE_ALIGNMENT);
+		offset = fileTile.offset + fileTile.dataSize;
+	}
+
+	NavMeshFileHeader header;
+	header.magic = NAVMESHFILE_MAGIC;
+	header.version = NAVMESHFILE_VERSION;
+	header.numTiles = (int)tiles.size();
+	header.alignment = NAVMESHFILE_ALIGNMENT;
+	memcpy(&header.params, mesh->getParams(), sizeof(dtNavMeshParams));
+
+	/* Sized once, a big navmesh isn't grown tile by tile */
+	file_pba.resize((int)offset);
+	{
+		PoolByteArray::Write write = file_pba.write();
+		memset(write.ptr(), 0, offset);
+		memcpy(write.ptr(), &header, sizeof(NavMeshFileHeader));
+		if (!tiles.empty())
+		{
+			memcpy(write.ptr() + sizeof(NavMeshFileHeader), tiles.data(), tiles.size() * sizeof(NavMeshFileTile));
+		}
+		for (size_t i = 0; i < tiles.size(); ++i)
+		{
+			memcpy(write.ptr() + tiles[i].offset, sources[i]->data, tiles[i].dataSize);
+		}
+	}
+	return file_pba;
+}
+
+/**
+ * Adds the tiles of a navmesh file in place, without copying them. The
+ * navmesh doesn't own the tile data, it has to outlive the navmesh and
+ * stay writable (Detour writes the tile links into it).
+ *
+ * @return nullptr if the data isn't a navmesh file of this version or a tile can't be added
+ */
+dtNavMesh *Serializer::mapNavigationMesh(unsigned char *data, size_t size)
+{
+	NavMeshFileHeader header;
+	if (!data || size < sizeof(NavMeshFileHeader))
+	{
+		return nullptr;
+	}
+	memcpy(&header, data, sizeof(NavMeshFileHeader));
+	if (header.magic != NAVMESHFILE_MAGIC || header.version != NAVMESHFILE_VERSION || header.numTiles < 0)
+	{
+		return nullptr;
+	}
+	if (size < sizeof(NavMeshFileHeader) + (uint64_t)header.numTiles * sizeof(NavMeshFileTile))
+	{
+		return nullptr;
+	}
+
+	dtNavMesh *mesh = dtAllocNavMesh();
+	if (!mesh)
+	{
+		return nullptr;
+	}
+	if (dtStatusFailed(mesh->init(&header.params)))
+	{
+		dtFreeNavMesh(mesh);
+		return nullptr;
+	}
+
+	const unsigned char *table = data + sizeof(NavMeshFileHeader);
+	for (int i = 0; i < header.numTiles; ++i)
+	{
+		NavMeshFileTile fileTile;
+		memcpy(&fileTile, table + i * sizeof(NavMeshFileTile), sizeof(NavMeshFileTile));
+		/* Detour reads the tile through its headers, it has to be 4 byte aligned */
+		if (!fileTile.tileRef || !fileTile.dataSize || fileTile.offset % 4 != 0 || fileTile.offset + fileTile.dataSize > size)
+		{
+			dtFreeNavMesh(mesh);
+			return nullptr;
+		}
+		/* No DT_TILE_FREE_DATA, the file owns the data. A partial navmesh is worse than none. */
+		if (dtStatusFailed(mesh->addTile(data + fileTile.offset, (int)fileTile.dataSize, 0, (dtTileRef)fileTile.tileRef, 0)))
+		{
+			dtFreeNavMesh(mesh);
+			return nullptr;
+		}
+	}
+	return mesh;
+}
+
 static const int TILECACHESET_MAGIC = 'T' << 24 | 'S' << 16 | 'E' << 8 | 'T'; //'TSET';
-static const int TILECACHESET_VERSION = 1;
+/* Version 2 added the codec, version 1 tile caches are FastLZ level 1 */
+static const int TILECACHESET_VERSION = 2;
 
 struct TileCacheSetHeader
 {
@@ -147,15 +287,18 @@ struct TileCacheSetHeader
 	int numTiles;
 	dtNavMeshParams meshParams;
 	dtTileCacheParams cacheParams;
+	int compression;
 };
 
+static const int TILECACHESET_V1_HEADER_SIZE = offsetof(TileCacheSetHeader, compression);
+
 struct TileCacheTileHeader
 {
 	dtCompressedTileRef tileRef;
 	int dataSize;
 };
 
-PoolByteArray Serializer::serializeNavigationMeshCached(const dtTileCache *m_tileCache, const dtNavMesh *m_navMesh)
+PoolByteArray Serializer::serializeNavigationMeshCached(const dtTileCache *m_tileCache, const dtNavMesh *m_navMesh, int compression)
 {
 
 	PoolByteArray master_pba;
@@ -166,6 +309,7 @@ PoolByteArray Serializer::serializeNavigationMeshCached(const dtTileCache *m_til
 	TileCacheSetHeader header;
 	header.magic = TILECACHESET_MAGIC;
 	header.version = TILECACHESET_VERSION;
+	header.compression = compression;
 	header.numTiles = 0;
 	for (int i = 0; i < m_tileCache->getTileCount(); ++i)
 	{
@@ -210,21 +354,35 @@ PoolByteArray Serializer::serializeNavigationMeshCached(const dtTileCache *m_til
 	return master_pba;
 }
 
-bool Serializer::deserializeNavigationMeshCached(PoolByteArray byte_data, dtTileCache *m_tileCache, dtNavMesh *m_navMesh, dtTileCacheMeshProcess *m_tmproc)
+/**
+ * Restores the tile cache with the codec its tiles were compressed with
+ *
+ * @param m_tcomp receives that codec, owned by the caller even if loading fails
+ */
+bool Serializer::deserializeNavigationMeshCached(PoolByteArray byte_data, dtTileCache *m_tileCache, dtNavMesh *m_navMesh, dtTileCacheMeshProcess *m_tmproc, dtTileCacheAlloc *m_talloc, TileCacheCompressor **m_tcomp)
 {
 	PoolByteArray::Read read_data = byte_data.read();
 	TileCacheSetHeader header;
-	if (byte_data.size() < sizeof(TileCacheSetHeader))
+	if (byte_data.size() < TILECACHESET_V1_HEADER_SIZE)
 	{
 		return false;
 	}
-	memcpy(&header, read_data.ptr(), sizeof(TileCacheSetHeader));
-	int seek = sizeof(TileCacheSetHeader);
+	memcpy(&header, read_data.ptr(), TILECACHESET_V1_HEADER_SIZE);
+	int seek = TILECACHESET_V1_HEADER_SIZE;
 	if (header.magic != TILECACHESET_MAGIC)
 	{
 		return false;
 	}
-	if (header.version != TILECACHESET_VERSION)
+	if (header.version == 1)
+	{
+		header.compression = TILE_COMPRESSION_FAST;
+	}
+	else if (header.version == TILECACHESET_VERSION && byte_data.size() >= sizeof(TileCacheSetHeader))
+	{
+		memcpy(&header, read_data.ptr(), sizeof(TileCacheSetHeader));
+		seek = sizeof(TileCacheSetHeader);
+	}
+	else
 	{
 		return false;
 	}
@@ -241,16 +399,15 @@ bool Serializer::deserializeNavigationMeshCached(PoolByteArray byte_data, dtTile
 	{
 		return false;
 	}
-	LinearAllocator *m_talloc = new LinearAllocator(32000);
-	FastLZCompressor *m_tcomp = new FastLZCompressor;
-	status = m_tileCache->init(&header.cacheParams, m_talloc, m_tcomp, m_tmproc);
+	*m_tcomp = create_tile_cache_compressor(header.compression);
+	status = m_tileCache->init(&header.cacheParams, m_talloc, *m_tcomp, m_tmproc);
 	if (dtStatusFailed(status))
 	{
 		return false;
 	}
 
 	// validate length
-	if (header.numTiles * sizeof(TileCacheSetHeader) + seek > byte_data.size())
+	if (header.numTiles * sizeof(TileCacheTileHeader) + seek > byte_data.size())
 	{
 		return false;
 	}
@@ -294,4 +451,197 @@ bool Serializer::deserializeNavigationMeshCached(PoolByteArray byte_data, dtTile
 		}
 	}
 	return true;
-}
\ No newline at end of file
+}
+static const int LANDMARKSET_MAGIC = 'L' << 24 | 'M' << 16 | 'R' << 8 | 'K'; //'LMRK';
+static const int LANDMARKSET_VERSION = 1;
+
+struct LandmarkSetHeader
+{
+	int magic;
+	int version;
+	int numLandmarks;
+	int numTiles;
+	int symmetric;
+};
+
+/* Polygons are stored by tile location, tile cache tiles get new refs when rebuilt */
+struct LandmarkPolyHeader
+{
+	int tileX;
+	int tileY;
+	int tileLayer;
+	int poly;
+	float position[3];
+};
+
+struct LandmarkTileHeader
+{
+	int tileX;
+	int tileY;
+	int tileLayer;
+	int polyCount;
+};
+
+PoolByteArray Serializer::serializeLandmarks(const NavmeshLandmarks *landmarks)
+{
+	PoolByteArray master_pba;
+	if (!landmarks || landmarks->is_empty() || !landmarks->navmesh)
+		return master_pba;
+	const dtNavMesh *mesh = landmarks->navmesh;
+
+	LandmarkSetHeader header;
+	header.magic = LANDMARKSET_MAGIC;
+	header.version = LANDMARKSET_VERSION;
+	header.numLandmarks = landmarks->get_landmark_count();
+	header.numTiles = 0;
+	header.symmetric = landmarks->symmetric ? 1 : 0;
+	for (int i = 0; i < mesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile *tile = mesh->getTile(i);
+		if (!tile || !tile->header || i >= landmarks->tiles.size())
+			continue;
+		header.numTiles++;
+	}
+
+	int size = sizeof(LandmarkSetHeader) + header.numLandmarks * sizeof(LandmarkPolyHeader);
+	for (int i = 0; i < mesh->getMaxTiles() && i < landmarks->tiles.size(); ++i)
+	{
+		const dtMeshTile *tile = mesh->getTile(i);
+		if (!tile || !tile->header)
+			continue;
+		size += sizeof(LandmarkTileHeader) + landmarks->tiles[i].distances.size() * sizeof(float);
+	}
+	master_pba.resize(size);
+	PoolByteArray::Write write = master_pba.write();
+	int seek = 0;
+	memcpy(write.ptr(), &header, sizeof(LandmarkSetHeader));
+	seek += sizeof(LandmarkSetHeader);
+
+	for (const NavmeshLandmarks::Landmark &landmark : landmarks->landmarks)
+	{
+		LandmarkPolyHeader polyHeader;
+		memset(&polyHeader, 0, sizeof(LandmarkPolyHeader));
+		polyHeader.poly = -1;
+		memcpy(polyHeader.position, landmark.position, sizeof(float) * 3);
+		const dtMeshTile *tile;
+		const dtPoly *poly;
+		if (landmark.ref && dtStatusSucceed(mesh->getTileAndPolyByRef(landmark.ref, &tile, &poly)))
+		{
+			polyHeader.tileX = tile->header->x;
+			polyHeader.tileY = tile->header->y;
+			polyHeader.tileLayer = tile->header->layer;
+			polyHeader.poly = (int)(poly - tile->polys);
+		}
+		memcpy(write.ptr() + seek, &polyHeader, sizeof(LandmarkPolyHeader));
+		seek += sizeof(LandmarkPolyHeader);
+	}
+
+	for (int i = 0; i < mesh->getMaxTiles() && i < landmarks->tiles.size(); ++i)
+	{
+		const dtMeshTile *tile = mesh->getTile(i);
+		if (!tile || !tile->header)
+			continue;
+		const std::vector<float> &distances = landmarks->tiles[i].distances;
+		LandmarkTileHeader tileHeader;
+		tileHeader.tileX = tile->header->x;
+		tileHeader.tileY = tile->header->y;
+		tileHeader.tileLayer = tile->header->layer;
+		tileHeader.polyCount = tile->header->polyCount;
+		memcpy(write.ptr() + seek, &tileHeader, sizeof(LandmarkTileHeader));
+		seek += sizeof(LandmarkTileHeader);
+		memcpy(write.ptr() + seek, distances.data(), distances.size() * sizeof(float));
+		seek += distances.size() * sizeof(float);
+	}
+	return master_pba;
+}
+
+/**
+ * Loads the landmark table of an already deserialized navmesh. Tiles that
+ * don't match anymore keep unknown distances and their landmarks are
+ * marked stale, so they're recomputed at runtime.
+ */
+bool Serializer::deserializeLandmarks(PoolByteArray byte_data, NavmeshLandmarks *landmarks, const dtNavMesh *m_navMesh)
+{
+	landmarks->clear();
+	if (!m_navMesh || byte_data.size() < sizeof(LandmarkSetHeader))
+	{
+		return false;
+	}
+	PoolByteArray::Read read_data = byte_data.read();
+	LandmarkSetHeader header;
+	memcpy(&header, read_data.ptr(), sizeof(LandmarkSetHeader));
+	int seek = sizeof(LandmarkSetHeader);
+	if (header.magic != LANDMARKSET_MAGIC)
+	{
+		return false;
+	}
+	if (header.version != LANDMARKSET_VERSION)
+	{
+		return false;
+	}
+	if (header.numLandmarks <= 0 || seek + header.numLandmarks * sizeof(LandmarkPolyHeader) > byte_data.size())
+	{
+		return false;
+	}
+
+	landmarks->navmesh = m_navMesh;
+	landmarks->symmetric = header.symmetric != 0;
+	landmarks->landmarks.resize(header.numLandmarks);
+	landmarks->layout_tiles();
+	std::vector<bool> loaded(m_navMesh->getMaxTiles(), false);
+	for (NavmeshLandmarks::Landmark &landmark : landmarks->landmarks)
+	{
+		LandmarkPolyHeader polyHeader;
+		memcpy(&polyHeader, read_data.ptr() + seek, sizeof(LandmarkPolyHeader));
+		seek += sizeof(LandmarkPolyHeader);
+		memcpy(landmark.position, polyHeader.position, sizeof(float) * 3);
+		const dtMeshTile *tile = m_navMesh->getTileAt(polyHeader.tileX, polyHeader.tileY, polyHeader.tileLayer);
+		if (tile && polyHeader.poly >= 0 && polyHeader.poly < tile->header->polyCount)
+		{
+			landmark.ref = m_navMesh->getPolyRefBase(tile) | (dtPolyRef)polyHeader.poly;
+		}
+		landmark.stale = landmark.ref == 0;
+	}
+
+	for (int i = 0; i < header.numTiles; ++i)
+	{
+		LandmarkTileHeader tileHeader;
+		if (seek + sizeof(LandmarkTileHeader) > byte_data.size())
+		{
+			landmarks->clear();
+			return false;
+		}
+		memcpy(&tileHeader, read_data.ptr() + seek, sizeof(LandmarkTileHeader));
+		seek += sizeof(LandmarkTileHeader);
+		int dataSize = tileHeader.polyCount * header.numLandmarks * sizeof(float);
+		if (tileHeader.polyCount < 0 || seek + dataSize > byte_data.size())
+		{
+			landmarks->clear();
+			return false;
+		}
+
+		const dtMeshTile *tile = m_navMesh->getTileAt(tileHeader.tileX, tileHeader.tileY, tileHeader.tileLayer);
+		if (tile && tile->header->polyCount == tileHeader.polyCount)
+		{
+			int tileIndex = (int)m_navMesh->decodePolyIdTile(m_navMesh->getPolyRefBase(tile));
+			memcpy(landmarks->tiles[tileIndex].distances.data(), read_data.ptr() + seek, dataSize);
+			loaded[tileIndex] = true;
+		}
+		seek += dataSize;
+	}
+
+	/* Tiles without stored distances were changed after the bake */
+	for (int i = 0; i < m_navMesh->getMaxTiles(); ++i)
+	{
+		const dtMeshTile *tile = m_navMesh->getTile(i);
+		if (tile->header && !loaded[i])
+		{
+			for (NavmeshLandmarks::Landmark &landmark : landmarks->landmarks)
+			{
+				landmark.stale = true;
+			}
+			break;
+		}
+	}
+	return true;
+}
@@ -4,11 +4,15 @@
 #include <math.h>
 #include <stdio.h>
 #include <string.h>
+#include <stddef.h>
+#include <stdint.h>
+#include <vector>
 #include <Godot.hpp>
 #include <PoolArrays.hpp>
 #include "DetourNavMesh.h"
 #include "tilecache_helpers.h"
 #include "DetourTileCache.h"
+#include "navmesh_landmarks.h"
 
 namespace godot
 {
@@ -18,8 +22,12 @@ class Serializer
 public:
 	static dtNavMesh *deserializeNavigationMesh(PoolByteArray byte_data);
 	static PoolByteArray serializeNavigationMesh(const dtNavMesh *mesh);
-	static PoolByteArray serializeNavigationMeshCached(const dtTileCache *m_tileCache, const dtNavMesh *m_navMesh);
-	static bool deserializeNavigationMeshCached(PoolByteArray byte_data, dtTileCache *m_tileCache, dtNavMesh *m_navMesh, dtTileCacheMeshProcess *m_tmproc);
+	static PoolByteArray serializeNavigationMeshFile(const dtNavMesh *mesh);
+	static dtNavMesh *mapNavigationMesh(unsigned char *data, size_t size);
+	static PoolByteArray serializeNavigationMeshCached(const dtTileCache *m_tileCache, const dtNavMesh *m_navMesh, int compression);
+	static bool deserializeNavigationMeshCached(PoolByteArray byte_data, dtTileCache *m_tileCache, dtNavMesh *m_navMesh, dtTileCacheMeshProcess *m_tmproc, dtTileCacheAlloc *m_talloc, TileCacheCompressor **m_tcomp);
+	static PoolByteArray serializeLandmarks(const NavmeshLandmarks *landmarks);
+	static bool deserializeLandmarks(PoolByteArray byte_data, NavmeshLandmarks *landmarks, const dtNavMesh *m_navMesh);
 };
 } // namespace godot
 
@@ -1,5 +1,11 @@
 #ifndef TILECACHE_HELPERS_H
 #define TILECACHE_HELPERS_H
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <cstring>
+#include <vector>
+#include <DetourCommon.h>
 #include <DetourTileCache.h>
 #include <DetourTileCacheBuilder.h>
 #include <Recast.h>
@@ -8,69 +14,294 @@
 
 namespace godot {
 
-	struct FastLZCompressor : public dtTileCacheCompressor {
-		virtual int maxCompressedSize(const int bufferSize) {
-			return (int)(bufferSize * 1.05f);
-		}
+	/* Codec of the compressed tile cache layers, stored in the serialized tile cache */
+	enum TileCacheCompression {
+		TILE_COMPRESSION_NONE = 0,
+		TILE_COMPRESSION_FAST = 1,
+		TILE_COMPRESSION_SMALL = 2,
+		TILE_COMPRESSION_COUNT = 3
+	};
+
+	/* Counts what passes through the codec, so codecs can be compared per map */
+	struct TileCacheCompressor : public dtTileCacheCompressor {
+		std::atomic<uint64_t> raw_bytes{ 0 };
+		std::atomic<uint64_t> compressed_bytes{ 0 };
+		std::atomic<uint64_t> decompressions{ 0 };
+		std::atomic<uint64_t> decompress_usec{ 0 };
+		/**
+		 * While set, decompress only records the header of the layer it was asked for and
+		 * fails. dtTileCache::update then does its request and obstacle bookkeeping without
+		 * building, the recorded layers are built by the cached navmesh instead.
+		 */
+		std::vector<const dtTileCacheLayerHeader*>* deferred = nullptr;
+
+		virtual TileCacheCompression get_type() const = 0;
 
 		virtual dtStatus compress(const unsigned char* buffer, const int bufferSize,
 			unsigned char* compressed,
-			const int /*maxCompressedSize*/,
+			const int maxCompressedSize,
 			int* compressedSize) {
-			*compressedSize =
-				fastlz_compress((const void*)buffer, bufferSize, compressed);
-			return DT_SUCCESS;
+			dtStatus status = compress_data(buffer, bufferSize, compressed, maxCompressedSize, compressedSize);
+			if (dtStatusSucceed(status)) {
+				raw_bytes += bufferSize;
+				compressed_bytes += *compressedSize;
+			}
+			return status;
 		}
 
 		virtual dtStatus decompress(const unsigned char* compressed,
 			const int compressedSize, unsigned char* buffer,
 			const int maxBufferSize, int* bufferSize) {
+			if (deferred) {
+				/* dtDecompressTileCacheLayer passes the data right after the aligned layer header */
+				deferred->push_back((const dtTileCacheLayerHeader*)(compressed - dtAlign4(sizeof(dtTileCacheLayerHeader))));
+				return DT_FAILURE;
+			}
+			std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+			dtStatus status = decompress_data(compressed, compressedSize, buffer, maxBufferSize, bufferSize);
+			decompress_usec += std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+			decompressions++;
+			return status;
+		}
+
+	protected:
+		virtual dtStatus compress_data(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int maxCompressedSize, int* compressedSize) = 0;
+		virtual dtStatus decompress_data(const unsigned char* compressed, const int compressedSize,
+			unsigned char* buffer, const int maxBufferSize, int* bufferSize) = 0;
+	};
+
+	/* Layers stored as they are, nothing to decompress when obstacles change */
+	struct UncompressedCompressor : public TileCacheCompressor {
+		virtual TileCacheCompression get_type() const { return TILE_COMPRESSION_NONE; }
+
+		virtual int maxCompressedSize(const int bufferSize) {
+			return bufferSize;
+		}
+
+	protected:
+		virtual dtStatus compress_data(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int maxCompressedSize, int* compressedSize) {
+			if (bufferSize > maxCompressedSize)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			memcpy(compressed, buffer, bufferSize);
+			*compressedSize = bufferSize;
+			return DT_SUCCESS;
+		}
+
+		virtual dtStatus decompress_data(const unsigned char* compressed, const int compressedSize,
+			unsigned char* buffer, const int maxBufferSize, int* bufferSize) {
+			if (compressedSize > maxBufferSize)
+				return DT_FAILURE | DT_BUFFER_TOO_SMALL;
+			memcpy(buffer, compressed, compressedSize);
+			*bufferSize = compressedSize;
+			return DT_SUCCESS;
+		}
+	};
+
+	/* Level 1 is faster, level 2 compresses better, both decompress alike */
+	struct FastLZCompressor : public TileCacheCompressor {
+		int level;
+
+		explicit FastLZCompressor(int compression_level = 1) :
+			level(compression_level) {}
+
+		virtual TileCacheCompression get_type() const {
+			return level == 2 ? TILE_COMPRESSION_SMALL : TILE_COMPRESSION_FAST;
+		}
+
+		virtual int maxCompressedSize(const int bufferSize) {
+			return (int)(bufferSize * 1.05f);
+		}
+
+	protected:
+		virtual dtStatus compress_data(const unsigned char* buffer, const int bufferSize,
+			unsigned char* compressed, const int /*maxCompressedSize*/, int* compressedSize) {
+			*compressedSize =
+				fastlz_compress_level(level, (const void*)buffer, bufferSize, compressed);
+			return DT_SUCCESS;
+		}
+
+		virtual dtStatus decompress_data(const unsigned char* compressed, const int compressedSize,
+			unsigned char* buffer, const int maxBufferSize, int* bufferSize) {
 			*bufferSize =
 				fastlz_decompress(compressed, compressedSize, buffer, maxBufferSize);
 			return *bufferSize < 0 ? DT_FAILURE : DT_SUCCESS;
 		}
 	};
-	struct LinearAllocator : public dtTileCacheAlloc {
-		unsigned char* buffer;
-		size_t capacity;
-		size_t top;
-		size_t high;
 
-		LinearAllocator(const size_t cap) :
-			buffer(0),
-			capacity(0),
-			top(0),
-			high(0) {
-			resize(cap);
+	/**
+	 * Marks the cells of a layer whose centers are inside a convex outline (x y z
+	 * per point, y ignored) and whose height is within hmin and hmax. Works like
+	 * dtMarkCylinderArea, for obstacles the tile cache has no shape for.
+	 */
+	inline dtStatus mark_convex_area(dtTileCacheLayer& layer, const float* orig, const float cs, const float ch,
+		const float* verts, const int nverts, const float hmin, const float hmax, const unsigned char area_id) {
+		if (nverts < 3)
+			return DT_SUCCESS;
+		float bmin[2] = { verts[0], verts[2] };
+		float bmax[2] = { verts[0], verts[2] };
+		for (int i = 1; i < nverts; ++i) {
+			bmin[0] = fminf(bmin[0], verts[i * 3]);
+			bmin[1] = fminf(bmin[1], verts[i * 3 + 2]);
+			bmax[0] = fmaxf(bmax[0], verts[i * 3]);
+			bmax[1] = fmaxf(bmax[1], verts[i * 3 + 2]);
 		}
+		const int w = (int)layer.header->width;
+		const int h = (int)layer.header->height;
+		const float ics = 1.0f / cs;
+		const float ich = 1.0f / ch;
 
-		~LinearAllocator() { dtFree(buffer); }
+		int minx = (int)floorf((bmin[0] - orig[0]) * ics);
+		int miny = (int)floorf((hmin - orig[1]) * ich);
+		int minz = (int)floorf((bmin[1] - orig[2]) * ics);
+		int maxx = (int)floorf((bmax[0] - orig[0]) * ics);
+		int maxy = (int)floorf((hmax - orig[1]) * ich);
+		int maxz = (int)floorf((bmax[1] - orig[2]) * ics);
 
-		void resize(const size_t cap) {
-			if (buffer)
-				dtFree(buffer);
-			buffer = (unsigned char*)dtAlloc(cap, DT_ALLOC_PERM);
-			capacity = cap;
+		if (maxx < 0 || minx >= w || maxz < 0 || minz >= h)
+			return DT_SUCCESS;
+		if (minx < 0) minx = 0;
+		if (maxx >= w) maxx = w - 1;
+		if (minz < 0) minz = 0;
+		if (maxz >= h) maxz = h - 1;
+
+		for (int z = minz; z <= maxz; ++z) {
+			for (int x = minx; x <= maxx; ++x) {
+				const int y = layer.heights[x + z * w];
+				if (y < miny || y > maxy)
+					continue;
+				const float px = orig[0] + (x + 0.5f) * cs;
+				const float pz = orig[2] + (z + 0.5f) * cs;
+				/* Inside if the point is on the same side of every edge, either winding */
+				bool inside = true;
+				float side = 0.f;
+				for (int i = 0, j = nverts - 1; i < nverts; j = i++) {
+					const float* a = &verts[j * 3];
+					const float* b = &verts[i * 3];
+					const float cross = (b[0] - a[0]) * (pz - a[2]) - (b[2] - a[2]) * (px - a[0]);
+					if (cross == 0.f)
+						continue;
+					if (side == 0.f) {
+						side = cross;
+					} else if ((cross > 0.f) != (side > 0.f)) {
+						inside = false;
+						break;
+					}
+				}
+				if (inside)
+					layer.areas[x + z * w] = area_id;
+			}
+		}
+		return DT_SUCCESS;
+	}
+
+	/* Unknown codecs fall back to the fast one tile caches always used */
+	inline TileCacheCompressor* create_tile_cache_compressor(int compression) {
+		switch (compression) {
+			case TILE_COMPRESSION_NONE:
+				return new UncompressedCompressor();
+			case TILE_COMPRESSION_SMALL:
+				return new FastLZCompressor(2);
+			default:
+				return new FastLZCompressor(1);
+		}
+	}
+
+	/**
+	 * Scratch memory of building one navmesh tile from the tile cache. Allocations
+	 * bump through chunks and a new chunk is added when they don't fit, so big
+	 * tiles don't fail like they did with a fixed buffer. On reset the chunks are
+	 * merged into one of their total size, the next tile of that size needs no
+	 * new chunk. Not thread safe, every thread building tiles needs its own.
+	 */
+	struct ChunkedAllocator : public dtTileCacheAlloc {
+		struct Chunk {
+			unsigned char* data;
+			size_t capacity;
+			size_t top;
+		};
+
+		std::vector<Chunk> chunks;
+		size_t current;
+		size_t chunk_size;
+		/* Bytes handed out since the last reset and the most over all resets */
+		size_t used;
+		size_t peak;
+		/* Chunks added because allocations didn't fit */
+		size_t grows;
+
+		explicit ChunkedAllocator(const size_t initial_size) :
+			current(0),
+			chunk_size(MAX(initial_size, (size_t)4096)),
+			used(0),
+			peak(0),
+			grows(0) {
+			add_chunk(chunk_size);
+		}
+
+		~ChunkedAllocator() {
+			for (Chunk& chunk : chunks)
+				dtFree(chunk.data);
 		}
 
 		virtual void reset() {
-			high = MAX(high, top);
-			top = 0;
+			peak = MAX(peak, used);
+			used = 0;
+			current = 0;
+			if (chunks.size() > 1) {
+				size_t total = get_capacity();
+				for (Chunk& chunk : chunks)
+					dtFree(chunk.data);
+				chunks.clear();
+				chunk_size = total;
+				add_chunk(total);
+			}
+			for (Chunk& chunk : chunks)
+				chunk.top = 0;
 		}
 
 		virtual void* alloc(const size_t size) {
-			if (!buffer)
-				return 0;
-			if (top + size > capacity)
-				return 0;
-			unsigned char* mem = &buffer[top];
-			top += size;
+			/* Same alignment as dtAlloc gives, the builder stores ints and shorts */
+			const size_t aligned = (size + 7) & ~(size_t)7;
+			while (current < chunks.size() && chunks[current].top + aligned > chunks[current].capacity)
+				current++;
+			if (current == chunks.size()) {
+				if (!add_chunk(MAX(chunk_size, aligned)))
+					return 0;
+				grows++;
+			}
+			Chunk& chunk = chunks[current];
+			unsigned char* mem = chunk.data + chunk.top;
+			chunk.top += aligned;
+			used += aligned;
 			return mem;
 		}
 
 		virtual void free(void* /*ptr*/) {
 			// Empty
 		}
+
+		size_t get_capacity() const {
+			size_t capacity = 0;
+			for (const Chunk& chunk : chunks)
+				capacity += chunk.capacity;
+			return capacity;
+		}
+
+		size_t get_peak() const { return MAX(peak, used); }
+
+	private:
+		bool add_chunk(const size_t capacity) {
+			Chunk chunk;
+			chunk.data = (unsigned char*)dtAlloc(capacity, DT_ALLOC_PERM);
+			if (!chunk.data)
+				return false;
+			chunk.capacity = capacity;
+			chunk.top = 0;
+			chunks.push_back(chunk);
+			return true;
+		}
 	};
 
 }
@@ -0,0 +1,76 @@
+#include <algorithm>
+#include "worker_pool.h"
+
+using namespace godot;
+
+WorkerPool::WorkerPool(int thread_count)
+{
+	for (int i = 0; i < std::max(thread_count, 1); i++)
+	{
+		threads.emplace_back(&WorkerPool::worker_loop, this, i);
+	}
+}
+
+/* Jobs still in the queue are finished before the threads exit */
+WorkerPool::~WorkerPool()
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		stopping = true;
+	}
+	job_cv.notify_all();
+	for (std::thread &thread : threads)
+	{
+		thread.join();
+	}
+}
+
+int WorkerPool::default_thread_count()
+{
+	unsigned int hardware = std::thread::hardware_concurrency();
+	return std::max(1, static_cast<int>(hardware / 2));
+}
+
+void WorkerPool::push(Job job)
+{
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		jobs.push_back(std::move(job));
+	}
+	job_cv.notify_one();
+}
+
+/**
+ * Blocks until the queue is empty and no job is running
+ */
+void WorkerPool::wait_idle()
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	idle_cv.wait(lock, [this] { return jobs.empty() && running == 0; });
+}
+
+void WorkerPool::worker_loop(int index)
+{
+	std::unique_lock<std::mutex> lock(mutex);
+	while (true)
+	{
+		job_cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+		if (jobs.empty())
+		{
+			return;
+		}
+		Job job = std::move(jobs.front());
+		jobs.pop_front();
+		running++;
+
+		lock.unlock();
+		job(index);
+		lock.lock();
+
+		running--;
+		if (jobs.empty() && running == 0)
+		{
+			idle_cv.notify_all();
+		}
+	}
+}
@@ -0,0 +1,47 @@
+#ifndef WORKER_POOL_H
+#define WORKER_POOL_H
+
+#include <deque>
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+namespace godot
+{
+
+/**
+ * Fixed set of native threads draining a job queue. Jobs get the index of
+ * the worker running them, so callers can keep per-worker state
+ * (queries, allocators) without locking.
+ */
+class WorkerPool
+{
+public:
+	typedef std::function<void(int)> Job;
+
+	explicit WorkerPool(int thread_count);
+	~WorkerPool();
+
+	void push(Job job);
+	void wait_idle();
+	int get_thread_count() const { return static_cast<int>(threads.size()); }
+
+	/* Half of the hardware threads, the main thread keeps the rest busy */
+	static int default_thread_count();
+
+private:
+	std::vector<std::thread> threads;
+	std::deque<Job> jobs;
+	std::mutex mutex;
+	std::condition_variable job_cv;
+	std::condition_variable idle_cv;
+	int running = 0;
+	bool stopping = false;
+
+	void worker_loop(int index);
+};
+
+} // namespace godot
+#endif
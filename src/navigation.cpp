@@ -1,13 +1,24 @@
+#include <cfloat>
+#include <map>
 #include "navigation.h"
 #define QUICKHULL_IMPLEMENTATION
 #include "quickhull.h"
 
 using namespace godot;
 
+/* Meters, degrees and seconds */
+static const float DEFAULT_OBSTACLE_MOVE_THRESHOLD = 0.25f;
+static const float DEFAULT_OBSTACLE_ROTATION_THRESHOLD = 10.f;
+static const float DEFAULT_OBSTACLE_UPDATE_INTERVAL = 0.25f;
+static const float DEFAULT_TILE_UPDATE_BUDGET = 2.f;
+/* Tilt of a convex shape's axes below which its cached outline is reused */
+static const float UPRIGHT_EPSILON = 0.001f;
+
 void DetourNavigation::_register_methods()
 {
 	register_method("_ready", &DetourNavigation::_ready);
 	register_method("_process", &DetourNavigation::_process);
+	register_method("_physics_process", &DetourNavigation::_physics_process);
 	register_method("create_cached_navmesh",
 					&DetourNavigation::create_cached_navmesh);
 	register_method("create_navmesh", &DetourNavigation::create_navmesh);
@@ -23,8 +34,18 @@ void DetourNavigation::_register_methods()
 	register_method("remove_collision_shape",
 					&DetourNavigation::_on_collision_shape_removed);
 	register_method("_on_tree_exiting", &DetourNavigation::_on_tree_exiting);
+	register_method("get_navmesh_for_agent", &DetourNavigation::get_navmesh_for_agent);
+	register_method("find_path", &DetourNavigation::find_path);
+	register_method("find_paths", &DetourNavigation::find_paths);
+	register_method("request_paths", &DetourNavigation::request_paths);
+	register_method("get_obstacle_stats", &DetourNavigation::get_obstacle_stats);
 
 	register_property<DetourNavigation, bool>("auto_add_remove_objects", &DetourNavigation::set_auto_object_management, &DetourNavigation::get_auto_object_management, true);
+	register_property<DetourNavigation, bool>("track_moving_obstacles", &DetourNavigation::set_track_moving_obstacles, &DetourNavigation::get_track_moving_obstacles, true);
+	register_property<DetourNavigation, float>("obstacle_move_threshold", &DetourNavigation::set_obstacle_move_threshold, &DetourNavigation::get_obstacle_move_threshold, DEFAULT_OBSTACLE_MOVE_THRESHOLD);
+	register_property<DetourNavigation, float>("obstacle_rotation_threshold", &DetourNavigation::set_obstacle_rotation_threshold, &DetourNavigation::get_obstacle_rotation_threshold, DEFAULT_OBSTACLE_ROTATION_THRESHOLD);
+	register_property<DetourNavigation, float>("obstacle_update_interval", &DetourNavigation::set_obstacle_update_interval, &DetourNavigation::get_obstacle_update_interval, DEFAULT_OBSTACLE_UPDATE_INTERVAL);
+	register_property<DetourNavigation, float>("tile_update_budget", &DetourNavigation::set_tile_update_budget, &DetourNavigation::get_tile_update_budget, DEFAULT_TILE_UPDATE_BUDGET);
 }
 
 DetourNavigation::DetourNavigation()
@@ -72,6 +93,11 @@ void DetourNavigation::_init()
 
 	set_parsed_geometry_type(PARSED_GEOMETRY_STATIC_COLLIDERS);
 	auto_object_management = true;
+	track_moving_obstacles = true;
+	obstacle_move_threshold = DEFAULT_OBSTACLE_MOVE_THRESHOLD;
+	obstacle_rotation_threshold = DEFAULT_OBSTACLE_ROTATION_THRESHOLD;
+	obstacle_update_interval = DEFAULT_OBSTACLE_UPDATE_INTERVAL;
+	tile_update_budget = DEFAULT_TILE_UPDATE_BUDGET;
 }
 
 /**
@@ -96,10 +122,29 @@ void DetourNavigation::_ready()
 
 	recognize_stored_collision_shapes();
 
+	/* Baked tiles already contain the volumes and links, they're only registered.
+	 * Cached navmeshes built their tiles from the tile cache without the links. */
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i]->generator != nullptr)
+		{
+			collect_authored_nodes(get_children(), navmeshes[i]->generator);
+		}
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i]->generator != nullptr)
+		{
+			collect_authored_nodes(get_children(), cached_navmeshes[i]->generator);
+			cached_navmeshes[i]->rebuild_offmesh_tiles();
+		}
+	}
+
 	recalculate_masks();
 	if (Engine::get_singleton()->is_editor_hint())
 	{
 		set_process(false);
+		set_physics_process(false);
 	}
 	else
 	{
@@ -186,64 +231,231 @@ void DetourNavigation::recalculate_masks()
 }
 
 /**
- * Retrieve all dynamic and static collision masks from children
- * aggregate them and save them to the navigation node for future use
- * This is for performance (eager vs lazy calculation)
+ * Brings every cached navmesh up to date with the obstacle registry, then
+ * lets the tile caches that aren't up to date rebuild tiles, sharing
+ * tile_update_budget between them
  */
 void DetourNavigation::update_tilecache()
 {
+	uint64_t applied = obstacles.get_serial();
 	for (int i = 0; i < cached_navmeshes.size(); ++i)
 	{
 		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->detour_navmesh != nullptr)
 		{
-			cached_navmeshes[i]->update_tilecache();
+			sync_obstacles(cached_navmeshes[i]);
+			applied = std::min(applied, cached_navmeshes[i]->obstacle_serial);
+		}
+	}
+	obstacles.trim(applied);
+
+	uint64_t budget_usec = static_cast<uint64_t>(std::max(tile_update_budget, 0.f) * 1000.f);
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->detour_navmesh != nullptr &&
+			!cached_navmeshes[i]->tilecache_up_to_date)
+		{
+			uint64_t elapsed = OS::get_singleton()->get_ticks_usec() - start;
+			cached_navmeshes[i]->update_tilecache(elapsed < budget_usec ? budget_usec - elapsed : 0);
 		}
 	}
 }
 
-void DetourNavigation::add_box_obstacle_to_all(int64_t instance_id,
-											   Vector3 position, Vector3 extents, float rotationY,
-											   int collision_layer)
+void DetourNavigation::refresh_landmarks()
 {
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i] != nullptr && navmeshes[i]->detour_navmesh != nullptr)
+		{
+			navmeshes[i]->refresh_landmarks();
+		}
+	}
 	for (int i = 0; i < cached_navmeshes.size(); ++i)
 	{
-		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->get_dynamic_collision_mask() & collision_layer)
+		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->detour_navmesh != nullptr)
 		{
-			unsigned int ref_id = cached_navmeshes[i]->add_box_obstacle(position,
-																		extents, rotationY);
-			cached_navmeshes[i]->dynamic_obstacles[instance_id] = (Variant)ref_id;
-			cached_navmeshes[i]->debug_navmesh_dirty = true;
+			cached_navmeshes[i]->refresh_landmarks();
 		}
 	}
 }
 
-void DetourNavigation::add_cylinder_obstacle_to_all(int64_t instance_id,
-													Vector3 position, float radius, float height, int collision_layer)
+/**
+ * Delivers paths finished since the last frame and hands new requests
+ * to the workers, after this frame's tile changes are done
+ */
+void DetourNavigation::process_path_requests()
 {
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i] != nullptr)
+		{
+			navmeshes[i]->emit_ready_paths();
+			navmeshes[i]->dispatch_path_requests();
+		}
+	}
 	for (int i = 0; i < cached_navmeshes.size(); ++i)
 	{
-		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->get_dynamic_collision_mask() & collision_layer)
+		if (cached_navmeshes[i] != nullptr)
 		{
-			unsigned int ref_id = cached_navmeshes[i]->add_cylinder_obstacle(position,
-																			 radius, height);
-			cached_navmeshes[i]->dynamic_obstacles[instance_id] = (Variant)ref_id;
-			cached_navmeshes[i]->debug_navmesh_dirty = true;
+			cached_navmeshes[i]->emit_ready_paths();
+			cached_navmeshes[i]->dispatch_path_requests();
 		}
 	}
 }
 
+/**
+ * Forgets the shape's obstacle, the navmeshes remove it on their next
+ * update. Shapes without obstacles are ignored.
+ */
 void DetourNavigation::remove_obstacle(CollisionShape *collision_shape)
 {
-	Ref<Shape> s = collision_shape->get_shape();
+	if (obstacles.erase(collision_shape->get_instance_id()))
+	{
+		obstacles.mark_changed(collision_shape->get_instance_id());
+		set_process(true);
+	}
+	/* The shape resource usually goes away with its last collision shape, pruned once per frame */
+	if (!convex_footprints.empty())
+	{
+		footprints_stale = true;
+		set_process(true);
+	}
+}
+
+/**
+ * Describes the obstacle of the shape where it is now, once for all
+ * cached navmeshes
+ *
+ * @return false for shapes that can't be obstacles
+ */
+bool DetourNavigation::describe_obstacle(CollisionShape *collision_shape, int collision_layer)
+{
+	DetourNavigationMeshCached::ObstacleRequest request;
+	if (!make_obstacle_request(collision_shape, request))
+	{
+		return false;
+	}
+	ObstacleRegistry::Entry &entry = obstacles.insert(collision_shape->get_instance_id());
+	entry.collision_shape = collision_shape;
+	entry.collision_layer = collision_layer;
+	entry.obstacle = request;
+	obstacles.mark_changed(entry.owner);
+	set_process(true);
+	return true;
+}
+
+/**
+ * Describes the obstacle of a shape that already has one again
+ */
+void DetourNavigation::update_obstacle(CollisionShape *collision_shape)
+{
+	ObstacleRegistry::Entry *entry = obstacles.find(collision_shape->get_instance_id());
+	if (entry != nullptr)
+	{
+		describe_obstacle(collision_shape, entry->collision_layer);
+	}
+}
+
+/**
+ * Makes the navmesh's obstacles of the owners match the registry in one
+ * batch: placed obstacles are removed, and described ones whose layer is
+ * in the navmesh's dynamic mask are added (again). Navmeshes outside the
+ * mask never see the obstacle.
+ *
+ * @param wait rebuilds the touched tiles now instead of in the budgeted update
+ */
+void DetourNavigation::place_obstacles(DetourNavigationMeshCached *navmesh, const std::vector<int64_t> &owners, bool wait)
+{
+	std::vector<DetourNavigationMeshCached::ObstacleRequest> batch;
+	for (int64_t owner : owners)
+	{
+		std::unordered_map<int64_t, dtObstacleRef>::iterator placed = navmesh->obstacle_refs.find(owner);
+		if (placed != navmesh->obstacle_refs.end())
+		{
+			DetourNavigationMeshCached::ObstacleRequest removal;
+			removal.type = DetourNavigationMeshCached::ObstacleRequest::REMOVE;
+			removal.ref = placed->second;
+			removal.owner = owner;
+			batch.push_back(removal);
+			navmesh->obstacle_refs.erase(placed);
+		}
+		ObstacleRegistry::Entry *entry = obstacles.find(owner);
+		if (entry != nullptr && (navmesh->get_dynamic_collision_mask() & entry->collision_layer))
+		{
+			batch.push_back(entry->obstacle);
+			batch.back().owner = owner;
+		}
+	}
+	navmesh->apply_obstacle_batch(batch, wait);
+	for (DetourNavigationMeshCached::ObstacleRequest &request : batch)
+	{
+		if (request.type != DetourNavigationMeshCached::ObstacleRequest::REMOVE && request.ref != 0)
+		{
+			navmesh->obstacle_refs[request.owner] = request.ref;
+		}
+	}
+}
+
+/**
+ * Applies the registry changes since the navmesh's last update. A navmesh
+ * that missed trimmed changes (it was just loaded) compares everything.
+ */
+void DetourNavigation::sync_obstacles(DetourNavigationMeshCached *navmesh)
+{
+	if (navmesh->obstacle_serial == obstacles.get_serial())
+	{
+		return;
+	}
+	std::vector<int64_t> owners;
+	if (!obstacles.get_changes(navmesh->obstacle_serial, owners))
+	{
+		for (ObstacleRegistry::Entry &entry : obstacles.get_entries())
+		{
+			owners.push_back(entry.owner);
+		}
+		for (const std::pair<const int64_t, dtObstacleRef> &placed : navmesh->obstacle_refs)
+		{
+			owners.push_back(placed.first);
+		}
+	}
+	navmesh->obstacle_serial = obstacles.get_serial();
+	/* An obstacle moved several times since is placed once, where it is now */
+	std::sort(owners.begin(), owners.end());
+	owners.erase(std::unique(owners.begin(), owners.end()), owners.end());
+	place_obstacles(navmesh, owners, false);
+}
+
+/**
+ * Places the obstacles of the shapes again on one navmesh, after its
+ * tiles were rebuilt
+ *
+ * @param owners instance ids of the collision shapes
+ */
+void DetourNavigation::refresh_obstacles(DetourNavigationMeshCached *navmesh, const std::vector<int64_t> &owners)
+{
+	place_obstacles(navmesh, owners, false);
+}
+
+/**
+ * Sizes of the obstacle registry: shapes with obstacles, obstacles over
+ * all cached navmeshes and bytes used
+ */
+Dictionary DetourNavigation::get_obstacle_stats()
+{
+	int placed = 0;
 	for (int i = 0; i < cached_navmeshes.size(); ++i)
 	{
-		if (cached_navmeshes[i] != nullptr && cached_navmeshes[i]->detour_navmesh != nullptr)
+		if (cached_navmeshes[i] != nullptr)
 		{
-			cached_navmeshes[i]->remove_obstacle(
-				cached_navmeshes[i]->dynamic_obstacles[collision_shape->get_instance_id()]);
-			cached_navmeshes[i]->debug_navmesh_dirty = true;
+			placed += (int)cached_navmeshes[i]->obstacle_refs.size();
 		}
 	}
+	Dictionary stats;
+	stats["shapes"] = obstacles.get_count();
+	stats["obstacles"] = placed;
+	stats["pending_changes"] = obstacles.get_pending_changes();
+	stats["memory"] = (int64_t)obstacles.get_memory_usage();
+	return stats;
 }
 
 void DetourNavigation::save_collision_shapes(
@@ -266,7 +478,8 @@ void DetourNavigation::save_collision_shapes(
 			{
 				convert_collision_shape(collision_shape,
 										generator->input_meshes, generator->input_transforms,
-										generator->input_aabbs, generator->collision_ids);
+										generator->input_aabbs, generator->collision_ids,
+										generator->collision_layers);
 			}
 		}
 	}
@@ -274,9 +487,349 @@ void DetourNavigation::save_collision_shapes(
 	generator->mark_dirty(recalculating_start, -1);
 }
 
+/**
+ * Registers every area volume and off-mesh link under the nodes with
+ * the generator, without marking tiles dirty
+ */
+void DetourNavigation::collect_authored_nodes(Array nodes, DetourNavigationMeshGenerator *generator)
+{
+	for (int i = 0; i < nodes.size(); ++i)
+	{
+		Node *node = Object::cast_to<Node>(nodes[i]);
+		if (node == nullptr)
+		{
+			continue;
+		}
+		DetourAreaVolume *volume = Object::cast_to<DetourAreaVolume>(node);
+		if (volume != nullptr)
+		{
+			generator->set_area_volume(volume->get_area_volume(), false);
+		}
+		DetourOffMeshLink *link = Object::cast_to<DetourOffMeshLink>(node);
+		if (link != nullptr)
+		{
+			generator->set_offmesh_link(link->get_instance_id(), link->get_global_start(), link->get_global_end(),
+										link->get_radius(), (unsigned char)link->get_area(), link->get_bidirectional(), false);
+		}
+		collect_authored_nodes(node->get_children(), generator);
+	}
+}
+
+/**
+ * Called by volumes when they enter the tree, move or change, the tiles
+ * under the old and the new shape get rebuilt in the next frame
+ */
+void DetourNavigation::update_area_volume(DetourAreaVolume *volume)
+{
+	AreaVolume description = volume->get_area_volume();
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i]->generator != nullptr && navmeshes[i]->generator->set_area_volume(description, true))
+		{
+			authored_nodes_changed = true;
+		}
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i]->generator != nullptr && cached_navmeshes[i]->generator->set_area_volume(description, true))
+		{
+			authored_nodes_changed = true;
+		}
+	}
+	if (authored_nodes_changed && !Engine::get_singleton()->is_editor_hint())
+	{
+		set_process(true);
+	}
+}
+
+void DetourNavigation::remove_area_volume(DetourAreaVolume *volume)
+{
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i]->generator != nullptr)
+		{
+			navmeshes[i]->generator->remove_area_volume(volume->get_instance_id());
+		}
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i]->generator != nullptr)
+		{
+			cached_navmeshes[i]->generator->remove_area_volume(volume->get_instance_id());
+		}
+	}
+	authored_nodes_changed = true;
+	if (!Engine::get_singleton()->is_editor_hint())
+	{
+		set_process(true);
+	}
+}
+
+/**
+ * Called by links when they enter the tree, move or change
+ */
+void DetourNavigation::update_offmesh_link(DetourOffMeshLink *link)
+{
+	Vector3 start = link->get_global_start();
+	Vector3 end = link->get_global_end();
+	unsigned char area = (unsigned char)link->get_area();
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i]->generator != nullptr &&
+			navmeshes[i]->generator->set_offmesh_link(link->get_instance_id(), start, end, link->get_radius(), area, link->get_bidirectional(), true))
+		{
+			authored_nodes_changed = true;
+		}
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i]->generator != nullptr &&
+			cached_navmeshes[i]->generator->set_offmesh_link(link->get_instance_id(), start, end, link->get_radius(), area, link->get_bidirectional(), true))
+		{
+			authored_nodes_changed = true;
+		}
+	}
+	if (authored_nodes_changed && !Engine::get_singleton()->is_editor_hint())
+	{
+		set_process(true);
+	}
+}
+
+void DetourNavigation::remove_offmesh_link(DetourOffMeshLink *link)
+{
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		if (navmeshes[i]->generator != nullptr)
+		{
+			navmeshes[i]->generator->remove_offmesh_link(link->get_instance_id());
+		}
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		if (cached_navmeshes[i]->generator != nullptr)
+		{
+			cached_navmeshes[i]->generator->remove_offmesh_link(link->get_instance_id());
+		}
+	}
+	authored_nodes_changed = true;
+	if (!Engine::get_singleton()->is_editor_hint())
+	{
+		set_process(true);
+	}
+}
+
+/**
+ * Picks the navmesh baked for the agent size closest above the profile.
+ * A navmesh fits if its radius and height are at least the agent's and
+ * its climb at most the agent's, the one with the least slack wins.
+ * If none fits, the one that misses by the least is used. A negative
+ * climb leaves the climb out of both.
+ */
+DetourNavigationMesh *DetourNavigation::select_navmesh(float radius, float height, float climb)
+{
+	DetourNavigationMesh *best = nullptr;
+	bool best_fits = false;
+	float best_score = 0.f;
+
+	auto consider = [&](DetourNavigationMesh *navmesh) {
+		if (navmesh == nullptr || navmesh->get_detour_navmesh() == nullptr || !navmesh->navmesh_parameters.is_valid())
+		{
+			return;
+		}
+		float navmesh_radius = navmesh->navmesh_parameters->get_agent_radius();
+		float navmesh_height = navmesh->navmesh_parameters->get_agent_height();
+		float navmesh_climb = navmesh->navmesh_parameters->get_agent_max_climb();
+		/* Without a climb in the profile only the size is compared */
+		float agent_climb = climb < 0.f ? navmesh_climb : climb;
+		bool fits = navmesh_radius >= radius && navmesh_height >= height && navmesh_climb <= agent_climb;
+		float score = fits ? (navmesh_radius - radius) + (navmesh_height - height) + (agent_climb - navmesh_climb)
+						   : std::max(radius - navmesh_radius, 0.f) + std::max(height - navmesh_height, 0.f) + std::max(navmesh_climb - agent_climb, 0.f);
+		if (best == nullptr || (fits && !best_fits) || (fits == best_fits && score < best_score))
+		{
+			best = navmesh;
+			best_fits = fits;
+			best_score = score;
+		}
+	};
+	for (int i = 0; i < navmeshes.size(); ++i)
+	{
+		consider(navmeshes[i]);
+	}
+	for (int i = 0; i < cached_navmeshes.size(); ++i)
+	{
+		consider(cached_navmeshes[i]);
+	}
+	return best;
+}
+
+/**
+ * The profile is a dictionary with radius, height and max_climb, missing
+ * values don't restrict the choice
+ */
+DetourNavigationMesh *DetourNavigation::get_navmesh_for_agent(Dictionary agent_profile)
+{
+	float radius = agent_profile.has("radius") ? (float)agent_profile["radius"] : 0.f;
+	float height = agent_profile.has("height") ? (float)agent_profile["height"] : 0.f;
+	float climb = agent_profile.has("max_climb") ? (float)agent_profile["max_climb"] : -1.f;
+	return select_navmesh(radius, height, climb);
+}
+
+Dictionary DetourNavigation::find_path(Dictionary agent_profile, Vector3 from, Vector3 to)
+{
+	DetourNavigationMesh *navmesh = get_navmesh_for_agent(agent_profile);
+	if (navmesh == nullptr)
+	{
+		Dictionary result;
+		result["points"] = Array();
+		result["flags"] = Array();
+		result["status"] = PATH_FAILED;
+		result["nodes_expanded"] = 0;
+		return result;
+	}
+	return navmesh->find_path(from, to);
+}
+
+/**
+ * Finds paths for differently sized agents in one call. Request i uses
+ * agent_profiles[profile_ids[i]], requests are grouped per navmesh and
+ * split between its path workers, all navmeshes search at the same time.
+ * Returns the paths packed like the paths_ready signal of navmeshes:
+ * offsets, points, statuses, nodes_expanded, and in navmeshes the node
+ * each profile was routed to.
+ */
+Dictionary DetourNavigation::find_paths(Array agent_profiles, PoolIntArray profile_ids, PoolVector3Array from, PoolVector3Array to)
+{
+	Dictionary result;
+	int count = from.size();
+	if (to.size() != count || profile_ids.size() != count)
+	{
+		ERR_PRINT("find_paths needs as many profile ids and targets as start points");
+		return result;
+	}
+
+	Array routed;
+	std::vector<DetourNavigationMesh *> routes(agent_profiles.size());
+	for (int i = 0; i < agent_profiles.size(); i++)
+	{
+		routes[i] = get_navmesh_for_agent(agent_profiles[i]);
+		routed.append(routes[i]);
+	}
+
+	struct RouteGroup
+	{
+		std::vector<int> indices;
+		std::vector<DetourNavigationMesh::PathRequest> requests;
+		std::vector<DetourNavigationMesh::PathResult> results;
+	};
+	std::map<DetourNavigationMesh *, RouteGroup> groups;
+	{
+		PoolIntArray::Read ids = profile_ids.read();
+		PoolVector3Array::Read from_read = from.read();
+		PoolVector3Array::Read to_read = to.read();
+		for (int i = 0; i < count; i++)
+		{
+			int profile = ids[i];
+			if (profile < 0 || profile >= (int)routes.size() || routes[profile] == nullptr)
+			{
+				continue;
+			}
+			RouteGroup &group = groups[routes[profile]];
+			group.indices.push_back(i);
+			group.requests.push_back({i, from_read[i], to_read[i], nullptr});
+		}
+	}
+	for (auto &group : groups)
+	{
+		group.first->push_path_batch(group.second.requests, group.second.results);
+	}
+	for (auto &group : groups)
+	{
+		group.first->wait_path_batches();
+	}
+
+	std::vector<DetourNavigationMesh::PathResult> results(count);
+	int point_count = 0;
+	for (auto &group : groups)
+	{
+		for (size_t i = 0; i < group.second.indices.size(); i++)
+		{
+			point_count += (int)group.second.results[i].points.size();
+			results[group.second.indices[i]] = std::move(group.second.results[i]);
+		}
+	}
+
+	PoolIntArray offsets;
+	PoolVector3Array points;
+	PoolIntArray statuses;
+	PoolIntArray nodes_expanded;
+	offsets.resize(count + 1);
+	points.resize(point_count);
+	statuses.resize(count);
+	nodes_expanded.resize(count);
+	{
+		PoolIntArray::Write offsets_write = offsets.write();
+		PoolVector3Array::Write points_write = points.write();
+		PoolIntArray::Write statuses_write = statuses.write();
+		PoolIntArray::Write nodes_write = nodes_expanded.write();
+		int offset = 0;
+		for (int i = 0; i < count; i++)
+		{
+			offsets_write[i] = offset;
+			statuses_write[i] = results[i].stats.status;
+			nodes_write[i] = results[i].stats.nodes_expanded;
+			for (const Vector3 &point : results[i].points)
+			{
+				points_write[offset++] = point;
+			}
+		}
+		offsets_write[count] = offset;
+	}
+	result["offsets"] = offsets;
+	result["points"] = points;
+	result["statuses"] = statuses;
+	result["nodes_expanded"] = nodes_expanded;
+	result["navmeshes"] = routed;
+	return result;
+}
+
+/**
+ * Asynchronous find_paths, each request goes to request_path of the
+ * navmesh its profile is routed to and comes back in that navmesh's
+ * paths_ready signal
+ */
+void DetourNavigation::request_paths(Array agent_profiles, PoolIntArray profile_ids, PoolVector3Array from, PoolVector3Array to, PoolIntArray callback_ids)
+{
+	int count = from.size();
+	if (to.size() != count || profile_ids.size() != count || callback_ids.size() != count)
+	{
+		ERR_PRINT("request_paths needs as many profile ids, targets and callback ids as start points");
+		return;
+	}
+	std::vector<DetourNavigationMesh *> routes(agent_profiles.size());
+	for (int i = 0; i < agent_profiles.size(); i++)
+	{
+		routes[i] = get_navmesh_for_agent(agent_profiles[i]);
+	}
+	PoolIntArray::Read ids = profile_ids.read();
+	PoolIntArray::Read callbacks = callback_ids.read();
+	PoolVector3Array::Read from_read = from.read();
+	PoolVector3Array::Read to_read = to.read();
+	for (int i = 0; i < count; i++)
+	{
+		int profile = ids[i];
+		if (profile >= 0 && profile < (int)routes.size() && routes[profile] != nullptr)
+		{
+			routes[profile]->request_path(from_read[i], to_read[i], callbacks[i]);
+		}
+	}
+	set_process(true);
+}
+
 void DetourNavigation::_process(float passed)
 {
 	DetourNavigation::manage_changes();
+	refresh_landmarks();
+	process_path_requests();
 	if (aggregated_time_passed >= 0.1)
 	{
 		aggregated_time_passed = 0.f;
@@ -285,8 +838,8 @@ void DetourNavigation::_process(float passed)
 
 			rebuild_dirty_debug_meshes();
 		}
-		update_tilecache();
 	}
+	update_tilecache();
 	aggregated_time_passed += passed;
 }
 
@@ -297,7 +850,7 @@ void DetourNavigation::manage_changes()
 		for (int i = 0; i < navmeshes.size(); ++i)
 		{
 			save_collision_shapes(navmeshes[i]->generator);
-			navmeshes[i]->generator->recalculate_tiles();
+			navmeshes[i]->recalculate_tiles();
 			navmeshes[i]->debug_navmesh_dirty = true;
 		}
 		for (int i = 0; i < cached_navmeshes.size(); ++i)
@@ -318,7 +871,7 @@ void DetourNavigation::manage_changes()
 				navmeshes[i]->generator->remove_collision_shape(
 					collision_shape_id);
 			}
-			navmeshes[i]->generator->recalculate_tiles();
+			navmeshes[i]->recalculate_tiles();
 			navmeshes[i]->debug_navmesh_dirty = true;
 		}
 		for (int i = 0; i < cached_navmeshes.size(); ++i)
@@ -334,8 +887,27 @@ void DetourNavigation::manage_changes()
 		collisions_to_remove.clear();
 	}
 
+	if (authored_nodes_changed)
+	{
+		for (int i = 0; i < navmeshes.size(); ++i)
+		{
+			navmeshes[i]->recalculate_tiles();
+			navmeshes[i]->debug_navmesh_dirty = true;
+		}
+		for (int i = 0; i < cached_navmeshes.size(); ++i)
+		{
+			cached_navmeshes[i]->recalculate_tiles();
+			cached_navmeshes[i]->debug_navmesh_dirty = true;
+		}
+		authored_nodes_changed = false;
+	}
+
 	if (dyn_bodies_to_add.size() > 0)
 	{
+		/* A body is queued once per collision shape that entered the tree */
+		std::sort(dyn_bodies_to_add.begin(), dyn_bodies_to_add.end());
+		dyn_bodies_to_add.erase(std::unique(dyn_bodies_to_add.begin(), dyn_bodies_to_add.end()), dyn_bodies_to_add.end());
+
 		for (PhysicsBody *physics_body : dyn_bodies_to_add)
 		{
 			for (int i = 0; i < physics_body->get_child_count(); ++i)
@@ -343,44 +915,351 @@ void DetourNavigation::manage_changes()
 				CollisionShape *collision_shape =
 					Object::cast_to<CollisionShape>(
 						physics_body->get_child(i));
-				if (collision_shape == NULL)
-				{
-					continue;
-				}
-				Transform transform = collision_shape->get_global_transform();
-
-				Ref<Shape> s = collision_shape->get_shape();
-				if (s->get_class() == "BoxShape")
+				if (collision_shape != NULL && describe_obstacle(collision_shape, static_cast<int>(physics_body->get_collision_layer())))
 				{
-					Ref<BoxShape> box = Object::cast_to<BoxShape>(*s);
-					add_box_obstacle_to_all(collision_shape->get_instance_id(),
-											transform.get_origin(),
-											box->get_extents() * transform.get_basis().get_scale(),
-											static_cast<float>(transform.basis.orthonormalized().get_euler().y),
-											static_cast<int>(physics_body->get_collision_layer()));
-					box.unref();
+					track_obstacle(collision_shape);
 				}
-				else if (s->get_class() == "CylinderShape")
-				{
-					Ref<CylinderShape> cylinder = Object::cast_to<CylinderShape>(*s);
-					add_cylinder_obstacle_to_all(
-						collision_shape->get_instance_id(),
-						transform.get_origin() - Vector3(0.f,
-														 cylinder->get_height() * 0.5f, 0.f),
-						cylinder->get_radius() * std::max(
-													 transform.get_basis().get_scale().x,
-													 transform.get_basis().get_scale().z),
-						cylinder->get_height() * transform.get_basis().get_scale().y,
-						static_cast<int>(physics_body->get_collision_layer()));
-					cylinder.unref();
-				}
-				cached_navmeshes[i]->debug_navmesh_dirty = true;
 			}
 		}
 
-		update_tilecache();
 		dyn_bodies_to_add.clear();
 	}
+
+	if (footprints_stale)
+	{
+		prune_convex_footprints();
+		footprints_stale = false;
+	}
+}
+
+/**
+ * Convex outline of points in the x/z plane, counter-clockwise (monotone chain)
+ */
+static std::vector<Vector2> convex_outline(std::vector<Vector2> points)
+{
+	std::sort(points.begin(), points.end(), [](const Vector2 &a, const Vector2 &b) {
+		return a.x < b.x || (a.x == b.x && a.y < b.y);
+	});
+	if (points.size() < 3)
+	{
+		return points;
+	}
+	std::vector<Vector2> outline(points.size() * 2);
+	size_t k = 0;
+	for (size_t i = 0; i < points.size(); i++)
+	{
+		while (k >= 2 && (outline[k - 1] - outline[k - 2]).cross(points[i] - outline[k - 2]) <= 0.f)
+		{
+			k--;
+		}
+		outline[k++] = points[i];
+	}
+	for (size_t i = points.size() - 1, lower = k + 1; i > 0; i--)
+	{
+		while (k >= lower && (outline[k - 1] - outline[k - 2]).cross(points[i - 1] - outline[k - 2]) <= 0.f)
+		{
+			k--;
+		}
+		outline[k++] = points[i - 1];
+	}
+	outline.resize(k - 1);
+	return outline;
+}
+
+/* FNV-1a of the point coordinates */
+static uint64_t hash_points(const PoolVector3Array::Read &points, int count)
+{
+	uint64_t hash = 14695981039346656037ULL;
+	const unsigned char *bytes = (const unsigned char *)points.ptr();
+	for (size_t i = 0; i < count * sizeof(Vector3); i++)
+	{
+		hash = (hash ^ bytes[i]) * 1099511628211ULL;
+	}
+	return hash;
+}
+
+/**
+ * Hull and outline of a convex shape, computed once per shape resource and
+ * again only if its points change
+ */
+const DetourNavigation::ConvexFootprint &DetourNavigation::get_convex_footprint(Ref<ConvexPolygonShape> shape)
+{
+	PoolVector3Array points = shape->get_points();
+	PoolVector3Array::Read points_read = points.read();
+	uint64_t points_hash = hash_points(points_read, points.size());
+	ConvexFootprint &footprint = convex_footprints[shape->get_instance_id()];
+	if (footprint.points_hash == points_hash && !footprint.hull.empty())
+	{
+		return footprint;
+	}
+	footprint = ConvexFootprint();
+	footprint.points_hash = points_hash;
+	if (points.size() == 0)
+	{
+		return footprint;
+	}
+
+	if (points.size() < 4)
+	{
+		footprint.hull.assign(points_read.ptr(), points_read.ptr() + points.size());
+	}
+	else
+	{
+		qh_vertex_t *vertices = new qh_vertex_t[points.size()];
+		for (int i = 0; i < points.size(); ++i)
+		{
+			vertices[i].x = points_read[i].x;
+			vertices[i].y = points_read[i].y;
+			vertices[i].z = points_read[i].z;
+		}
+		qh_mesh_t qh_mesh = qh_quickhull3d(vertices, points.size());
+		delete[] vertices;
+		/* Vertices are listed per triangle */
+		for (unsigned int j = 0; j < qh_mesh.nvertices; j++)
+		{
+			Vector3 vertex(qh_mesh.vertices[j].x, qh_mesh.vertices[j].y, qh_mesh.vertices[j].z);
+			if (std::find(footprint.hull.begin(), footprint.hull.end(), vertex) == footprint.hull.end())
+			{
+				footprint.hull.push_back(vertex);
+			}
+		}
+		qh_free_mesh(qh_mesh);
+	}
+	/* Quickhull gives up on degenerate points */
+	if (footprint.hull.empty())
+	{
+		return footprint;
+	}
+
+	std::vector<Vector2> projected;
+	footprint.min_y = footprint.max_y = footprint.hull[0].y;
+	for (const Vector3 &vertex : footprint.hull)
+	{
+		projected.push_back(Vector2(vertex.x, vertex.z));
+		footprint.min_y = std::min(footprint.min_y, vertex.y);
+		footprint.max_y = std::max(footprint.max_y, vertex.y);
+	}
+	footprint.outline = convex_outline(projected);
+	return footprint;
+}
+
+/**
+ * Drops the footprints of shape resources that were freed
+ */
+void DetourNavigation::prune_convex_footprints()
+{
+	for (std::unordered_map<int64_t, ConvexFootprint>::iterator it = convex_footprints.begin(); it != convex_footprints.end();)
+	{
+		if (core_1_1_api->godot_instance_from_id(it->first) == nullptr)
+		{
+			it = convex_footprints.erase(it);
+		}
+		else
+		{
+			++it;
+		}
+	}
+}
+
+/**
+ * Describes the obstacle of a collision shape where it is now. Capsules and
+ * spheres become cylinders around them. Convex shapes keep their outline as
+ * seen from above; upright ones reuse the outline cached for the shape
+ * resource, tilted ones project its hull again.
+ *
+ * @return false for other shapes
+ */
+bool DetourNavigation::make_obstacle_request(CollisionShape *collision_shape, DetourNavigationMeshCached::ObstacleRequest &request)
+{
+	Transform transform = collision_shape->get_global_transform();
+	Vector3 scale = transform.get_basis().get_scale();
+	float max_scale = std::max(scale.x, std::max(scale.y, scale.z));
+	Ref<Shape> s = collision_shape->get_shape();
+	if (s.is_null())
+	{
+		return false;
+	}
+	bool supported = true;
+	if (s->get_class() == "BoxShape")
+	{
+		Ref<BoxShape> box = Object::cast_to<BoxShape>(*s);
+		request.type = DetourNavigationMeshCached::ObstacleRequest::ADD_BOX;
+		request.position = transform.get_origin();
+		request.extents = box->get_extents() * transform.get_basis().get_scale();
+		request.rotation = static_cast<float>(transform.basis.orthonormalized().get_euler().y);
+		box.unref();
+	}
+	else if (s->get_class() == "CylinderShape")
+	{
+		Ref<CylinderShape> cylinder = Object::cast_to<CylinderShape>(*s);
+		request.type = DetourNavigationMeshCached::ObstacleRequest::ADD_CYLINDER;
+		request.position = transform.get_origin() - Vector3(0.f,
+															cylinder->get_height() * 0.5f, 0.f);
+		request.radius = cylinder->get_radius() * std::max(
+													  transform.get_basis().get_scale().x,
+													  transform.get_basis().get_scale().z);
+		request.height = cylinder->get_height() * transform.get_basis().get_scale().y;
+		cylinder.unref();
+	}
+	else if (s->get_class() == "CapsuleShape")
+	{
+		Ref<CapsuleShape> capsule = Object::cast_to<CapsuleShape>(*s);
+		/* The capsule's axis is its local z, the cylinder holds both end spheres in any pose */
+		float half_height = capsule->get_height() * 0.5f;
+		Vector3 a = transform.xform(Vector3(0.f, 0.f, half_height));
+		Vector3 b = transform.xform(Vector3(0.f, 0.f, -half_height));
+		float radius = capsule->get_radius() * max_scale;
+		request.type = DetourNavigationMeshCached::ObstacleRequest::ADD_CYLINDER;
+		request.position = Vector3((a.x + b.x) * 0.5f, std::min(a.y, b.y) - radius, (a.z + b.z) * 0.5f);
+		request.radius = Vector2(a.x - b.x, a.z - b.z).length() * 0.5f + radius;
+		request.height = std::fabs(a.y - b.y) + 2.f * radius;
+		capsule.unref();
+	}
+	else if (s->get_class() == "SphereShape")
+	{
+		Ref<SphereShape> sphere = Object::cast_to<SphereShape>(*s);
+		float radius = sphere->get_radius() * max_scale;
+		request.type = DetourNavigationMeshCached::ObstacleRequest::ADD_CYLINDER;
+		request.position = transform.get_origin() - Vector3(0.f, radius, 0.f);
+		request.radius = radius;
+		request.height = 2.f * radius;
+		sphere.unref();
+	}
+	else if (s->get_class() == "ConvexPolygonShape")
+	{
+		Ref<ConvexPolygonShape> convex = Object::cast_to<ConvexPolygonShape>(*s);
+		const ConvexFootprint &footprint = get_convex_footprint(convex);
+		convex.unref();
+
+		const Basis &basis = transform.get_basis();
+		Vector3 up = basis.get_axis(1);
+		std::vector<Vector2> outline;
+		float min_y, max_y;
+		if (std::fabs(up.x) < UPRIGHT_EPSILON && std::fabs(up.z) < UPRIGHT_EPSILON && up.y > 0.f &&
+			std::fabs(basis.get_axis(0).y) < UPRIGHT_EPSILON && std::fabs(basis.get_axis(2).y) < UPRIGHT_EPSILON)
+		{
+			for (const Vector2 &point : footprint.outline)
+			{
+				Vector3 world = transform.xform(Vector3(point.x, 0.f, point.y));
+				outline.push_back(Vector2(world.x, world.z));
+			}
+			min_y = transform.get_origin().y + footprint.min_y * up.y;
+			max_y = transform.get_origin().y + footprint.max_y * up.y;
+		}
+		else
+		{
+			std::vector<Vector2> projected;
+			min_y = FLT_MAX;
+			max_y = -FLT_MAX;
+			for (const Vector3 &vertex : footprint.hull)
+			{
+				Vector3 world = transform.xform(vertex);
+				projected.push_back(Vector2(world.x, world.z));
+				min_y = std::min(min_y, world.y);
+				max_y = std::max(max_y, world.y);
+			}
+			outline = convex_outline(projected);
+		}
+		if (outline.size() < 3)
+		{
+			supported = false;
+		}
+		else
+		{
+			request.type = DetourNavigationMeshCached::ObstacleRequest::ADD_CONVEX;
+			request.position = Vector3(transform.get_origin().x, min_y, transform.get_origin().z);
+			request.height = max_y - min_y;
+			request.footprint.clear();
+			for (const Vector2 &point : outline)
+			{
+				request.footprint.push_back(point.x);
+				request.footprint.push_back(min_y);
+				request.footprint.push_back(point.y);
+			}
+		}
+	}
+	else
+	{
+		supported = false;
+	}
+	s.unref();
+	return supported;
+}
+
+/**
+ * Remembers where the obstacle of the shape was placed, so it can be
+ * moved with its body
+ */
+void DetourNavigation::track_obstacle(CollisionShape *collision_shape)
+{
+	ObstacleRegistry::Entry *entry = obstacles.find(collision_shape->get_instance_id());
+	if (entry == nullptr)
+	{
+		return;
+	}
+	Transform transform = collision_shape->get_global_transform();
+	entry->tracked = track_moving_obstacles;
+	entry->position = transform.get_origin();
+	entry->rotation = static_cast<float>(transform.basis.orthonormalized().get_euler().y);
+	entry->last_update = physics_time;
+}
+
+/**
+ * Samples tracked obstacles and describes the ones that moved or turned
+ * past the thresholds again, at most once per obstacle_update_interval
+ * each. Every navmesh applies all of them in one batch on its next update.
+ */
+void DetourNavigation::_physics_process(float delta)
+{
+	physics_time += delta;
+	if (!track_moving_obstacles || obstacles.get_count() == 0)
+	{
+		return;
+	}
+
+	const float two_pi = 2.f * static_cast<float>(Math_PI);
+	float rotation_threshold = obstacle_rotation_threshold * static_cast<float>(Math_PI) / 180.f;
+	std::vector<int64_t> freed;
+	for (ObstacleRegistry::Entry &entry : obstacles.get_entries())
+	{
+		if (!entry.tracked || physics_time - entry.last_update < obstacle_update_interval)
+		{
+			continue;
+		}
+		/* The pointer is only used while the instance id still resolves */
+		if (core_1_1_api->godot_instance_from_id(entry.owner) == nullptr)
+		{
+			freed.push_back(entry.owner);
+			continue;
+		}
+		Transform transform = entry.collision_shape->get_global_transform();
+		float rotation = static_cast<float>(transform.basis.orthonormalized().get_euler().y);
+		float turned = std::fmod(std::fabs(rotation - entry.rotation), two_pi);
+		turned = std::min(turned, two_pi - turned);
+		if (transform.get_origin().distance_to(entry.position) < obstacle_move_threshold && turned < rotation_threshold)
+		{
+			continue;
+		}
+
+		DetourNavigationMeshCached::ObstacleRequest request;
+		if (!make_obstacle_request(entry.collision_shape, request))
+		{
+			continue;
+		}
+		entry.obstacle = request;
+		entry.position = transform.get_origin();
+		entry.rotation = rotation;
+		entry.last_update = physics_time;
+		obstacles.mark_changed(entry.owner);
+		set_process(true);
+	}
+	/* Shapes freed without leaving the tree through node_removed */
+	for (int64_t owner : freed)
+	{
+		obstacles.erase(owner);
+		obstacles.mark_changed(owner);
+		set_process(true);
+	}
 }
 
 void DetourNavigation::rebuild_dirty_debug_meshes()
@@ -424,13 +1303,8 @@ void DetourNavigation::_on_cache_collision_shape_removed(Variant node)
 		node.operator Object *());
 	if (collision_shape)
 	{
-		PhysicsBody *physics_body = Object::cast_to<PhysicsBody>(
-			collision_shape->get_parent());
-
-		if (physics_body && physics_body->get_collision_layer() & get_dynamic_collision_mask())
-		{
-			remove_obstacle(collision_shape);
-		}
+		/* Unconditionally, the layer may have changed or the shape moved to another body */
+		remove_obstacle(collision_shape);
 	}
 }
 
@@ -501,7 +1375,9 @@ void DetourNavigation::build_navmesh(DetourNavigationMesh *navmesh)
 	DetourNavigationMeshGenerator *dtnavmesh_gen = navmesh->init_generator(get_global_transform());
 
 	DetourNavigation::collect_geometry(get_children(), dtnavmesh_gen->input_meshes, dtnavmesh_gen->input_transforms,
-									   dtnavmesh_gen->input_aabbs, dtnavmesh_gen->collision_ids, navmesh);
+									   dtnavmesh_gen->input_aabbs, dtnavmesh_gen->collision_ids,
+									   dtnavmesh_gen->collision_layers, navmesh);
+	collect_authored_nodes(get_children(), dtnavmesh_gen);
 
 	dtnavmesh_gen->build();
 
@@ -524,12 +1400,15 @@ void DetourNavigation::build_navmesh_cached(
 	DetourNavigationMeshCacheGenerator *dtnavmesh_gen = navmesh->init_generator(get_global_transform());
 
 	DetourNavigation::collect_geometry(get_children(), dtnavmesh_gen->input_meshes, dtnavmesh_gen->input_transforms,
-									   dtnavmesh_gen->input_aabbs, dtnavmesh_gen->collision_ids, navmesh);
+									   dtnavmesh_gen->input_aabbs, dtnavmesh_gen->collision_ids,
+									   dtnavmesh_gen->collision_layers, navmesh);
+	collect_authored_nodes(get_children(), dtnavmesh_gen);
 	dtnavmesh_gen->build();
 
 	navmesh->detour_navmesh = dtnavmesh_gen->detour_navmesh;
 	navmesh->tile_cache = dtnavmesh_gen->get_tile_cache();
 	navmesh->tile_cache_compressor = dtnavmesh_gen->get_tile_cache_compressor();
+	navmesh->tile_cache_alloc = dtnavmesh_gen->get_tile_cache_alloc();
 	navmesh->mesh_process = dtnavmesh_gen->get_mesh_process();
 	if (get_tree()->is_debugging_navigation_hint() || Engine::get_singleton()->is_editor_hint())
 	{
@@ -557,9 +1436,9 @@ void DetourNavigation::_notification(int p_what)
  * @return 1 for mesh found and 0 if mesh is too small to be split
  */
 int DetourNavigation::process_large_mesh(MeshInstance *mesh_instance,
-										 int64_t collision_id, std::vector<Ref<Mesh>> *meshes,
+										 int64_t collision_id, int collision_layer, std::vector<Ref<Mesh>> *meshes,
 										 std::vector<Transform> *transforms, std::vector<AABB> *aabbs,
-										 std::vector<int64_t> *collision_ids)
+										 std::vector<int64_t> *collision_ids, std::vector<int> *collision_layers)
 {
 	if (mesh_instance->get_mesh()->get_class() != "ArrayMesh")
 	{
@@ -693,6 +1572,7 @@ int DetourNavigation::process_large_mesh(MeshInstance *mesh_instance,
 				meshes->push_back(am);
 				transforms->push_back(mesh_instance->get_transform());
 				collision_ids->push_back(collision_id);
+				collision_layers->push_back(collision_layer);
 			}
 		}
 	}
@@ -709,9 +1589,13 @@ int DetourNavigation::process_large_mesh(MeshInstance *mesh_instance,
  */
 void DetourNavigation::convert_collision_shape(CollisionShape *collision_shape,
 											   std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
-											   std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids)
+											   std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids,
+											   std::vector<int> *collision_layers)
 {
 	Transform transform = collision_shape->get_global_transform();
+	/* Layers of the body pick the area type of its polygons */
+	CollisionObject *body = Object::cast_to<CollisionObject>(collision_shape->get_parent());
+	int collision_layer = body ? (int)body->get_collision_layer() : 0;
 
 	Ref<Mesh> mesh;
 	Ref<Shape> s = collision_shape->get_shape();
@@ -836,13 +1720,14 @@ void DetourNavigation::convert_collision_shape(CollisionShape *collision_shape,
 		MeshInstance *mi = MeshInstance::_new();
 		mi->set_mesh(mesh);
 		mi->set_transform(transform);
-		if (!process_large_mesh(mi, collision_shape->get_instance_id(), meshes,
-								transforms, aabbs, collision_ids))
+		if (!process_large_mesh(mi, collision_shape->get_instance_id(), collision_layer, meshes,
+								transforms, aabbs, collision_ids, collision_layers))
 		{
 			aabbs->push_back(mi->get_aabb());
 			meshes->push_back(mesh);
 			transforms->push_back(transform);
 			collision_ids->push_back(collision_shape->get_instance_id());
+			collision_layers->push_back(collision_layer);
 		}
 		mi->set_mesh(NULL);
 		mi->queue_free();
@@ -856,7 +1741,7 @@ void DetourNavigation::convert_collision_shape(CollisionShape *collision_shape,
 void DetourNavigation::collect_geometry(Array geometries,
 										std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
 										std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids,
-										DetourNavigationMesh *navmesh)
+										std::vector<int> *collision_layers, DetourNavigationMesh *navmesh)
 {
 
 	int geom_size = geometries.size();
@@ -889,7 +1774,7 @@ void DetourNavigation::collect_geometry(Array geometries,
 					if (collision_shape)
 					{
 						convert_collision_shape(collision_shape, meshes,
-												transforms, aabbs, collision_ids);
+												transforms, aabbs, collision_ids, collision_layers);
 					}
 				}
 			}
@@ -898,7 +1783,7 @@ void DetourNavigation::collect_geometry(Array geometries,
 		if (spatial)
 		{
 			collect_geometry(spatial->get_children(), meshes, transforms,
-							 aabbs, collision_ids, navmesh);
+							 aabbs, collision_ids, collision_layers, navmesh);
 		}
 	}
 }
@@ -26,6 +26,7 @@
 #include <SphereMesh.hpp>
 #include <StaticBody.hpp>
 #include <CollisionShape.hpp>
+#include <CollisionObject.hpp>
 
 #include "navigation_mesh.h"
 #include "tilecache_navmesh.h"
@@ -36,6 +37,9 @@
 #include "helpers.h"
 #include "navmesh_generator.h"
 #include "tilecache_generator.h"
+#include "area_volume.h"
+#include "offmesh_link.h"
+#include "obstacle_registry.h"
 
 namespace godot
 {
@@ -66,15 +70,54 @@ private:
 	void collect_geometry(Array geometries,
 						  std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
 						  std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids,
-						  DetourNavigationMesh *navmesh);
+						  std::vector<int> *collision_layers, DetourNavigationMesh *navmesh);
 
 	void convert_collision_shape(CollisionShape *collision_shape,
 								 std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
-								 std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids);
+								 std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids,
+								 std::vector<int> *collision_layers);
+
+	/* Obstacles of dynamic collision shapes, shared by the cached navmeshes */
+	ObstacleRegistry obstacles;
+	double physics_time = 0.0;
+
+	SETGET(track_moving_obstacles, bool);
+	SETGET(obstacle_move_threshold, float);
+	SETGET(obstacle_rotation_threshold, float);
+	SETGET(obstacle_update_interval, float);
+	/* Milliseconds per frame the tile caches may spend rebuilding tiles */
+	SETGET(tile_update_budget, float);
+
+	/* Hull of a convex shape resource in its own space, shared by every shape using the resource */
+	struct ConvexFootprint
+	{
+		/* Of the points the hull was made from, edited points make a new hull */
+		uint64_t points_hash = 0;
+		std::vector<Vector3> hull;
+		/* Outline of the hull seen along its own y axis, and the hull's y range */
+		std::vector<Vector2> outline;
+		float min_y = 0.f;
+		float max_y = 0.f;
+	};
+	std::unordered_map<int64_t, ConvexFootprint> convex_footprints;
+	const ConvexFootprint &get_convex_footprint(Ref<ConvexPolygonShape> shape);
+	void prune_convex_footprints();
+	/* Obstacles were removed since the last prune, their shape resources may be gone */
+	bool footprints_stale = false;
+
+	bool make_obstacle_request(CollisionShape *collision_shape, DetourNavigationMeshCached::ObstacleRequest &request);
+	bool describe_obstacle(CollisionShape *collision_shape, int collision_layer);
+	void place_obstacles(DetourNavigationMeshCached *navmesh, const std::vector<int64_t> &owners, bool wait);
+	void sync_obstacles(DetourNavigationMeshCached *navmesh);
+	void track_obstacle(CollisionShape *collision_shape);
 
 	std::vector<PhysicsBody *> dyn_bodies_to_add;
 	std::vector<StaticBody *> static_bodies_to_add;
 	std::vector<int64_t> collisions_to_remove;
+	/* Area volumes or off-mesh links changed, their tiles are dirty */
+	bool authored_nodes_changed = false;
+
+	void collect_authored_nodes(Array nodes, DetourNavigationMeshGenerator *generator);
 
 public:
 	static void _register_methods();
@@ -95,19 +138,30 @@ public:
 	void fill_pointer_arrays();
 	void manage_changes();
 	void update_tilecache();
+	void refresh_landmarks();
+	void process_path_requests();
 	void rebuild_dirty_debug_meshes();
 
-	void add_box_obstacle_to_all(int64_t instance_id, Vector3 position,
-								 Vector3 extents, float rotationY, int collision_layer);
-
-	void add_cylinder_obstacle_to_all(int64_t instance_id, Vector3 position,
-									  float radius, float height, int collision_layer);
-
 	void remove_obstacle(CollisionShape *collision_shape);
+	void update_obstacle(CollisionShape *collision_shape);
+	void refresh_obstacles(DetourNavigationMeshCached *navmesh, const std::vector<int64_t> &owners);
+	Dictionary get_obstacle_stats();
 
 	void save_collision_shapes(DetourNavigationMeshGenerator *generator);
 
+	void update_area_volume(DetourAreaVolume *volume);
+	void remove_area_volume(DetourAreaVolume *volume);
+	void update_offmesh_link(DetourOffMeshLink *link);
+	void remove_offmesh_link(DetourOffMeshLink *link);
+
 	void _process(float passed);
+	void _physics_process(float delta);
+
+	DetourNavigationMesh *select_navmesh(float radius, float height, float climb);
+	DetourNavigationMesh *get_navmesh_for_agent(Dictionary agent_profile);
+	Dictionary find_path(Dictionary agent_profile, Vector3 from, Vector3 to);
+	Dictionary find_paths(Array agent_profiles, PoolIntArray profile_ids, PoolVector3Array from, PoolVector3Array to);
+	void request_paths(Array agent_profiles, PoolIntArray profile_ids, PoolVector3Array from, PoolVector3Array to, PoolIntArray callback_ids);
 
 	DetourNavigationMeshCached *create_cached_navmesh(
 		Ref<CachedNavmeshParameters> np);
@@ -122,9 +176,10 @@ public:
 	void _notification(int p_what);
 	void _on_node_renamed(Variant v);
 
-	int process_large_mesh(MeshInstance *mesh_instance, int64_t collision_id,
+	int process_large_mesh(MeshInstance *mesh_instance, int64_t collision_id, int collision_layer,
 						   std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
-						   std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids);
+						   std::vector<AABB> *aabbs, std::vector<int64_t> *collision_ids,
+						   std::vector<int> *collision_layers);
 
 	void _on_cache_collision_shape_added(Variant node);
 	void _on_cache_collision_shape_removed(Variant node);
@@ -0,0 +1,246 @@
+#include <algorithm>
+#include <shared_mutex>
+#include "navigation_corridor.h"
+
+using namespace godot;
+
+void DetourPathCorridor::_register_methods()
+{
+	register_method("reset", &DetourPathCorridor::reset);
+	register_method("move_position", &DetourPathCorridor::move_position);
+	register_method("move_target", &DetourPathCorridor::move_target);
+	register_method("optimize_visibility", &DetourPathCorridor::optimize_visibility);
+	register_method("optimize_topology", &DetourPathCorridor::optimize_topology);
+	register_method("is_valid", &DetourPathCorridor::is_valid);
+	register_method("get_corners", &DetourPathCorridor::get_corners);
+	register_method("get_position", &DetourPathCorridor::get_position);
+	register_method("get_target", &DetourPathCorridor::get_target);
+	register_method("get_path_count", &DetourPathCorridor::get_path_count);
+}
+
+DetourPathCorridor::DetourPathCorridor()
+{
+}
+
+DetourPathCorridor::~DetourPathCorridor()
+{
+	if (navmesh != nullptr)
+	{
+		navmesh->remove_path_corridor(this);
+	}
+}
+
+void DetourPathCorridor::_init()
+{
+}
+
+void DetourPathCorridor::attach(DetourNavigationMesh *nm)
+{
+	navmesh = nm;
+	DetourNavigationQuery *query = get_query();
+	int max_path = query ? query->get_max_polys() : 256;
+	path.resize(max_path);
+	corridor.init(max_path);
+}
+
+/* Called by the navigation mesh when it's freed before the corridor */
+void DetourPathCorridor::detach()
+{
+	navmesh = nullptr;
+	has_path = false;
+}
+
+DetourNavigationQuery *DetourPathCorridor::get_query()
+{
+	if (navmesh == nullptr || navmesh->get_detour_navmesh() == nullptr)
+	{
+		return nullptr;
+	}
+	return navmesh->get_nav_query();
+}
+
+/**
+ * Plans a full path once, later movement only patches the corridor.
+ *
+ * @return true if a (possibly partial) path was found
+ */
+bool DetourPathCorridor::reset(Vector3 position, Vector3 target)
+{
+	has_path = false;
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr)
+	{
+		return false;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	dtNavMeshQuery *navmesh_query = query->get_navmesh_query();
+	const dtQueryFilter *filter = navmesh->query_filter->dt_query_filter;
+
+	Vector3 local_start = query->get_inverse().xform(position);
+	Vector3 local_end = query->get_inverse().xform(target);
+	dtPolyRef start_ref, end_ref;
+	float start_nearest[3], end_nearest[3];
+	if (dtStatusFailed(query->find_nearest_poly(&local_start.coord[0], navmesh->query_filter, &start_ref, start_nearest)) || !start_ref)
+	{
+		return false;
+	}
+	if (dtStatusFailed(query->find_nearest_poly(&local_end.coord[0], navmesh->query_filter, &end_ref, end_nearest)) || !end_ref)
+	{
+		return false;
+	}
+
+	int path_count = 0;
+	dtStatus status = navmesh_query->findPath(start_ref, end_ref, start_nearest, end_nearest, filter, path.data(), &path_count, (int)path.size());
+	if (dtStatusFailed(status) || path_count == 0)
+	{
+		return false;
+	}
+
+	/* Partial path, aim for the closest point of the last reachable polygon */
+	if (path[path_count - 1] != end_ref)
+	{
+		navmesh_query->closestPointOnPoly(path[path_count - 1], end_nearest, end_nearest, nullptr);
+	}
+
+	corridor.reset(start_ref, start_nearest);
+	corridor.setCorridor(end_nearest, path.data(), path_count);
+	has_path = true;
+	return true;
+}
+
+/**
+ * Moves the start of the corridor along the navmesh surface.
+ *
+ * @return position constrained to the navmesh
+ */
+Vector3 DetourPathCorridor::move_position(Vector3 position)
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return position;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	Vector3 local = query->get_inverse().xform(position);
+	corridor.movePosition(&local.coord[0], query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+	const float *pos = corridor.getPos();
+	return query->get_transform().xform(Vector3(pos[0], pos[1], pos[2]));
+}
+
+/**
+ * Moves the end of the corridor towards the new target, suited for targets
+ * that move a little every frame. Call reset() when the target jumps far.
+ */
+bool DetourPathCorridor::move_target(Vector3 target)
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return false;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	Vector3 local = query->get_inverse().xform(target);
+	return corridor.moveTargetPosition(&local.coord[0], query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+}
+
+/**
+ * Shortcuts the corridor towards next (usually the furthest visible corner)
+ * if there is a straight line within range.
+ */
+void DetourPathCorridor::optimize_visibility(Vector3 next, float range)
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	Vector3 local = query->get_inverse().xform(next);
+	corridor.optimizePathVisibility(&local.coord[0], range, query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+}
+
+bool DetourPathCorridor::optimize_topology()
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return false;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	return corridor.optimizePathTopology(query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+}
+
+/**
+ * @return false if polygons in the first max_look_ahead corridor entries were
+ * removed by a tile rebuild, in that case the corridor has to be reset
+ */
+bool DetourPathCorridor::is_valid(int max_look_ahead)
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return false;
+	}
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	return corridor.isValid(max_look_ahead, query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+}
+
+/**
+ * @returns up to max_corners next straight path points in global space
+ */
+PoolVector3Array DetourPathCorridor::get_corners(int max_corners)
+{
+	PoolVector3Array result;
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return result;
+	}
+	max_corners = std::min(std::max(max_corners, 1), MAX_CORNERS);
+
+	float corner_verts[MAX_CORNERS * 3];
+	unsigned char corner_flags[MAX_CORNERS];
+	dtPolyRef corner_polys[MAX_CORNERS];
+	int count;
+	{
+		std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+		count = corridor.findCorners(corner_verts, corner_flags, corner_polys, max_corners,
+									 query->get_navmesh_query(), navmesh->query_filter->dt_query_filter);
+	}
+
+	result.resize(count);
+	PoolVector3Array::Write w = result.write();
+	for (int i = 0; i < count; i++)
+	{
+		w[i] = query->get_transform().xform(
+			Vector3(corner_verts[i * 3], corner_verts[i * 3 + 1], corner_verts[i * 3 + 2]));
+	}
+	return result;
+}
+
+Vector3 DetourPathCorridor::get_position()
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return Vector3();
+	}
+	const float *pos = corridor.getPos();
+	return query->get_transform().xform(Vector3(pos[0], pos[1], pos[2]));
+}
+
+Vector3 DetourPathCorridor::get_target()
+{
+	DetourNavigationQuery *query = get_query();
+	if (query == nullptr || !has_path)
+	{
+		return Vector3();
+	}
+	const float *target = corridor.getTarget();
+	return query->get_transform().xform(Vector3(target[0], target[1], target[2]));
+}
+
+int DetourPathCorridor::get_path_count()
+{
+	return has_path ? corridor.getPathCount() : 0;
+}
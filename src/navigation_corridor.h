@@ -0,0 +1,59 @@
+#ifndef NAVIGATION_CORRIDOR_H
+#define NAVIGATION_CORRIDOR_H
+
+#include <vector>
+#include <Godot.hpp>
+#include <Reference.hpp>
+#include <PoolArrays.hpp>
+
+#include "navigation_mesh.h"
+#include "navigation_query.h"
+#include "DetourPathCorridor.h"
+
+namespace godot
+{
+
+/**
+ * Path corridor of a single agent, created by DetourNavigationMesh.
+ * After the initial reset the corridor is kept up to date with local
+ * fix-ups when the agent or its target moves, instead of a new A*.
+ */
+class DetourPathCorridor : public Reference
+{
+	GODOT_CLASS(DetourPathCorridor, Reference);
+
+private:
+	static const int MAX_CORNERS = 32;
+
+	dtPathCorridor corridor;
+	DetourNavigationMesh *navmesh = nullptr;
+	std::vector<dtPolyRef> path;
+	bool has_path = false;
+
+	DetourNavigationQuery *get_query();
+
+public:
+	DetourPathCorridor();
+	~DetourPathCorridor();
+
+	void _init();
+	static void _register_methods();
+
+	void attach(DetourNavigationMesh *nm);
+	void detach();
+
+	bool reset(Vector3 position, Vector3 target);
+	Vector3 move_position(Vector3 position);
+	bool move_target(Vector3 target);
+	void optimize_visibility(Vector3 next, float range);
+	bool optimize_topology();
+	bool is_valid(int max_look_ahead);
+	PoolVector3Array get_corners(int max_corners);
+
+	Vector3 get_position();
+	Vector3 get_target();
+	int get_path_count();
+};
+
+} // namespace godot
+#endif
@@ -0,0 +1,448 @@
+#include <cstring>
+#include "navigation_crowd.h"
+
+using namespace godot;
+
+static const int DEFAULT_MAX_AGENTS = 1024;
+static const float DEFAULT_AGENT_RADIUS = 0.6f;
+static const float DEFAULT_AGENT_HEIGHT = 2.0f;
+static const float DEFAULT_MAX_SPEED = 3.5f;
+static const float DEFAULT_MAX_ACCELERATION = 8.0f;
+static const float DEFAULT_SEPARATION_WEIGHT = 2.0f;
+
+void DetourCrowd::_register_methods()
+{
+	register_method("_exit_tree", &DetourCrowd::_exit_tree);
+	register_method("_physics_process", &DetourCrowd::_physics_process);
+	register_method("add_agent", &DetourCrowd::add_agent);
+	register_method("remove_agent", &DetourCrowd::remove_agent);
+	register_method("set_agent_target", &DetourCrowd::set_agent_target);
+	register_method("set_agent_targets", &DetourCrowd::set_agent_targets);
+	register_method("get_agent_count", &DetourCrowd::get_agent_count);
+	register_method("get_agent_ids", &DetourCrowd::get_agent_ids);
+	register_method("get_agent_positions", &DetourCrowd::get_agent_positions);
+	register_method("get_agent_velocities", &DetourCrowd::get_agent_velocities);
+
+	register_property<DetourCrowd, NodePath>("navigation_mesh", &DetourCrowd::set_navigation_mesh, &DetourCrowd::get_navigation_mesh, NodePath());
+	register_property<DetourCrowd, int>("max_agents", &DetourCrowd::set_max_agents, &DetourCrowd::get_max_agents, DEFAULT_MAX_AGENTS);
+	register_property<DetourCrowd, real_t>("max_speed", &DetourCrowd::set_max_speed, &DetourCrowd::get_max_speed, DEFAULT_MAX_SPEED);
+	register_property<DetourCrowd, real_t>("max_acceleration", &DetourCrowd::set_max_acceleration, &DetourCrowd::get_max_acceleration, DEFAULT_MAX_ACCELERATION);
+	register_property<DetourCrowd, real_t>("separation_weight", &DetourCrowd::set_separation_weight, &DetourCrowd::get_separation_weight, DEFAULT_SEPARATION_WEIGHT);
+	register_property<DetourCrowd, bool>("threaded", &DetourCrowd::set_threaded, &DetourCrowd::get_threaded, true);
+}
+
+DetourCrowd::DetourCrowd()
+{
+}
+
+DetourCrowd::~DetourCrowd()
+{
+	release_crowd();
+}
+
+void DetourCrowd::_init()
+{
+	max_agents = DEFAULT_MAX_AGENTS;
+	max_speed = DEFAULT_MAX_SPEED;
+	max_acceleration = DEFAULT_MAX_ACCELERATION;
+	separation_weight = DEFAULT_SEPARATION_WEIGHT;
+	threaded = true;
+}
+
+void DetourCrowd::_exit_tree()
+{
+	detach_navmesh();
+}
+
+/**
+ * Binds the crowd to the navigation mesh set in properties. Navigation meshes
+ * are loaded by their DetourNavigation parent, so this is retried every frame
+ * until the navmesh is available.
+ *
+ * @return true if the crowd is ready to be updated
+ */
+bool DetourCrowd::init_crowd()
+{
+	if (navigation_mesh.is_empty() || !has_node(navigation_mesh))
+	{
+		return false;
+	}
+	navmesh = Object::cast_to<DetourNavigationMesh>(get_node(navigation_mesh));
+	if (navmesh == nullptr || navmesh->get_detour_navmesh() == nullptr)
+	{
+		return false;
+	}
+
+	float max_agent_radius = DEFAULT_AGENT_RADIUS;
+	if (navmesh->navmesh_parameters.is_valid())
+	{
+		max_agent_radius = navmesh->navmesh_parameters->get_agent_radius();
+	}
+
+	crowd = dtAllocCrowd();
+	if (!crowd || !crowd->init(max_agents, max_agent_radius, navmesh->get_detour_navmesh()))
+	{
+		ERR_PRINT("Failed to initialize detour crowd.");
+		dtFreeCrowd(crowd);
+		crowd = nullptr;
+		return false;
+	}
+
+	transform = navmesh->get_global_transform();
+	inverse = transform.inverse();
+	agent_ids.assign(max_agents, 0);
+	navmesh->add_crowd(this);
+	return true;
+}
+
+void DetourCrowd::release_crowd()
+{
+	stop_worker_thread();
+	if (crowd != nullptr)
+	{
+		dtFreeCrowd(crowd);
+		crowd = nullptr;
+	}
+	agent_indices.clear();
+	if (navmesh != nullptr)
+	{
+		navmesh->remove_crowd(this);
+		navmesh = nullptr;
+	}
+}
+
+/**
+ * Stops simulating on the navmesh and frees the crowd. Agents keep their
+ * ids, they're queued to be added with their positions and targets once
+ * init_crowd binds to a navmesh again.
+ */
+void DetourCrowd::detach_navmesh()
+{
+	stop_worker_thread();
+	requeue_agents();
+	release_crowd();
+}
+
+/**
+ * Queues the agents of the crowd ahead of the pending commands, the worker is idle
+ */
+void DetourCrowd::requeue_agents()
+{
+	if (crowd == nullptr)
+	{
+		return;
+	}
+	std::vector<AgentCommand> commands;
+	for (const std::pair<const int, int> &agent_index : agent_indices)
+	{
+		const dtCrowdAgent *agent = crowd->getAgent(agent_index.second);
+		if (agent == nullptr || !agent->active)
+		{
+			continue;
+		}
+		AgentCommand command;
+		command.type = COMMAND_ADD_AGENT;
+		command.id = agent_index.first;
+		command.position = transform.xform(Vector3(agent->npos[0], agent->npos[1], agent->npos[2]));
+		command.params = agent->params;
+		commands.push_back(command);
+		if (agent->targetState != DT_CROWDAGENT_TARGET_NONE && agent->targetState != DT_CROWDAGENT_TARGET_FAILED)
+		{
+			command.type = COMMAND_SET_TARGET;
+			command.position = transform.xform(Vector3(agent->targetPos[0], agent->targetPos[1], agent->targetPos[2]));
+			commands.push_back(command);
+		}
+	}
+	pending_commands.insert(pending_commands.begin(), commands.begin(), commands.end());
+}
+
+/**
+ * Collects the previous update, publishes it and starts the next one
+ */
+void DetourCrowd::_physics_process(float delta)
+{
+	if (crowd == nullptr && !init_crowd())
+	{
+		return;
+	}
+
+	wait_for_update();
+	apply_commands();
+
+	if (!threaded)
+	{
+		step(delta);
+		front_buffer = 1 - front_buffer;
+		return;
+	}
+
+	if (!worker.joinable())
+	{
+		start_worker();
+	}
+	{
+		std::lock_guard<std::mutex> lock(worker_mutex);
+		job_delta = delta;
+		job_pending = true;
+		job_running = true;
+	}
+	worker_cv.notify_all();
+}
+
+/**
+ * Simulates one crowd step and fills the back buffer, runs on the worker
+ */
+void DetourCrowd::step(float delta)
+{
+	CrowdOutput &output = buffers[1 - front_buffer];
+	output.ids.clear();
+	output.positions.clear();
+	output.velocities.clear();
+
+	std::shared_lock<std::shared_mutex> guard(navmesh->navmesh_lock);
+	crowd->update(delta, nullptr);
+
+	for (int i = 0; i < crowd->getAgentCount(); i++)
+	{
+		const dtCrowdAgent *agent = crowd->getAgent(i);
+		if (!agent->active)
+		{
+			continue;
+		}
+		output.ids.push_back(agent_ids[i]);
+		output.positions.push_back(transform.xform(
+			Vector3(agent->npos[0], agent->npos[1], agent->npos[2])));
+		output.velocities.push_back(transform.basis.xform(
+			Vector3(agent->vel[0], agent->vel[1], agent->vel[2])));
+	}
+}
+
+void DetourCrowd::worker_loop()
+{
+	std::unique_lock<std::mutex> lock(worker_mutex);
+	while (true)
+	{
+		worker_cv.wait(lock, [this] { return job_pending || stop_worker; });
+		if (stop_worker)
+		{
+			return;
+		}
+		job_pending = false;
+		float delta = job_delta;
+		lock.unlock();
+
+		step(delta);
+
+		lock.lock();
+		job_running = false;
+		worker_cv.notify_all();
+	}
+}
+
+void DetourCrowd::start_worker()
+{
+	stop_worker = false;
+	worker = std::thread(&DetourCrowd::worker_loop, this);
+}
+
+/**
+ * Blocks until the running update finishes and swaps the output buffers
+ */
+void DetourCrowd::wait_for_update()
+{
+	std::unique_lock<std::mutex> lock(worker_mutex);
+	if (!job_running)
+	{
+		return;
+	}
+	worker_cv.wait(lock, [this] { return !job_running; });
+	front_buffer = 1 - front_buffer;
+}
+
+void DetourCrowd::stop_worker_thread()
+{
+	if (!worker.joinable())
+	{
+		return;
+	}
+	wait_for_update();
+	{
+		std::lock_guard<std::mutex> lock(worker_mutex);
+		stop_worker = true;
+	}
+	worker_cv.notify_all();
+	worker.join();
+}
+
+/**
+ * Applies queued agent changes, the worker is idle when this is called
+ */
+void DetourCrowd::apply_commands()
+{
+	for (AgentCommand &command : pending_commands)
+	{
+		if (command.type == COMMAND_ADD_AGENT)
+		{
+			Vector3 local_position = inverse.xform(command.position);
+			int index = crowd->addAgent(&local_position.coord[0], &command.params);
+			if (index < 0)
+			{
+				ERR_PRINT("Can't add crowd agent, crowd is full.");
+				continue;
+			}
+			agent_indices[command.id] = index;
+			agent_ids[index] = command.id;
+			continue;
+		}
+
+		auto it = agent_indices.find(command.id);
+		if (it == agent_indices.end())
+		{
+			continue;
+		}
+
+		if (command.type == COMMAND_REMOVE_AGENT)
+		{
+			crowd->removeAgent(it->second);
+			agent_indices.erase(it);
+		}
+		else if (command.type == COMMAND_SET_TARGET)
+		{
+			Vector3 local_target = inverse.xform(command.position);
+			dtPolyRef target_ref = 0;
+			float nearest[3];
+			crowd->getNavMeshQuery()->findNearestPoly(
+				&local_target.coord[0], crowd->getQueryExtents(), crowd->getFilter(0), &target_ref, nearest);
+			if (target_ref)
+			{
+				crowd->requestMoveTarget(it->second, target_ref, nearest);
+			}
+		}
+	}
+	pending_commands.clear();
+}
+
+/**
+ * Creates agent params from the dictionary, missing values fall back to
+ * navmesh agent size and crowd properties
+ */
+dtCrowdAgentParams DetourCrowd::get_agent_params(Dictionary parameters)
+{
+	float radius = DEFAULT_AGENT_RADIUS;
+	float height = DEFAULT_AGENT_HEIGHT;
+	if (navmesh != nullptr && navmesh->navmesh_parameters.is_valid())
+	{
+		radius = navmesh->navmesh_parameters->get_agent_radius();
+		height = navmesh->navmesh_parameters->get_agent_height();
+	}
+
+	dtCrowdAgentParams params;
+	memset(&params, 0, sizeof(params));
+	params.radius = parameters.has("radius") ? (float)parameters["radius"] : radius;
+	params.height = parameters.has("height") ? (float)parameters["height"] : height;
+	params.maxSpeed = parameters.has("max_speed") ? (float)parameters["max_speed"] : max_speed;
+	params.maxAcceleration = parameters.has("max_acceleration") ? (float)parameters["max_acceleration"] : max_acceleration;
+	params.separationWeight = parameters.has("separation_weight") ? (float)parameters["separation_weight"] : separation_weight;
+	params.collisionQueryRange = params.radius * 12.0f;
+	params.pathOptimizationRange = params.radius * 30.0f;
+	params.updateFlags = DT_CROWD_ANTICIPATE_TURNS | DT_CROWD_OPTIMIZE_VIS |
+						 DT_CROWD_OPTIMIZE_TOPO | DT_CROWD_OBSTACLE_AVOIDANCE | DT_CROWD_SEPARATION;
+	params.obstacleAvoidanceType = 0;
+	params.queryFilterType = 0;
+	return params;
+}
+
+/**
+ * Queues a new agent, it is added to the crowd on the next physics frame
+ *
+ * @return id of the agent used by the other crowd methods
+ */
+int DetourCrowd::add_agent(Vector3 position, Dictionary parameters)
+{
+	AgentCommand command;
+	command.type = COMMAND_ADD_AGENT;
+	command.id = next_agent_id++;
+	command.position = position;
+	command.params = get_agent_params(parameters);
+	pending_commands.push_back(command);
+	return command.id;
+}
+
+void DetourCrowd::remove_agent(int id)
+{
+	AgentCommand command;
+	command.type = COMMAND_REMOVE_AGENT;
+	command.id = id;
+	pending_commands.push_back(command);
+}
+
+void DetourCrowd::set_agent_target(int id, Vector3 target)
+{
+	AgentCommand command;
+	command.type = COMMAND_SET_TARGET;
+	command.id = id;
+	command.position = target;
+	pending_commands.push_back(command);
+}
+
+void DetourCrowd::set_agent_targets(PoolIntArray ids, PoolVector3Array targets)
+{
+	if (ids.size() != targets.size())
+	{
+		ERR_PRINT("Agent ids and targets must have the same size.");
+		return;
+	}
+	PoolIntArray::Read ids_read = ids.read();
+	PoolVector3Array::Read targets_read = targets.read();
+	for (int i = 0; i < ids.size(); i++)
+	{
+		set_agent_target(ids_read[i], targets_read[i]);
+	}
+}
+
+int DetourCrowd::get_agent_count()
+{
+	return static_cast<int>(buffers[front_buffer].ids.size());
+}
+
+/**
+ * @returns ids of active agents, in the same order as positions and velocities
+ */
+PoolIntArray DetourCrowd::get_agent_ids()
+{
+	const CrowdOutput &output = buffers[front_buffer];
+	PoolIntArray ids;
+	ids.resize(static_cast<int>(output.ids.size()));
+	PoolIntArray::Write w = ids.write();
+	for (int i = 0; i < output.ids.size(); i++)
+	{
+		w[i] = output.ids[i];
+	}
+	return ids;
+}
+
+PoolVector3Array DetourCrowd::get_agent_positions()
+{
+	const CrowdOutput &output = buffers[front_buffer];
+	PoolVector3Array positions;
+	positions.resize(static_cast<int>(output.positions.size()));
+	PoolVector3Array::Write w = positions.write();
+	for (int i = 0; i < output.positions.size(); i++)
+	{
+		w[i] = output.positions[i];
+	}
+	return positions;
+}
+
+PoolVector3Array DetourCrowd::get_agent_velocities()
+{
+	const CrowdOutput &output = buffers[front_buffer];
+	PoolVector3Array velocities;
+	velocities.resize(static_cast<int>(output.velocities.size()));
+	PoolVector3Array::Write w = velocities.write();
+	for (int i = 0; i < output.velocities.size(); i++)
+	{
+		w[i] = output.velocities[i];
+	}
+	return velocities;
+}
@@ -0,0 +1,118 @@
+#ifndef NAVIGATION_CROWD_H
+#define NAVIGATION_CROWD_H
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <unordered_map>
+#include <Godot.hpp>
+#include <Node.hpp>
+#include <NodePath.hpp>
+#include <Dictionary.hpp>
+#include <PoolArrays.hpp>
+
+#include "helpers.h"
+#include "navigation_mesh.h"
+#include "DetourCrowd.h"
+
+namespace godot
+{
+
+/**
+ * Crowd simulation bound to a DetourNavigationMesh (or cached one).
+ * Agents are steered by dtCrowd on a worker thread, positions are
+ * double buffered and read back once per physics frame.
+ */
+class DetourCrowd : public Node
+{
+	GODOT_CLASS(DetourCrowd, Node);
+
+private:
+	enum CommandType
+	{
+		COMMAND_ADD_AGENT,
+		COMMAND_REMOVE_AGENT,
+		COMMAND_SET_TARGET,
+	};
+
+	struct AgentCommand
+	{
+		CommandType type;
+		int id;
+		Vector3 position;
+		dtCrowdAgentParams params;
+	};
+
+	struct CrowdOutput
+	{
+		std::vector<int> ids;
+		std::vector<Vector3> positions;
+		std::vector<Vector3> velocities;
+	};
+
+	dtCrowd *crowd = nullptr;
+	DetourNavigationMesh *navmesh = nullptr;
+	Transform transform;
+	Transform inverse;
+
+	/* Commands are queued on the main thread and applied while the worker is idle */
+	std::vector<AgentCommand> pending_commands;
+	std::unordered_map<int, int> agent_indices;
+	std::vector<int> agent_ids;
+	int next_agent_id = 1;
+
+	CrowdOutput buffers[2];
+	int front_buffer = 0;
+
+	std::thread worker;
+	std::mutex worker_mutex;
+	std::condition_variable worker_cv;
+	bool job_pending = false;
+	bool job_running = false;
+	bool stop_worker = false;
+	float job_delta = 0.f;
+
+	bool init_crowd();
+	void release_crowd();
+	void requeue_agents();
+	void apply_commands();
+	void step(float delta);
+	void worker_loop();
+	void start_worker();
+	void wait_for_update();
+	void stop_worker_thread();
+	dtCrowdAgentParams get_agent_params(Dictionary parameters);
+
+public:
+	SETGET(navigation_mesh, NodePath);
+	SETGET(max_agents, int);
+	SETGET(max_speed, float);
+	SETGET(max_acceleration, float);
+	SETGET(separation_weight, float);
+	SETGET(threaded, bool);
+
+	DetourCrowd();
+	~DetourCrowd();
+
+	void _init();
+	void _exit_tree();
+	void _physics_process(float delta);
+	static void _register_methods();
+
+	/* Called by the navmesh before it's freed, agents are added again to the next one */
+	void detach_navmesh();
+
+	int add_agent(Vector3 position, Dictionary parameters);
+	void remove_agent(int id);
+	void set_agent_target(int id, Vector3 target);
+	void set_agent_targets(PoolIntArray ids, PoolVector3Array targets);
+
+	int get_agent_count();
+	PoolIntArray get_agent_ids();
+	PoolVector3Array get_agent_positions();
+	PoolVector3Array get_agent_velocities();
+};
+
+} // namespace godot
+#endif
@@ -1,5 +1,10 @@
+#include <File.hpp>
+#include <Directory.hpp>
+#include <ProjectSettings.hpp>
 #include "navigation_mesh.h"
 #include "navigation_query.h"
+#include "navigation_corridor.h"
+#include "navigation_crowd.h"
 #include "navigation.h"
 
 using namespace godot;
@@ -13,6 +18,29 @@ void DetourNavigationMesh::_register_methods()
 	register_method("save_navmesh", &DetourNavigationMesh::save_mesh);
 	register_method("clear_navmesh", &DetourNavigationMesh::clear_navmesh);
 	register_method("find_path", &DetourNavigationMesh::find_path);
+	register_method("find_path_filtered", &DetourNavigationMesh::find_path_filtered);
+	register_method("add_query_filter", &DetourNavigationMesh::add_query_filter);
+	register_method("get_query_filter_id", &DetourNavigationMesh::get_query_filter_id);
+	register_method("remove_query_filter", &DetourNavigationMesh::remove_query_filter);
+	register_method("is_reachable", &DetourNavigationMesh::is_reachable);
+	register_method("raycast_many", &DetourNavigationMesh::raycast_many);
+	register_method("raycast_many_filtered", &DetourNavigationMesh::raycast_many_filtered);
+	register_method("closest_point_many", &DetourNavigationMesh::closest_point_many);
+	register_method("closest_point_many_filtered", &DetourNavigationMesh::closest_point_many_filtered);
+	register_method("get_height_many", &DetourNavigationMesh::get_height_many);
+	register_method("get_height_many_filtered", &DetourNavigationMesh::get_height_many_filtered);
+	register_method("random_point_in_circle", &DetourNavigationMesh::random_point_in_circle);
+	register_method("random_point_in_circle_filtered", &DetourNavigationMesh::random_point_in_circle_filtered);
+	register_method("move_along_surface_many", &DetourNavigationMesh::move_along_surface_many);
+	register_method("move_along_surface_many_filtered", &DetourNavigationMesh::move_along_surface_many_filtered);
+	register_method("create_path_corridor", &DetourNavigationMesh::create_path_corridor);
+	register_method("request_path", &DetourNavigationMesh::request_path);
+	register_method("request_path_filtered", &DetourNavigationMesh::request_path_filtered);
+	register_method("get_capacity_stats", &DetourNavigationMesh::get_capacity_stats);
+
+	register_signal<DetourNavigationMesh>("paths_ready", "callback_ids", GODOT_VARIANT_TYPE_POOL_INT_ARRAY,
+										  "offsets", GODOT_VARIANT_TYPE_POOL_INT_ARRAY, "points", GODOT_VARIANT_TYPE_POOL_VECTOR3_ARRAY,
+										  "statuses", GODOT_VARIANT_TYPE_POOL_INT_ARRAY, "nodes_expanded", GODOT_VARIANT_TYPE_POOL_INT_ARRAY);
 
 	register_property<DetourNavigationMesh, int>("collision_mask", &DetourNavigationMesh::set_collision_mask, &DetourNavigationMesh::get_collision_mask, 1,
 												 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_DEFAULT, GODOT_PROPERTY_HINT_LAYERS_3D_PHYSICS);
@@ -23,6 +51,8 @@ void DetourNavigationMesh::_register_methods()
 												   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 	register_property<DetourNavigationMesh, Array>("input_aabbs_storage", &DetourNavigationMesh::set_input_aabbs_storage, &DetourNavigationMesh::get_input_aabbs_storage, Array(),
 												   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
+	register_property<DetourNavigationMesh, Array>("collision_layers_storage", &DetourNavigationMesh::set_collision_layers_storage, &DetourNavigationMesh::get_collision_layers_storage, Array(),
+												   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 	register_property<DetourNavigationMesh, Array>("collision_ids_storage", &DetourNavigationMesh::set_collision_ids_storage, &DetourNavigationMesh::get_collision_ids_storage, Array(),
 												   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 	register_property<DetourNavigationMesh, String>("uuid", &DetourNavigationMesh::set_uuid, &DetourNavigationMesh::get_uuid, "",
@@ -30,6 +60,10 @@ void DetourNavigationMesh::_register_methods()
 
 	register_property<DetourNavigationMesh, PoolByteArray>("serialized_navmesh_data", &DetourNavigationMesh::set_serialized_navmesh_data, &DetourNavigationMesh::get_serialized_navmesh_data, PoolByteArray(),
 														   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
+	register_property<DetourNavigationMesh, String>("navmesh_file", &DetourNavigationMesh::set_navmesh_file, &DetourNavigationMesh::get_navmesh_file, "",
+													GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_DEFAULT, GODOT_PROPERTY_HINT_FILE, "*.navmesh");
+	register_property<DetourNavigationMesh, PoolByteArray>("landmark_data", &DetourNavigationMesh::set_landmark_data, &DetourNavigationMesh::get_landmark_data, PoolByteArray(),
+														   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 
 	register_property<DetourNavigationMesh, Color>(
 		"debug_mesh_color", &DetourNavigationMesh::set_debug_mesh_color, &DetourNavigationMesh::get_debug_mesh_color, Color(0.1f, 1.0f, 0.7f, 0.4f));
@@ -69,6 +103,11 @@ DetourNavigationMesh::DetourNavigationMesh()
 DetourNavigationMesh::~DetourNavigationMesh()
 {
 	_is_being_deleted = true;
+	for (DetourPathCorridor *corridor : path_corridors)
+	{
+		corridor->detach();
+	}
+	path_corridors.clear();
 	release_navmesh();
 
 	if (navmesh_parameters.is_valid())
@@ -97,12 +136,25 @@ void DetourNavigationMesh::set_collision_mask(int cm)
 
 void DetourNavigationMesh::release_navmesh()
 {
+	stop_path_workers();
+	/* Crowd workers are stopped first, they take the lock shared while they step.
+	 * Crowds bind to the next navmesh on their own. */
+	std::vector<DetourCrowd *> attached = crowds;
+	for (DetourCrowd *crowd : attached)
+	{
+		crowd->detach_navmesh();
+	}
+	std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+	replicas.clear();
 	if (detour_navmesh != nullptr)
 	{
 		dtFreeNavMesh(detour_navmesh);
 		detour_navmesh = nullptr;
 	}
+	navmesh_mapping.close();
 	clear_debug_mesh();
+	islands.clear();
+	landmarks.clear();
 	if (nav_query != nullptr)
 	{
 		delete nav_query;
@@ -142,6 +194,7 @@ void DetourNavigationMesh::build_navmesh()
 	}
 	clear_navmesh();
 	dtmi->build_navmesh(this);
+	build_landmarks();
 	save_mesh();
 }
 
@@ -157,7 +210,9 @@ void DetourNavigationMesh::clear_navmesh()
 	input_transforms_storage.clear();
 	input_meshes_storage.clear();
 	collision_ids_storage.clear();
+	collision_layers_storage.clear();
 	serialized_navmesh_data.resize(0);
+	landmark_data.resize(0);
 	release_navmesh();
 }
 
@@ -239,7 +294,7 @@ Ref<ArrayMesh> DetourNavigationMesh::get_debug_mesh()
  */
 bool DetourNavigationMesh::load_mesh()
 {
-	dtNavMesh *dt_navmesh = Serializer::deserializeNavigationMesh(serialized_navmesh_data);
+	dtNavMesh *dt_navmesh = navmesh_file.empty() ? Serializer::deserializeNavigationMesh(serialized_navmesh_data) : load_navmesh_file();
 	if (dt_navmesh == 0)
 	{
 		ERR_PRINT("No baked navmesh found for " + get_name());
@@ -250,9 +305,12 @@ bool DetourNavigationMesh::load_mesh()
 		detour_navmesh = dt_navmesh;
 		init_generator(((Spatial *)get_parent())->get_global_transform());
 		generator->detour_navmesh = dt_navmesh;
+		Serializer::deserializeLandmarks(landmark_data, &landmarks, dt_navmesh);
 
 		if (!load_inputs())
 		{
+			dtFreeNavMesh(detour_navmesh);
+			navmesh_mapping.close();
 			detour_navmesh = nullptr;
 			generator->detour_navmesh = nullptr;
 			return false;
@@ -271,7 +329,93 @@ bool DetourNavigationMesh::load_mesh()
 void DetourNavigationMesh::save_mesh()
 {
 	store_inputs();
-	serialized_navmesh_data = Serializer::serializeNavigationMesh(get_detour_navmesh());
+	if (!navmesh_file.empty() && save_navmesh_file())
+	{
+		serialized_navmesh_data.resize(0);
+	}
+	else
+	{
+		serialized_navmesh_data = Serializer::serializeNavigationMesh(get_detour_navmesh());
+	}
+	landmark_data = Serializer::serializeLandmarks(&landmarks);
+}
+
+/**
+ * Maps navmesh_file, its tiles are used where they are in the file instead
+ * of being copied. Files that can't be mapped (exported in a pck) are read
+ * into one block that the tiles point into.
+ *
+ * @return nullptr if the file is missing or not a navmesh file
+ */
+dtNavMesh *DetourNavigationMesh::load_navmesh_file()
+{
+	std::string path = ProjectSettings::get_singleton()->globalize_path(navmesh_file).utf8().get_data();
+	if (!navmesh_mapping.map(path))
+	{
+		Ref<File> file = File::_new();
+		if (file->open(navmesh_file, File::READ) != Error::OK)
+		{
+			ERR_PRINT("Can't open navmesh file " + navmesh_file);
+			return nullptr;
+		}
+		PoolByteArray file_data = file->get_buffer(file->get_len());
+		file->close();
+		unsigned char *data = navmesh_mapping.allocate(file_data.size());
+		if (data == nullptr)
+		{
+			return nullptr;
+		}
+		memcpy(data, file_data.read().ptr(), file_data.size());
+	}
+
+	dtNavMesh *dt_navmesh = Serializer::mapNavigationMesh(navmesh_mapping.get_data(), navmesh_mapping.get_size());
+	if (dt_navmesh == nullptr)
+	{
+		navmesh_mapping.close();
+		ERR_PRINT("Not a navmesh file " + navmesh_file);
+		return nullptr;
+	}
+	if (OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string file_message = std::string(navmesh_mapping.is_mapped() ? "Mapped " : "Read ") + std::to_string(navmesh_mapping.get_size()) +
+								   " bytes of navmesh file " + path;
+		Godot::print(file_message.c_str());
+	}
+	return dt_navmesh;
+}
+
+/**
+ * Writes navmesh_file next to it and renames it over, a navmesh mapped
+ * from the old file keeps its pages until it's released. Renaming over a
+ * mapped file fails on Windows, the navmesh is then kept in the scene.
+ *
+ * @return false if the file couldn't be written
+ */
+bool DetourNavigationMesh::save_navmesh_file()
+{
+	PoolByteArray file_data = Serializer::serializeNavigationMeshFile(get_detour_navmesh());
+	if (file_data.size() == 0)
+	{
+		return false;
+	}
+	String temp_path = navmesh_file + ".tmp";
+	Ref<File> file = File::_new();
+	if (file->open(temp_path, File::WRITE) != Error::OK)
+	{
+		ERR_PRINT("Can't write navmesh file " + temp_path);
+		return false;
+	}
+	file->store_buffer(file_data);
+	file->close();
+
+	Ref<Directory> directory = Directory::_new();
+	if (directory->rename(temp_path, navmesh_file) != Error::OK)
+	{
+		directory->remove(temp_path);
+		ERR_PRINT("Can't replace navmesh file " + navmesh_file + ", keeping the navmesh in the scene");
+		return false;
+	}
+	return true;
 }
 
 /**
@@ -331,22 +475,585 @@ Ref<Material> DetourNavigationMesh::get_debug_navigation_material()
 }
 
 /**
- * @returns array of the shortest path between two points
+ * Creates a query bound to this navmesh, one per thread that reads it
  */
-Dictionary DetourNavigationMesh::find_path(Variant from, Variant to)
+DetourNavigationQuery *DetourNavigationMesh::create_query()
+{
+	DetourNavigationQuery *query = new DetourNavigationQuery();
+	if (navmesh_parameters.is_valid())
+	{
+		query->set_limits(navmesh_parameters->get_query_max_nodes(),
+						  navmesh_parameters->get_max_path_polys(),
+						  navmesh_parameters->get_max_path_points());
+		query->set_search_extents(navmesh_parameters->get_search_extents(),
+								  navmesh_parameters->get_max_search_extents());
+	}
+	query->init(get_detour_navmesh(), get_global_transform());
+	query->set_islands(&islands);
+	query->set_landmarks(&landmarks);
+	return query;
+}
+
+/**
+ * Lazily creates the main thread query object and its default filter
+ */
+DetourNavigationQuery *DetourNavigationMesh::get_nav_query()
 {
 	if (!nav_query)
 	{
-		nav_query = new DetourNavigationQuery();
-		nav_query->init(get_detour_navmesh(), get_global_transform());
+		{
+			std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+			islands.update(get_detour_navmesh());
+			replicas.mark_dirty();
+		}
+		nav_query = create_query();
 		query_filter = new DetourNavigationQueryFilter();
 	}
+	return nav_query;
+}
+
+/**
+ * Queues a path request with the default filter
+ */
+void DetourNavigationMesh::request_path(Vector3 from, Vector3 to, int callback_id)
+{
+	request_path_filtered(from, to, callback_id, 0);
+}
+
+/**
+ * Queues a path request for the worker threads, the result is delivered
+ * with the paths_ready signal in one of the next frames
+ */
+void DetourNavigationMesh::request_path_filtered(Vector3 from, Vector3 to, int callback_id, int filter_id)
+{
+	std::shared_ptr<DetourNavigationQueryFilter> filter;
+	if (filter_id > 0 && filter_id < (int)query_filters.size())
+	{
+		filter = query_filters[filter_id];
+	}
+	path_requests.push_back({callback_id, from, to, filter});
+}
+
+/**
+ * Splits the requests of this frame between path workers. Every worker
+ * has its own query and pins the published navmesh replica for its batch,
+ * so workers never wait for tile rebuilds on the main thread. Navmeshes
+ * without a tile cache aren't replicated, see uses_replicas.
+ */
+void DetourNavigationMesh::dispatch_path_requests()
+{
+	if (path_requests.empty())
+	{
+		return;
+	}
+	if (get_detour_navmesh() == nullptr)
+	{
+		/* Nothing to search on, requests are answered with empty paths */
+		std::lock_guard<std::mutex> lock(path_results_mutex);
+		for (const PathRequest &request : path_requests)
+		{
+			path_results.push_back({request.callback_id, std::vector<Vector3>(), PathStats()});
+		}
+		path_requests.clear();
+		return;
+	}
+
+	start_path_workers();
+	publish_replicas();
+
+	int worker_count = path_workers->get_thread_count();
+	int batch_size = ((int)path_requests.size() + worker_count - 1) / worker_count;
+	for (int start = 0; start < (int)path_requests.size(); start += batch_size)
+	{
+		int end = std::min(start + batch_size, (int)path_requests.size());
+		std::vector<PathRequest> batch(path_requests.begin() + start, path_requests.begin() + end);
+		path_workers->push([this, batch](int worker) {
+			std::vector<PathResult> results(batch.size());
+			solve_path_batch(worker, batch.data(), results.data(), (int)batch.size());
+
+			std::lock_guard<std::mutex> lock(path_results_mutex);
+			for (PathResult &result : results)
+			{
+				path_results.push_back(std::move(result));
+			}
+		});
+	}
+	path_requests.clear();
+}
+
+void DetourNavigationMesh::start_path_workers()
+{
+	get_nav_query();
+	if (path_workers == nullptr)
+	{
+		path_workers = new WorkerPool(WorkerPool::default_thread_count());
+		for (int i = 0; i < path_workers->get_thread_count(); i++)
+		{
+			worker_queries.push_back(create_query());
+		}
+	}
+}
+
+/**
+ * Runs on a path worker, the published replica is pinned for the whole
+ * batch. Without replicas the navmesh is read under the shared lock.
+ */
+void DetourNavigationMesh::solve_path_batch(int worker, const PathRequest *requests, PathResult *results, int count)
+{
+	DetourNavigationQuery *query = worker_queries[worker];
+	std::shared_lock<std::shared_mutex> guard(navmesh_lock, std::defer_lock);
+	NavmeshReplicas::Replica *replica = nullptr;
+	bool ready = false;
+	if (uses_replicas())
+	{
+		replica = replicas.acquire();
+		if (replica != nullptr)
+		{
+			query->rebind(replica->navmesh);
+			query->set_islands(&replica->islands);
+			query->set_landmarks(&replica->landmarks);
+			ready = true;
+		}
+	}
+	else
+	{
+		guard.lock();
+		query->rebind(get_detour_navmesh());
+		query->set_islands(&islands);
+		query->set_landmarks(&landmarks);
+		ready = get_detour_navmesh() != nullptr;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		results[i].callback_id = requests[i].callback_id;
+		if (ready)
+		{
+			DetourNavigationQueryFilter *filter = requests[i].filter ? requests[i].filter.get() : query_filter;
+			query->find_path_points(requests[i].from, requests[i].to, filter, results[i].points, &results[i].stats);
+		}
+	}
+	replicas.release(replica);
+}
+
+/**
+ * Queues the paths on the path workers, each worker writes its own slice
+ * of results. Both vectors must stay untouched until wait_path_batches.
+ */
+void DetourNavigationMesh::push_path_batch(const std::vector<PathRequest> &requests, std::vector<PathResult> &results)
+{
+	results.assign(requests.size(), PathResult());
+	if (requests.empty() || get_detour_navmesh() == nullptr)
+	{
+		return;
+	}
+	start_path_workers();
+	publish_replicas();
+
+	int worker_count = path_workers->get_thread_count();
+	int batch_size = ((int)requests.size() + worker_count - 1) / worker_count;
+	for (int start = 0; start < (int)requests.size(); start += batch_size)
+	{
+		int count = std::min(batch_size, (int)requests.size() - start);
+		const PathRequest *batch = requests.data() + start;
+		PathResult *batch_results = results.data() + start;
+		path_workers->push([this, batch, batch_results, count](int worker) {
+			solve_path_batch(worker, batch, batch_results, count);
+		});
+	}
+}
+
+/**
+ * Blocks until the path workers are idle, paths requested earlier this
+ * frame are finished too
+ */
+void DetourNavigationMesh::wait_path_batches()
+{
+	if (path_workers != nullptr)
+	{
+		path_workers->wait_idle();
+	}
+}
+
+/**
+ * Copies tiles changed since the last publish to the replica no worker
+ * reads. If workers of the previous epoch still use it, publishing is
+ * retried next frame and workers keep reading the older replica.
+ */
+void DetourNavigationMesh::publish_replicas()
+{
+	if (!uses_replicas())
+	{
+		return;
+	}
+	if (!replicas.publish(get_detour_navmesh(), islands, landmarks) && OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string publish_message = "Navmesh replica still in use, publishing deferred at epoch " + std::to_string(replicas.get_epoch());
+		Godot::print(publish_message.c_str());
+	}
+}
+
+/**
+ * Only tiles of a tile cache change often enough to replicate. Other
+ * navmeshes change on geometry rebuilds alone, copying every tile would
+ * double their memory (and give up the shared pages of a mapped file),
+ * so path workers read them under the shared lock instead.
+ */
+bool DetourNavigationMesh::uses_replicas()
+{
+	return get_tile_cache() != nullptr;
+}
+
+/**
+ * Emits all finished paths in one paths_ready signal. Points of all paths
+ * are packed in one array, path i is points[offsets[i]] to points[offsets[i + 1] - 1].
+ */
+void DetourNavigationMesh::emit_ready_paths()
+{
+	std::vector<PathResult> results;
+	{
+		std::lock_guard<std::mutex> lock(path_results_mutex);
+		results.swap(path_results);
+	}
+	if (results.empty())
+	{
+		return;
+	}
+
+	int point_count = 0;
+	for (const PathResult &result : results)
+	{
+		point_count += (int)result.points.size();
+	}
 
+	PoolIntArray callback_ids;
+	PoolIntArray offsets;
+	PoolVector3Array points;
+	PoolIntArray statuses;
+	PoolIntArray nodes_expanded;
+	callback_ids.resize((int)results.size());
+	offsets.resize((int)results.size() + 1);
+	points.resize(point_count);
+	statuses.resize((int)results.size());
+	nodes_expanded.resize((int)results.size());
+	{
+		PoolIntArray::Write ids_write = callback_ids.write();
+		PoolIntArray::Write offsets_write = offsets.write();
+		PoolVector3Array::Write points_write = points.write();
+		PoolIntArray::Write statuses_write = statuses.write();
+		PoolIntArray::Write nodes_write = nodes_expanded.write();
+		int offset = 0;
+		for (int i = 0; i < (int)results.size(); i++)
+		{
+			ids_write[i] = results[i].callback_id;
+			statuses_write[i] = results[i].stats.status;
+			nodes_write[i] = results[i].stats.nodes_expanded;
+			offsets_write[i] = offset;
+			for (const Vector3 &point : results[i].points)
+			{
+				points_write[offset++] = point;
+			}
+		}
+		offsets_write[results.size()] = offset;
+	}
+	emit_signal("paths_ready", callback_ids, offsets, points, statuses, nodes_expanded);
+}
+
+/**
+ * Finishes queued path jobs and frees the workers, has to be called
+ * before the navmesh they read is released
+ */
+void DetourNavigationMesh::stop_path_workers()
+{
+	if (path_workers != nullptr)
+	{
+		delete path_workers;
+		path_workers = nullptr;
+	}
+	for (DetourNavigationQuery *query : worker_queries)
+	{
+		delete query;
+	}
+	worker_queries.clear();
+	path_requests.clear();
+	std::lock_guard<std::mutex> lock(path_results_mutex);
+	path_results.clear();
+}
+
+/**
+ * @returns false if there is no path between the points, answered from
+ * island labels without a path search
+ */
+bool DetourNavigationMesh::is_reachable(Vector3 from, Vector3 to)
+{
+	return get_nav_query()->is_reachable(from, to, query_filter);
+}
+
+/**
+ * Creates a path corridor for one agent and plans its initial path.
+ */
+Ref<DetourPathCorridor> DetourNavigationMesh::create_path_corridor(Vector3 position, Vector3 target)
+{
+	Ref<DetourPathCorridor> corridor;
+	corridor.instance();
+	corridor->attach(this);
+	path_corridors.push_back(corridor.ptr());
+	corridor->reset(position, target);
+	return corridor;
+}
+
+void DetourNavigationMesh::remove_path_corridor(DetourPathCorridor *corridor)
+{
+	path_corridors.erase(std::remove(path_corridors.begin(), path_corridors.end(), corridor), path_corridors.end());
+}
+
+void DetourNavigationMesh::add_crowd(DetourCrowd *crowd)
+{
+	if (std::find(crowds.begin(), crowds.end(), crowd) == crowds.end())
+	{
+		crowds.push_back(crowd);
+	}
+}
+
+void DetourNavigationMesh::remove_crowd(DetourCrowd *crowd)
+{
+	crowds.erase(std::remove(crowds.begin(), crowds.end(), crowd), crowds.end());
+}
+
+/**
+ * @returns array of the shortest path between two points
+ */
+Dictionary DetourNavigationMesh::find_path(Variant from, Variant to)
+{
 	//Dictionary result = nav_query->find_path(Vector3(0.f, 0.f, 0.f), Vector3(11.f, 0.3f, 11.f), Vector3(50.0f, 3.f, 50.f), new DetourNavigationQueryFilter());
-	Dictionary result = nav_query->find_path((Vector3)from, (Vector3)to, Vector3(50.0f, 50.f, 50.f), query_filter);
+	Dictionary result = get_nav_query()->find_path((Vector3)from, (Vector3)to, query_filter);
 	return result;
 }
 
+/**
+ * Same as find_path, with the filter returned by add_query_filter
+ */
+Dictionary DetourNavigationMesh::find_path_filtered(Vector3 from, Vector3 to, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->find_path(from, to, get_query_filter(filter_id));
+}
+
+/**
+ * Id budget the navmesh was baked with, how much of it is used and the
+ * memory it takes, with the tile cache of cached navmeshes
+ */
+Dictionary DetourNavigationMesh::get_capacity_stats()
+{
+	Dictionary stats;
+	const dtNavMesh *navmesh = get_detour_navmesh();
+	if (navmesh == nullptr)
+	{
+		return stats;
+	}
+	const dtNavMeshParams *params = navmesh->getParams();
+	stats["max_tiles"] = params->maxTiles;
+	stats["max_tile_polys"] = params->maxPolys;
+	stats["tile_bits"] = (int)ilog2(nextPow2((unsigned int)params->maxTiles));
+	stats["poly_bits"] = (int)ilog2(nextPow2((unsigned int)params->maxPolys));
+	stats["used_tiles"] = NavmeshCapacity::get_used_tiles(navmesh);
+	stats["biggest_tile_polys"] = NavmeshCapacity::get_max_tile_polys(navmesh);
+	stats["navmesh_memory"] = (int64_t)NavmeshCapacity::get_navmesh_memory(navmesh);
+	const dtTileCache *tile_cache = get_tile_cache();
+	if (tile_cache != nullptr)
+	{
+		stats["tile_cache_tiles"] = tile_cache->getParams()->maxTiles;
+		stats["tile_cache_memory"] = (int64_t)NavmeshCapacity::get_tile_cache_memory(tile_cache);
+	}
+	return stats;
+}
+
+Dictionary DetourNavigationMesh::raycast_many_filtered(PoolVector3Array from, PoolVector3Array to, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->raycast_many(from, to, get_query_filter(filter_id));
+}
+
+PoolVector3Array DetourNavigationMesh::closest_point_many_filtered(PoolVector3Array points, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->closest_point_many(points, get_query_filter(filter_id));
+}
+
+PoolRealArray DetourNavigationMesh::get_height_many_filtered(PoolVector3Array points, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->get_height_many(points, get_query_filter(filter_id));
+}
+
+Vector3 DetourNavigationMesh::random_point_in_circle_filtered(Vector3 center, float radius, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->random_point_in_circle(center, radius, get_query_filter(filter_id));
+}
+
+PoolVector3Array DetourNavigationMesh::move_along_surface_many_filtered(PoolVector3Array from, PoolVector3Array to, int filter_id)
+{
+	DetourNavigationQuery *query = get_nav_query();
+	return query->move_along_surface_many(from, to, get_query_filter(filter_id));
+}
+
+/* Unfiltered variants keep the signatures scripts used before filters, handle 0 is the default filter */
+Dictionary DetourNavigationMesh::raycast_many(PoolVector3Array from, PoolVector3Array to)
+{
+	return raycast_many_filtered(from, to, 0);
+}
+
+PoolVector3Array DetourNavigationMesh::closest_point_many(PoolVector3Array points)
+{
+	return closest_point_many_filtered(points, 0);
+}
+
+PoolRealArray DetourNavigationMesh::get_height_many(PoolVector3Array points)
+{
+	return get_height_many_filtered(points, 0);
+}
+
+Vector3 DetourNavigationMesh::random_point_in_circle(Vector3 center, float radius)
+{
+	return random_point_in_circle_filtered(center, radius, 0);
+}
+
+PoolVector3Array DetourNavigationMesh::move_along_surface_many(PoolVector3Array from, PoolVector3Array to)
+{
+	return move_along_surface_many_filtered(from, to, 0);
+}
+
+/**
+ * Copies the filter to a native one and returns its handle. Adding a
+ * filter with the name of an existing one replaces it and keeps the handle.
+ */
+int DetourNavigationMesh::add_query_filter(Ref<DetourQueryFilter> filter)
+{
+	if (!filter.is_valid())
+	{
+		ERR_PRINT("Query filter is not valid.");
+		return 0;
+	}
+	std::shared_ptr<DetourNavigationQueryFilter> native = std::make_shared<DetourNavigationQueryFilter>();
+	filter->apply(native->dt_query_filter);
+	if (query_filters.empty())
+	{
+		query_filters.push_back(nullptr);
+	}
+
+	String name = filter->get_name();
+	auto it = query_filter_ids.find(name);
+	if (!name.empty() && it != query_filter_ids.end())
+	{
+		query_filters[it->second] = native;
+		return it->second;
+	}
+	int filter_id = (int)query_filters.size();
+	query_filters.push_back(native);
+	if (!name.empty())
+	{
+		query_filter_ids[name] = filter_id;
+	}
+	return filter_id;
+}
+
+/**
+ * @return handle of the filter added with that resource name, 0 if there is none
+ */
+int DetourNavigationMesh::get_query_filter_id(String name)
+{
+	auto it = query_filter_ids.find(name);
+	return it != query_filter_ids.end() ? it->second : 0;
+}
+
+/* Handles aren't reused, queries with a removed handle use the default filter */
+void DetourNavigationMesh::remove_query_filter(int filter_id)
+{
+	if (filter_id <= 0 || filter_id >= (int)query_filters.size())
+	{
+		return;
+	}
+	query_filters[filter_id] = nullptr;
+	for (auto it = query_filter_ids.begin(); it != query_filter_ids.end(); ++it)
+	{
+		if (it->second == filter_id)
+		{
+			query_filter_ids.erase(it);
+			break;
+		}
+	}
+}
+
+/**
+ * @return the filter of the handle, the default filter for 0 and unknown handles
+ */
+DetourNavigationQueryFilter *DetourNavigationMesh::get_query_filter(int filter_id)
+{
+	if (filter_id > 0 && filter_id < (int)query_filters.size() && query_filters[filter_id])
+	{
+		return query_filters[filter_id].get();
+	}
+	return query_filter;
+}
+
+/**
+ * Rebuilds dirty tiles while holding the navmesh exclusively
+ */
+void DetourNavigationMesh::recalculate_tiles()
+{
+	if (generator == nullptr)
+	{
+		return;
+	}
+	std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+	generator->recalculate_tiles();
+	islands.update(get_detour_navmesh());
+	landmarks.update(get_detour_navmesh());
+	replicas.mark_dirty();
+}
+
+/**
+ * Computes the landmark table for ALT path search, landmarks are
+ * spread over the largest island
+ */
+void DetourNavigationMesh::build_landmarks()
+{
+	if (!navmesh_parameters.is_valid() || get_detour_navmesh() == nullptr)
+	{
+		return;
+	}
+	std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+	islands.update(get_detour_navmesh());
+	landmarks.build(get_detour_navmesh(), islands.get_largest_island_poly(), navmesh_parameters->get_landmark_count());
+	replicas.mark_dirty();
+	if (OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string landmark_message = "Landmarks computed: " + std::to_string(landmarks.get_landmark_count());
+		Godot::print(landmark_message.c_str());
+	}
+}
+
+/**
+ * Recomputes one landmark invalidated by tile changes, called every frame.
+ * Only the main thread changes tiles, so the search runs without the lock
+ * and path workers only wait for the distances to be stored.
+ */
+void DetourNavigationMesh::refresh_landmarks()
+{
+	if (!landmarks.has_stale())
+	{
+		return;
+	}
+	NavmeshLandmarks::Refresh refresh;
+	if (!landmarks.compute_stale(refresh))
+	{
+		return;
+	}
+	std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+	landmarks.store(refresh);
+	replicas.mark_dirty();
+}
+
 /**
  * Stores meshes and their transforms upon bake
  * so they can be loaded instead of calculated next time
@@ -369,6 +1076,7 @@ void DetourNavigationMesh::store_inputs()
 	input_transforms_storage.resize(static_cast<int>(generator->input_meshes->size()));
 	input_aabbs_storage.resize(static_cast<int>(generator->input_meshes->size()));
 	collision_ids_storage.resize(static_cast<int>(generator->input_meshes->size()));
+	collision_layers_storage.resize(static_cast<int>(generator->collision_layers->size()));
 
 	for (int i = 0; i < generator->input_meshes->size(); i++)
 	{
@@ -377,6 +1085,10 @@ void DetourNavigationMesh::store_inputs()
 		input_aabbs_storage[i] = (Variant(generator->input_aabbs->at(i)));
 		collision_ids_storage[i] = (Variant(generator->collision_ids->at(i)));
 	}
+	for (int i = 0; i < generator->collision_layers->size(); i++)
+	{
+		collision_layers_storage[i] = generator->collision_layers->at(i);
+	}
 }
 
 /**
@@ -394,6 +1106,8 @@ bool DetourNavigationMesh::load_inputs()
 	generator->input_transforms->resize(input_meshes_storage.size());
 	generator->input_aabbs->resize(input_meshes_storage.size());
 	generator->collision_ids->resize(input_meshes_storage.size());
+	/* Scenes baked before area types have no layers, their meshes get the default area */
+	generator->collision_layers->assign(input_meshes_storage.size(), 0);
 
 	for (int i = 0; i < input_meshes_storage.size(); i++)
 	{
@@ -401,6 +1115,10 @@ bool DetourNavigationMesh::load_inputs()
 		generator->input_transforms->at(i) = input_transforms_storage[i];
 		generator->input_aabbs->at(i) = input_aabbs_storage[i];
 		generator->collision_ids->at(i) = collision_ids_storage[i];
+		if (i < collision_layers_storage.size())
+		{
+			generator->collision_layers->at(i) = collision_layers_storage[i];
+		}
 		bounding_box.merge_with(
 			generator->input_transforms->at(i).xform(generator->input_aabbs->at(i)));
 		generator->bounding_box = bounding_box;
@@ -423,9 +1141,10 @@ DetourNavigationMeshGenerator *DetourNavigationMesh::init_generator(Transform gl
 	std::vector<Transform> *transforms = new std::vector<Transform>();
 	std::vector<AABB> *aabbs = new std::vector<AABB>();
 	std::vector<int64_t> *collision_ids = new std::vector<int64_t>();
+	std::vector<int> *collision_layers = new std::vector<int>();
 
 	dtnavmesh_gen->init_mesh_data(meshes, transforms, aabbs,
-								  global_transform, collision_ids);
+								  global_transform, collision_ids, collision_layers);
 
 	dtnavmesh_gen->navmesh_parameters = navmesh_parameters;
 	set_generator(dtnavmesh_gen);
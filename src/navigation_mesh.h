@@ -5,6 +5,10 @@
 #include <vector>
 #include <string>
 #include <iostream>
+#include <shared_mutex>
+#include <memory>
+#include <map>
+#include <mutex>
 #include <Godot.hpp>
 #include <Spatial.hpp>
 #include <Geometry.hpp>
@@ -26,11 +30,20 @@
 #include "DetourNavMeshBuilder.h"
 #include "DetourTileCache.h"
 #include "navigation_query.h"
+#include "query_filter.h"
+#include "navmesh_islands.h"
+#include "navmesh_landmarks.h"
+#include "navmesh_replicas.h"
 #include "Recast.h"
 #include "serializer.h"
+#include "mapped_file.h"
+#include "worker_pool.h"
 
 namespace godot
 {
+class DetourPathCorridor;
+class DetourCrowd;
+
 class DetourNavigationMesh : public Spatial
 {
 	GODOT_CLASS(DetourNavigationMesh, Spatial);
@@ -47,7 +60,10 @@ public:
 	SETGET(input_transforms_storage, Array);
 	SETGET(input_aabbs_storage, Array);
 	SETGET(collision_ids_storage, Array);
+	SETGET(collision_layers_storage, Array);
 	SETGET(serialized_navmesh_data, PoolByteArray);
+	SETGET(navmesh_file, String);
+	SETGET(landmark_data, PoolByteArray);
 	SETGET(uuid, String);
 	bool debug_navmesh_dirty = true;
 
@@ -67,12 +83,47 @@ public:
 
 	bool load_mesh();
 	void save_mesh();
+	dtNavMesh *load_navmesh_file();
+	bool save_navmesh_file();
 
 	void store_inputs();
 	bool load_inputs();
 
 	void build_debug_mesh(bool force_build);
+	void recalculate_tiles();
+	void build_landmarks();
+	void refresh_landmarks();
 	Dictionary find_path(Variant from, Variant to);
+	Dictionary find_path_filtered(Vector3 from, Vector3 to, int filter_id);
+	bool is_reachable(Vector3 from, Vector3 to);
+	Dictionary get_capacity_stats();
+	Dictionary raycast_many(PoolVector3Array from, PoolVector3Array to);
+	Dictionary raycast_many_filtered(PoolVector3Array from, PoolVector3Array to, int filter_id);
+	PoolVector3Array closest_point_many(PoolVector3Array points);
+	PoolVector3Array closest_point_many_filtered(PoolVector3Array points, int filter_id);
+	PoolRealArray get_height_many(PoolVector3Array points);
+	PoolRealArray get_height_many_filtered(PoolVector3Array points, int filter_id);
+	Vector3 random_point_in_circle(Vector3 center, float radius);
+	Vector3 random_point_in_circle_filtered(Vector3 center, float radius, int filter_id);
+	PoolVector3Array move_along_surface_many(PoolVector3Array from, PoolVector3Array to);
+	PoolVector3Array move_along_surface_many_filtered(PoolVector3Array from, PoolVector3Array to, int filter_id);
+	int add_query_filter(Ref<DetourQueryFilter> filter);
+	int get_query_filter_id(String name);
+	void remove_query_filter(int filter_id);
+	DetourNavigationQueryFilter *get_query_filter(int filter_id);
+	DetourNavigationQuery *get_nav_query();
+	DetourNavigationQuery *create_query();
+	void request_path(Vector3 from, Vector3 to, int callback_id);
+	void request_path_filtered(Vector3 from, Vector3 to, int callback_id, int filter_id);
+	void dispatch_path_requests();
+	void emit_ready_paths();
+	void stop_path_workers();
+	void publish_replicas();
+	bool uses_replicas();
+	Ref<DetourPathCorridor> create_path_corridor(Vector3 position, Vector3 target);
+	void remove_path_corridor(DetourPathCorridor *corridor);
+	void add_crowd(DetourCrowd *crowd);
+	void remove_crowd(DetourCrowd *crowd);
 	void _notification(int p_what);
 	DetourNavigationMeshGenerator *init_generator(Transform global_transform);
 
@@ -90,11 +141,58 @@ public:
 
 	DetourNavigationQuery *nav_query = nullptr;
 	DetourNavigationQueryFilter *query_filter = nullptr;
+	/* Filters added by scripts, the index is the handle, 0 stands for the default filter */
+	std::vector<std::shared_ptr<DetourNavigationQueryFilter>> query_filters;
+	std::map<String, int> query_filter_ids;
+
+	struct PathRequest
+	{
+		int callback_id;
+		Vector3 from;
+		Vector3 to;
+		/* Kept alive until the worker is done, even if the filter is removed */
+		std::shared_ptr<DetourNavigationQueryFilter> filter;
+	};
+
+	struct PathResult
+	{
+		int callback_id;
+		std::vector<Vector3> points;
+		PathStats stats;
+	};
+
+	/* Requests are collected on the main thread and handed to workers once per frame */
+	std::vector<PathRequest> path_requests;
+	WorkerPool *path_workers = nullptr;
+	std::vector<DetourNavigationQuery *> worker_queries;
+	std::mutex path_results_mutex;
+	std::vector<PathResult> path_results;
+
+	void start_path_workers();
+	void solve_path_batch(int worker, const PathRequest *requests, PathResult *results, int count);
+	void push_path_batch(const std::vector<PathRequest> &requests, std::vector<PathResult> &results);
+	void wait_path_batches();
+
+	/* Corridors are references owned by scripts, they are detached when the navmesh goes away */
+	std::vector<DetourPathCorridor *> path_corridors;
+	/* Crowds simulating on the navmesh, detached before it's freed */
+	std::vector<DetourCrowd *> crowds;
 
 	DetourNavigationMeshGenerator *generator = nullptr;
 
 	AABB bounding_box;
 	dtNavMesh *detour_navmesh = nullptr;
+	/* Tile data of a navmesh loaded from navmesh_file, freed after the navmesh */
+	MappedFile navmesh_mapping;
+
+	/* Crowds on other threads take it shared, tile rebuilds take it exclusive */
+	std::shared_mutex navmesh_lock;
+	/* Copies of the navmesh read by path workers of a tile cache, republished after tile changes */
+	NavmeshReplicas replicas;
+	/* Polygon island labels, updated under the exclusive lock after tile changes */
+	NavmeshIslands islands;
+	/* ALT distance table, built at bake time, stale landmarks are recomputed one per frame outside the lock */
+	NavmeshLandmarks landmarks;
 	Ref<ArrayMesh> debug_mesh = nullptr;
 	Transform global_transform;
 	Ref<NavmeshParameters> navmesh_parameters = nullptr;
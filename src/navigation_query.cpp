@@ -1,10 +1,18 @@
+#include <cmath>
+#include <cstdlib>
+#include <algorithm>
+#include <queue>
+#include <vector>
+#include <functional>
+#include <unordered_map>
+#include "DetourCommon.h"
+#include "DetourNode.h"
 #include "navigation_query.h"
 
 using namespace godot;
 
 DetourNavigationQuery::DetourNavigationQuery()
 {
-	query_data = new QueryData();
 }
 
 DetourNavigationQuery::~DetourNavigationQuery()
@@ -33,7 +41,7 @@ void DetourNavigationQuery::init(
 		return;
 	}
 	detour_navmesh = dtMesh;
-	if (dtStatusFailed(navmesh_query->init(dtMesh, MAX_POLYS)))
+	if (dtStatusFailed(navmesh_query->init(dtMesh, max_nodes)))
 	{
 		ERR_PRINT("Failed to initialize navigation query.");
 		return;
@@ -42,41 +50,177 @@ void DetourNavigationQuery::init(
 	inverse = xform.inverse();
 }
 
+/**
+ * Points an initialized query at another copy of the same navmesh,
+ * node pools are kept
+ */
+void DetourNavigationQuery::rebind(dtNavMesh *dtMesh)
+{
+	if (dtMesh == detour_navmesh || !navmesh_query)
+	{
+		return;
+	}
+	detour_navmesh = dtMesh;
+	last_start_poly = 0;
+	last_end_poly = 0;
+	if (dtStatusFailed(navmesh_query->init(dtMesh, max_nodes)))
+	{
+		ERR_PRINT("Failed to initialize navigation query.");
+	}
+}
+
+/**
+ * Sets the node pool size and the longest corridor and straight path a
+ * search returns, longer paths are reported as partial
+ */
+void DetourNavigationQuery::set_limits(int nodes, int polys, int points)
+{
+	/* Detour indexes nodes with 16 bits */
+	nodes = std::min(std::max(nodes, 16), 65535);
+	max_polys = std::max(polys, 2);
+	max_points = std::max(points, 2);
+	poly_path.resize(max_polys);
+	straight_path.resize(max_points * 3);
+	if (nodes != max_nodes)
+	{
+		max_nodes = nodes;
+		if (navmesh_query && detour_navmesh && dtStatusFailed(navmesh_query->init(detour_navmesh, max_nodes)))
+		{
+			ERR_PRINT("Failed to initialize navigation query.");
+		}
+	}
+}
+
+void DetourNavigationQuery::set_search_extents(const Vector3 &initial, const Vector3 &limit)
+{
+	/* Extents are doubled on every miss, so they can't start at zero */
+	search_extents = Vector3(
+		std::max(initial.x, 0.01f), std::max(initial.y, 0.01f), std::max(initial.z, 0.01f));
+	max_search_extents = limit;
+}
+
+/**
+ * Finds the nearest polygon to a local point. The hint polygon (usually the
+ * result of the previous query) is checked first, then the search box starts
+ * at agent size and only grows when nothing is found, so points already on
+ * the navmesh don't touch every tile inside the largest extents.
+ */
+dtStatus DetourNavigationQuery::find_nearest_poly(
+	const float *point,
+	DetourNavigationQueryFilter *filter,
+	dtPolyRef *ref,
+	float *nearest,
+	dtPolyRef hint)
+{
+	*ref = 0;
+	if (hint && navmesh_query->isValidPolyRef(hint, filter->dt_query_filter))
+	{
+		bool over_poly = false;
+		dtStatus status = navmesh_query->closestPointOnPoly(hint, point, nearest, &over_poly);
+		if (dtStatusSucceed(status) && over_poly && std::fabs(nearest[1] - point[1]) <= search_extents.y)
+		{
+			*ref = hint;
+			return status;
+		}
+	}
+
+	Vector3 extents = search_extents;
+	while (true)
+	{
+		dtStatus status = navmesh_query->findNearestPoly(point, &extents.coord[0], filter->dt_query_filter, ref, nearest);
+		if (dtStatusFailed(status) || *ref)
+		{
+			return status;
+		}
+		if (extents.x >= max_search_extents.x && extents.y >= max_search_extents.y && extents.z >= max_search_extents.z)
+		{
+			return status;
+		}
+		extents = Vector3(
+			std::min(extents.x * 2.f, max_search_extents.x),
+			std::min(extents.y * 2.f, max_search_extents.y),
+			std::min(extents.z * 2.f, max_search_extents.z));
+	}
+}
+
 Dictionary DetourNavigationQuery::find_path(
 	const Vector3 &start,
 	const Vector3 &end,
-	const Vector3 &extents,
 	DetourNavigationQueryFilter *filter)
 {
 	/* Function called by addon's api */
-	Vector3 local_start = inverse.xform(start);
-	Vector3 local_end = inverse.xform(end);
-	Dictionary result = _find_path(local_start, local_end, extents, filter);
+	Dictionary ret;
+	ret["points"] = Array();
+	ret["flags"] = Array();
 
-	PoolVector3Array points = result["points"];
-	PoolVector3Array::Write w = points.write();
+	std::vector<Vector3> path;
+	PathStats stats;
+	find_path_points(start, end, filter, path, &stats);
+	ret["status"] = stats.status;
+	ret["nodes_expanded"] = stats.nodes_expanded;
+	if (path.empty())
+	{
+		return ret;
+	}
 
-	for (int i = 0; i < points.size(); i++)
+	PoolVector3Array points;
+	PoolIntArray flags;
+	points.resize((int)path.size());
+	flags.resize((int)path.size());
 	{
-		w[i] = transform.xform(points[i]);
+		PoolVector3Array::Write points_write = points.write();
+		PoolIntArray::Write flags_write = flags.write();
+		for (int i = 0; i < (int)path.size(); i++)
+		{
+			points_write[i] = path[i];
+			flags_write[i] = 0;
+		}
 	}
-	return result;
+
+	ret["points"] = points;
+	ret["flags"] = flags;
+	return ret;
 }
 
-Dictionary DetourNavigationQuery::_find_path(
+/**
+ * Finds the straight path between two global points without touching
+ * Godot types, so it can run on worker threads (one query per thread)
+ */
+dtStatus DetourNavigationQuery::find_path_points(
 	const Vector3 &start,
 	const Vector3 &end,
-	const Vector3 &extents,
-	DetourNavigationQueryFilter *filter)
+	DetourNavigationQueryFilter *filter,
+	std::vector<Vector3> &points,
+	PathStats *stats)
 {
-	/* Internal function for finding path */
-	Dictionary ret;
-	ret["points"] = Array();
-	ret["flags"] = Array();
+	points.clear();
+	PathStats local_stats;
+	PathStats &result = stats ? *stats : local_stats;
+	result = PathStats();
+	dtStatus status = _find_path(inverse.xform(start), inverse.xform(end), filter, points, result);
+	for (Vector3 &point : points)
+	{
+		point = transform.xform(point);
+	}
+	return status;
+}
 
+dtStatus DetourNavigationQuery::_find_path(
+	const Vector3 &start,
+	const Vector3 &end,
+	DetourNavigationQueryFilter *filter,
+	std::vector<Vector3> &points,
+	PathStats &stats)
+{
+	/* Internal function for finding path */
 	if (!navmesh_query || detour_navmesh == nullptr)
 	{
-		return ret;
+		return DT_FAILURE;
+	}
+	if ((int)poly_path.size() < max_polys || (int)straight_path.size() < max_points * 3)
+	{
+		poly_path.resize(max_polys);
+		straight_path.resize(max_points * 3);
 	}
 
 	dtStatus status;
@@ -84,49 +228,509 @@ Dictionary DetourNavigationQuery::_find_path(
 	float StartNearest[3];
 	dtPolyRef EndPoly;
 	float EndNearest[3];
-	dtPolyRef PolyPath[MAX_POLYS];
 	int nPathCount = 0;
-	float StraightPath[MAX_POLYS * 2 * 3];
 	int nVertCount = 0;
 
 	// find the start polygon
-	status = navmesh_query->findNearestPoly(&start.coord[0], &extents.coord[0], filter->dt_query_filter, &StartPoly, StartNearest);
-	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK))
-		return ret; // couldn't find a polygon
+	status = find_nearest_poly(&start.coord[0], filter, &StartPoly, StartNearest, last_start_poly);
+	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK) || !StartPoly)
+		return DT_FAILURE; // couldn't find a polygon
+	last_start_poly = StartPoly;
 
 	// find the end polygon
-	status = navmesh_query->findNearestPoly(&end.coord[0], &extents.coord[0], filter->dt_query_filter, &EndPoly, EndNearest);
-	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK))
-		return ret; // couldn't find a polygon
-
-	status = navmesh_query->findPath(StartPoly, EndPoly, StartNearest, EndNearest, filter->dt_query_filter, PolyPath, &nPathCount, MAX_POLYS);
-	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK))
-		return ret; // couldn't create a path
-	if (nPathCount == 0)
-		return ret; // couldn't find a path
-
-	status = navmesh_query->findStraightPath(StartNearest, EndNearest, PolyPath, nPathCount, StraightPath, NULL, NULL, &nVertCount, MAX_POLYS * 2 * 3);
-	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK))
-		return ret; // couldn't create a path
-	if (nVertCount == 0)
-		return ret; // couldn't find a path
+	status = find_nearest_poly(&end.coord[0], filter, &EndPoly, EndNearest, last_end_poly);
+	if ((status & DT_FAILURE) || (status & DT_STATUS_DETAIL_MASK) || !EndPoly)
+		return DT_FAILURE; // couldn't find a polygon
+	last_end_poly = EndPoly;
 
-	PoolVector3Array points;
-	PoolIntArray flags;
-	points.resize(nVertCount);
-	flags.resize(nVertCount);
+	// different islands, A* would only exhaust the node pool
+	if (islands && !islands->is_reachable(StartPoly, EndPoly))
+		return DT_FAILURE;
+
+	dtStatus path_status;
+	if (landmarks && !landmarks->is_empty())
+	{
+		path_status = find_poly_path_landmarks(StartPoly, EndPoly, filter, poly_path.data(), &nPathCount, max_polys, &stats.nodes_expanded);
+	}
+	else
+	{
+		path_status = navmesh_query->findPath(StartPoly, EndPoly, StartNearest, EndNearest, filter->dt_query_filter, poly_path.data(), &nPathCount, max_polys);
+		stats.nodes_expanded = navmesh_query->getNodePool()->getNodeCount();
+	}
+	if (dtStatusFailed(path_status) || nPathCount == 0)
+		return DT_FAILURE; // couldn't find a path
 
-	PoolVector3Array::Write points_write = points.write();
-	PoolIntArray::Write flags_write = flags.write();
+	// partial corridor, the path ends at the closest point of its last polygon
+	float EndPoint[3];
+	dtVcopy(EndPoint, EndNearest);
+	if (poly_path[nPathCount - 1] != EndPoly)
+		navmesh_query->closestPointOnPoly(poly_path[nPathCount - 1], EndNearest, EndPoint, NULL);
 
+	status = navmesh_query->findStraightPath(StartNearest, EndPoint, poly_path.data(), nPathCount, straight_path.data(), NULL, NULL, &nVertCount, max_points);
+	if (dtStatusFailed(status) || nVertCount == 0)
+		return DT_FAILURE; // couldn't create a path
+
+	if (path_status & DT_OUT_OF_NODES)
+		stats.status = PATH_OUT_OF_NODES;
+	else if ((path_status & (DT_PARTIAL_RESULT | DT_BUFFER_TOO_SMALL)) || (status & DT_BUFFER_TOO_SMALL))
+		stats.status = PATH_PARTIAL;
+	else
+		stats.status = PATH_COMPLETE;
+
+	points.resize(nVertCount);
 	int nIndex = 0;
 	for (int nVert = 0; nVert < nVertCount; nVert++)
 	{
-		points_write[nVert] = Vector3(StraightPath[nIndex], StraightPath[nIndex + 1], StraightPath[nIndex + 2]);
+		points[nVert] = Vector3(straight_path[nIndex], straight_path[nIndex + 1], straight_path[nIndex + 2]);
 		nIndex += 3;
 	}
+	return stats.status == PATH_COMPLETE ? DT_SUCCESS : DT_SUCCESS | DT_PARTIAL_RESULT;
+}
 
-	ret["points"] = points;
-	ret["flags"] = flags;
+/**
+ * A* over polygon centers guided by ALT lower bounds. Unlike Detour's
+ * findPath it can use the landmark table, which keeps the search close
+ * to the real path on maze-like navmeshes. Out of nodes or without a full
+ * path it returns the path to the polygon closest to the end.
+ */
+dtStatus DetourNavigationQuery::find_poly_path_landmarks(
+	dtPolyRef start_ref,
+	dtPolyRef end_ref,
+	DetourNavigationQueryFilter *filter,
+	dtPolyRef *path,
+	int *path_count,
+	int max_path,
+	int *nodes_expanded)
+{
+	struct SearchNode
+	{
+		dtPolyRef ref;
+		int parent;
+		float cost;
+		float heuristic;
+		bool closed;
+	};
+
+	*path_count = 0;
+	const dtQueryFilter *dt_filter = filter->dt_query_filter;
+
+	/* Bounds are measured with unit cost, cheaper areas scale them down */
+	float scale = 1.f;
+	for (int i = 0; i < DT_MAX_AREAS; i++)
+	{
+		scale = std::min(scale, dt_filter->getAreaCost(i));
+	}
+	scale = std::max(scale, 0.f);
+
+	const dtMeshTile *tile;
+	const dtPoly *poly;
+	float end_center[3];
+	detour_navmesh->getTileAndPolyByRefUnsafe(end_ref, &tile, &poly);
+	NavmeshLandmarks::get_poly_center(tile, poly, end_center);
+
+	auto heuristic = [&](dtPolyRef ref, const float *center) {
+		return scale * std::max(dtVdist(center, end_center), landmarks->get_lower_bound(ref, end_ref));
+	};
+
+	std::vector<SearchNode> nodes;
+	std::unordered_map<dtPolyRef, int> node_indices;
+	typedef std::pair<float, int> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+
+	float start_center[3];
+	detour_navmesh->getTileAndPolyByRefUnsafe(start_ref, &tile, &poly);
+	NavmeshLandmarks::get_poly_center(tile, poly, start_center);
+	nodes.push_back({start_ref, -1, 0.f, heuristic(start_ref, start_center), false});
+	node_indices[start_ref] = 0;
+	open.push(Entry(nodes[0].heuristic, 0));
+
+	int best = 0;
+	int found = -1;
+	bool out_of_nodes = false;
+	while (!open.empty())
+	{
+		int current = open.top().second;
+		open.pop();
+		if (nodes[current].closed)
+		{
+			continue;
+		}
+		nodes[current].closed = true;
+
+		dtPolyRef ref = nodes[current].ref;
+		if (ref == end_ref)
+		{
+			found = current;
+			break;
+		}
+
+		float center[3];
+		detour_navmesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		NavmeshLandmarks::get_poly_center(tile, poly, center);
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			dtPolyRef neighbour = tile->links[k].ref;
+			if (!neighbour)
+			{
+				continue;
+			}
+			const dtMeshTile *neighbour_tile;
+			const dtPoly *neighbour_poly;
+			detour_navmesh->getTileAndPolyByRefUnsafe(neighbour, &neighbour_tile, &neighbour_poly);
+			if (!dt_filter->passFilter(neighbour, neighbour_tile, neighbour_poly))
+			{
+				continue;
+			}
+			float neighbour_center[3];
+			NavmeshLandmarks::get_poly_center(neighbour_tile, neighbour_poly, neighbour_center);
+			float cost = nodes[current].cost + dtVdist(center, neighbour_center) * dt_filter->getAreaCost(neighbour_poly->getArea());
+
+			auto it = node_indices.find(neighbour);
+			int index;
+			if (it == node_indices.end())
+			{
+				if ((int)nodes.size() >= max_nodes)
+				{
+					out_of_nodes = true;
+					continue;
+				}
+				index = (int)nodes.size();
+				nodes.push_back({neighbour, current, cost, heuristic(neighbour, neighbour_center), false});
+				node_indices[neighbour] = index;
+			}
+			else
+			{
+				index = it->second;
+				if (nodes[index].closed || cost >= nodes[index].cost)
+				{
+					continue;
+				}
+				nodes[index].cost = cost;
+				nodes[index].parent = current;
+			}
+			if (nodes[index].heuristic < nodes[best].heuristic)
+			{
+				best = index;
+			}
+			open.push(Entry(cost + nodes[index].heuristic, index));
+		}
+	}
+
+	dtStatus status = DT_SUCCESS;
+	int last = found;
+	if (found < 0)
+	{
+		last = best;
+		status |= DT_PARTIAL_RESULT;
+	}
+	if (out_of_nodes)
+	{
+		status |= DT_OUT_OF_NODES;
+	}
+
+	*nodes_expanded = (int)nodes.size();
+	std::vector<dtPolyRef> reversed;
+	for (int index = last; index >= 0; index = nodes[index].parent)
+	{
+		reversed.push_back(nodes[index].ref);
+	}
+	int count = std::min((int)reversed.size(), max_path);
+	if (count < (int)reversed.size())
+	{
+		status |= DT_BUFFER_TOO_SMALL;
+	}
+	for (int i = 0; i < count; i++)
+	{
+		path[i] = reversed[reversed.size() - 1 - i];
+	}
+	*path_count = count;
+	return status;
+}
+
+/**
+ * @returns false if there is no navmesh near the points or they are on
+ * islands that aren't connected
+ */
+bool DetourNavigationQuery::is_reachable(
+	const Vector3 &start,
+	const Vector3 &end,
+	DetourNavigationQueryFilter *filter)
+{
+	if (!navmesh_query || detour_navmesh == nullptr)
+	{
+		return false;
+	}
+	Vector3 local_start = inverse.xform(start);
+	Vector3 local_end = inverse.xform(end);
+	dtPolyRef start_ref, end_ref;
+	float nearest[3];
+	if (dtStatusFailed(find_nearest_poly(&local_start.coord[0], filter, &start_ref, nearest, last_start_poly)) || !start_ref)
+	{
+		return false;
+	}
+	if (dtStatusFailed(find_nearest_poly(&local_end.coord[0], filter, &end_ref, nearest, last_end_poly)) || !end_ref)
+	{
+		return false;
+	}
+	return islands == nullptr || islands->is_reachable(start_ref, end_ref);
+}
+
+/**
+ * Casts rays along the navmesh surface, from[i] to to[i]
+ *
+ * @returns dictionary with "hits" (1 if a wall was hit, 0 for a clear ray,
+ * -1 if it couldn't be cast because the start is off the navmesh),
+ * "positions", "normals" and "fractions" of the ray travelled, all in
+ * input order. Failed rays report the start point and fraction 0.
+ */
+Dictionary DetourNavigationQuery::raycast_many(
+	PoolVector3Array from,
+	PoolVector3Array to,
+	DetourNavigationQueryFilter *filter)
+{
+	Dictionary ret;
+	if (!navmesh_query || detour_navmesh == nullptr || from.size() != to.size())
+	{
+		return ret;
+	}
+
+	int count = from.size();
+	PoolIntArray hits;
+	PoolVector3Array positions;
+	PoolVector3Array normals;
+	PoolRealArray fractions;
+	hits.resize(count);
+	positions.resize(count);
+	normals.resize(count);
+	fractions.resize(count);
+	{
+		PoolVector3Array::Read from_read = from.read();
+		PoolVector3Array::Read to_read = to.read();
+		PoolIntArray::Write hits_write = hits.write();
+		PoolVector3Array::Write positions_write = positions.write();
+		PoolVector3Array::Write normals_write = normals.write();
+		PoolRealArray::Write fractions_write = fractions.write();
+
+		dtPolyRef hint = 0;
+		for (int i = 0; i < count; i++)
+		{
+			Vector3 start = inverse.xform(from_read[i]);
+			Vector3 end = inverse.xform(to_read[i]);
+			hits_write[i] = 0;
+			positions_write[i] = to_read[i];
+			normals_write[i] = Vector3();
+			fractions_write[i] = 1.f;
+
+			dtPolyRef start_ref;
+			float start_nearest[3];
+			dtStatus status = find_nearest_poly(&start.coord[0], filter, &start_ref, start_nearest, hint);
+			if (dtStatusFailed(status) || !start_ref)
+			{
+				/* Not a clear ray, nothing was cast */
+				hits_write[i] = -1;
+				positions_write[i] = from_read[i];
+				fractions_write[i] = 0.f;
+				continue;
+			}
+			hint = start_ref;
+
+			float t = 0.f;
+			float hit_normal[3];
+			int path_count = 0;
+			status = navmesh_query->raycast(start_ref, start_nearest, &end.coord[0], filter->dt_query_filter, &t, hit_normal, NULL, &path_count, 0);
+			if (dtStatusFailed(status))
+			{
+				hits_write[i] = -1;
+				positions_write[i] = from_read[i];
+				fractions_write[i] = 0.f;
+				continue;
+			}
+			if (t > 1.f)
+			{
+				continue;
+			}
+
+			Vector3 local_start(start_nearest[0], start_nearest[1], start_nearest[2]);
+			hits_write[i] = 1;
+			positions_write[i] = transform.xform(local_start + (end - local_start) * t);
+			normals_write[i] = transform.basis.xform(Vector3(hit_normal[0], hit_normal[1], hit_normal[2]));
+			fractions_write[i] = t;
+		}
+	}
+
+	ret["hits"] = hits;
+	ret["positions"] = positions;
+	ret["normals"] = normals;
+	ret["fractions"] = fractions;
 	return ret;
-}
\ No newline at end of file
+}
+
+/**
+ * @returns closest navmesh point for every input point, points without
+ * a polygon inside the largest search extents are returned unchanged
+ */
+PoolVector3Array DetourNavigationQuery::closest_point_many(
+	PoolVector3Array points,
+	DetourNavigationQueryFilter *filter)
+{
+	PoolVector3Array result;
+	if (!navmesh_query || detour_navmesh == nullptr)
+	{
+		return result;
+	}
+
+	int count = points.size();
+	result.resize(count);
+	PoolVector3Array::Read points_read = points.read();
+	PoolVector3Array::Write result_write = result.write();
+	dtPolyRef hint = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Vector3 local_point = inverse.xform(points_read[i]);
+		result_write[i] = points_read[i];
+
+		dtPolyRef ref;
+		float nearest[3];
+		dtStatus status = find_nearest_poly(&local_point.coord[0], filter, &ref, nearest, hint);
+		if (dtStatusSucceed(status) && ref)
+		{
+			hint = ref;
+			result_write[i] = transform.xform(Vector3(nearest[0], nearest[1], nearest[2]));
+		}
+	}
+	return result;
+}
+
+/**
+ * Samples the detail mesh height under every input point
+ *
+ * @returns global heights, NAN where no polygon is found
+ */
+PoolRealArray DetourNavigationQuery::get_height_many(
+	PoolVector3Array points,
+	DetourNavigationQueryFilter *filter)
+{
+	PoolRealArray result;
+	if (!navmesh_query || detour_navmesh == nullptr)
+	{
+		return result;
+	}
+
+	int count = points.size();
+	result.resize(count);
+	PoolVector3Array::Read points_read = points.read();
+	PoolRealArray::Write result_write = result.write();
+	dtPolyRef hint = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Vector3 local_point = inverse.xform(points_read[i]);
+		result_write[i] = NAN;
+
+		dtPolyRef ref;
+		float nearest[3];
+		dtStatus status = find_nearest_poly(&local_point.coord[0], filter, &ref, nearest, hint);
+		if (dtStatusFailed(status) || !ref)
+		{
+			continue;
+		}
+		hint = ref;
+
+		float height = nearest[1];
+		navmesh_query->getPolyHeight(ref, nearest, &height);
+		result_write[i] = transform.xform(Vector3(nearest[0], height, nearest[2])).y;
+	}
+	return result;
+}
+
+/**
+ * @returns random navmesh point reachable from center and roughly
+ * within radius, center itself if there is no navmesh around it
+ */
+Vector3 DetourNavigationQuery::random_point_in_circle(
+	const Vector3 &center,
+	float radius,
+	DetourNavigationQueryFilter *filter)
+{
+	if (!navmesh_query || detour_navmesh == nullptr)
+	{
+		return center;
+	}
+
+	Vector3 local_center = inverse.xform(center);
+	dtPolyRef center_ref;
+	float center_nearest[3];
+	dtStatus status = find_nearest_poly(&local_center.coord[0], filter, &center_ref, center_nearest);
+	if (dtStatusFailed(status) || !center_ref)
+	{
+		return center;
+	}
+
+	dtPolyRef random_ref;
+	float random_point[3];
+	status = navmesh_query->findRandomPointAroundCircle(
+		center_ref, center_nearest, radius, filter->dt_query_filter,
+		[]() { return (float)std::rand() / (float)RAND_MAX; },
+		&random_ref, random_point);
+	if (dtStatusFailed(status) || !random_ref)
+	{
+		return center;
+	}
+	return transform.xform(Vector3(random_point[0], random_point[1], random_point[2]));
+}
+
+/**
+ * Slides from[i] towards to[i] along the navmesh surface, constrained
+ * by walls, the way a walking agent would move
+ *
+ * @returns reached positions, from[i] if it is not on the navmesh
+ */
+PoolVector3Array DetourNavigationQuery::move_along_surface_many(
+	PoolVector3Array from,
+	PoolVector3Array to,
+	DetourNavigationQueryFilter *filter)
+{
+	static const int MAX_VISITED = 16;
+
+	PoolVector3Array result;
+	if (!navmesh_query || detour_navmesh == nullptr || from.size() != to.size())
+	{
+		return result;
+	}
+
+	int count = from.size();
+	result.resize(count);
+	PoolVector3Array::Read from_read = from.read();
+	PoolVector3Array::Read to_read = to.read();
+	PoolVector3Array::Write result_write = result.write();
+	dtPolyRef hint = 0;
+	for (int i = 0; i < count; i++)
+	{
+		Vector3 start = inverse.xform(from_read[i]);
+		Vector3 end = inverse.xform(to_read[i]);
+		result_write[i] = from_read[i];
+
+		dtPolyRef start_ref;
+		float start_nearest[3];
+		dtStatus status = find_nearest_poly(&start.coord[0], filter, &start_ref, start_nearest, hint);
+		if (dtStatusFailed(status) || !start_ref)
+		{
+			continue;
+		}
+		hint = start_ref;
+
+		float reached[3];
+		dtPolyRef visited[MAX_VISITED];
+		int visited_count = 0;
+		status = navmesh_query->moveAlongSurface(start_ref, start_nearest, &end.coord[0], filter->dt_query_filter,
+												 reached, visited, &visited_count, MAX_VISITED);
+		if (dtStatusFailed(status) || visited_count == 0)
+		{
+			continue;
+		}
+
+		/* moveAlongSurface keeps the start height, snap to the last visited polygon */
+		navmesh_query->getPolyHeight(visited[visited_count - 1], reached, &reached[1]);
+		result_write[i] = transform.xform(Vector3(reached[0], reached[1], reached[2]));
+	}
+	return result;
+}
@@ -1,9 +1,14 @@
 #ifndef NAVIGATION_QUERY_H
 #define NAVIGATION_QUERY_H
 #include <string>
+#include <vector>
 #include <DetourNavMeshQuery.h>
 #include <Godot.hpp>
 #include <Dictionary.hpp>
+#include <PoolArrays.hpp>
+
+#include "navmesh_islands.h"
+#include "navmesh_landmarks.h"
 
 namespace godot
 {
@@ -16,37 +21,79 @@ public:
 	~DetourNavigationQueryFilter();
 };
 
+/* Outcome of a path search, returned to scripts as "status" */
+enum PathStatus
+{
+	PATH_FAILED = 0,
+	PATH_COMPLETE = 1,
+	PATH_PARTIAL = 2,
+	PATH_OUT_OF_NODES = 3,
+};
+
+struct PathStats
+{
+	int status = PATH_FAILED;
+	/* Search nodes allocated (opened, not only expanded), what the node pool limit counts */
+	int nodes_expanded = 0;
+};
+
 class DetourNavigationQuery
 {
-	dtNavMeshQuery *navmesh_query;
+	dtNavMeshQuery *navmesh_query = nullptr;
 	godot::Transform transform;
 	godot::Transform inverse;
 
-protected:
-	static const int MAX_POLYS = 256;
+	/* Nearest polygon search starts at agent size and grows up to the limit */
+	Vector3 search_extents = Vector3(1.f, 2.f, 1.f);
+	Vector3 max_search_extents = Vector3(50.f, 50.f, 50.f);
+	dtPolyRef last_start_poly = 0;
+	dtPolyRef last_end_poly = 0;
 
-	Dictionary _find_path(const Vector3 &start, const Vector3 &end, const Vector3 &extents, DetourNavigationQueryFilter *filter);
+	/* Owned by the navigation mesh, used to reject paths between islands */
+	const NavmeshIslands *islands = nullptr;
+	/* Owned by the navigation mesh, path search uses ALT bounds when it's not empty */
+	const NavmeshLandmarks *landmarks = nullptr;
 
-public:
-	class QueryData
-	{
-	public:
-		Vector3 path_points[MAX_POLYS];
-		unsigned char path_flags[MAX_POLYS];
-		dtPolyRef polys[MAX_POLYS];
-		dtPolyRef path_polys[MAX_POLYS];
-	};
-	QueryData *query_data = nullptr;
+	/* Node pool and path buffer sizes, set from the navmesh parameters */
+	int max_nodes = 2048;
+	int max_polys = 256;
+	int max_points = 256;
+	std::vector<dtPolyRef> poly_path;
+	std::vector<float> straight_path;
+
+protected:
+	dtStatus find_poly_path_landmarks(dtPolyRef start_ref, dtPolyRef end_ref, DetourNavigationQueryFilter *filter,
+									  dtPolyRef *path, int *path_count, int max_path, int *nodes_expanded);
+	dtStatus _find_path(const Vector3 &start, const Vector3 &end, DetourNavigationQueryFilter *filter, std::vector<Vector3> &points, PathStats &stats);
 
+public:
 	DetourNavigationQuery();
 	~DetourNavigationQuery();
 
 	dtNavMesh *detour_navmesh = nullptr;
 
 	void init(dtNavMesh *dtMesh, const Transform &xform);
+	void rebind(dtNavMesh *dtMesh);
+	void set_limits(int nodes, int polys, int points);
+	void set_search_extents(const Vector3 &initial, const Vector3 &limit);
+	void set_islands(const NavmeshIslands *i) { islands = i; }
+	void set_landmarks(const NavmeshLandmarks *l) { landmarks = l; }
+	dtStatus find_nearest_poly(const float *point, DetourNavigationQueryFilter *filter, dtPolyRef *ref, float *nearest, dtPolyRef hint = 0);
+
+	int get_max_polys() const { return max_polys; }
+	dtNavMeshQuery *get_navmesh_query() { return navmesh_query; }
+	const Transform &get_transform() const { return transform; }
+	const Transform &get_inverse() const { return inverse; }
+	Dictionary find_path(const Vector3 &start, const Vector3 &end, DetourNavigationQueryFilter *filter);
+	dtStatus find_path_points(const Vector3 &start, const Vector3 &end, DetourNavigationQueryFilter *filter, std::vector<Vector3> &points, PathStats *stats = nullptr);
+	bool is_reachable(const Vector3 &start, const Vector3 &end, DetourNavigationQueryFilter *filter);
 
-	int get_max_polys() const { return MAX_POLYS; }
-	Dictionary find_path(const Vector3 &start, const Vector3 &end, const Vector3 &extents, DetourNavigationQueryFilter *filter);
+	/* Batched spatial queries, positions are in global space */
+	Dictionary raycast_many(PoolVector3Array from, PoolVector3Array to, DetourNavigationQueryFilter *filter);
+	PoolVector3Array closest_point_many(PoolVector3Array points, DetourNavigationQueryFilter *filter);
+	PoolRealArray get_height_many(PoolVector3Array points, DetourNavigationQueryFilter *filter);
+	Vector3 random_point_in_circle(const Vector3 &center, float radius, DetourNavigationQueryFilter *filter);
+	PoolVector3Array move_along_surface_many(PoolVector3Array from, PoolVector3Array to, DetourNavigationQueryFilter *filter);
 };
 } // namespace godot
 #endif
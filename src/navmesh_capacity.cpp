@@ -0,0 +1,137 @@
+#include <algorithm>
+#include "helpers.h"
+#include "navmesh_capacity.h"
+
+using namespace godot;
+
+/**
+ * Bits for tile_slots tiles, the rest for polygons. If the polygons of
+ * the biggest tile don't fit in the rest, polygons win: refs of polygons
+ * past the limit would be broken, while tiles past the limit fail to be
+ * added and are reported.
+ *
+ * @param max_tile_polys 0 if no tile is built yet
+ */
+NavmeshCapacity NavmeshCapacity::plan(int tile_slots, int max_tile_polys)
+{
+	NavmeshCapacity capacity;
+	capacity.tile_slots = std::max(tile_slots, 1);
+	capacity.max_tile_polys = max_tile_polys;
+
+	int tile_bits = (int)ilog2(nextPow2((unsigned int)capacity.tile_slots));
+	int poly_bits = max_tile_polys > 0 ? (int)ilog2(nextPow2((unsigned int)max_tile_polys)) : MIN_POLY_BITS;
+	poly_bits = std::min(poly_bits, ID_BITS);
+	if (tile_bits + poly_bits > ID_BITS)
+	{
+		capacity.fits = false;
+		tile_bits = ID_BITS - poly_bits;
+	}
+	capacity.tile_bits = tile_bits;
+	capacity.poly_bits = ID_BITS - tile_bits;
+	capacity.max_tiles = std::min(capacity.tile_slots, 1 << tile_bits);
+	return capacity;
+}
+
+void NavmeshCapacity::apply(dtNavMeshParams &params) const
+{
+	params.maxTiles = max_tiles;
+	params.maxPolys = 1 << poly_bits;
+}
+
+bool NavmeshCapacity::matches(const dtNavMeshParams &params) const
+{
+	return params.maxTiles == max_tiles && params.maxPolys == (1 << poly_bits);
+}
+
+std::string NavmeshCapacity::describe() const
+{
+	std::string description = std::to_string(max_tiles) + " tiles (" + std::to_string(tile_bits) + " bits) of up to " +
+							  std::to_string(1 << poly_bits) + " polygons (" + std::to_string(poly_bits) + " bits)";
+	if (!fits)
+	{
+		description += ", needs " + std::to_string(tile_slots) + " tiles of " + std::to_string(max_tile_polys) + " polygons";
+	}
+	return description;
+}
+
+int NavmeshCapacity::get_used_tiles(const dtNavMesh *navmesh)
+{
+	int used = 0;
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		if (navmesh->getTile(i)->header != nullptr)
+		{
+			used++;
+		}
+	}
+	return used;
+}
+
+int NavmeshCapacity::get_max_tile_polys(const dtNavMesh *navmesh)
+{
+	int max_polys = 0;
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshHeader *header = navmesh->getTile(i)->header;
+		if (header != nullptr)
+		{
+			max_polys = std::max(max_polys, header->polyCount);
+		}
+	}
+	return max_polys;
+}
+
+/**
+ * @return the most layers built at one tile position
+ */
+int NavmeshCapacity::get_max_tile_layers(const dtNavMesh *navmesh)
+{
+	int max_layers = 0;
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshHeader *header = navmesh->getTile(i)->header;
+		if (header != nullptr)
+		{
+			max_layers = std::max(max_layers, header->layer + 1);
+		}
+	}
+	return max_layers;
+}
+
+/**
+ * Tile array, tile lookup and the data of all tiles
+ */
+size_t NavmeshCapacity::get_navmesh_memory(const dtNavMesh *navmesh)
+{
+	int max_tiles = navmesh->getMaxTiles();
+	size_t memory = max_tiles * sizeof(dtMeshTile) + nextPow2((unsigned int)std::max(max_tiles / 4, 1)) * sizeof(dtMeshTile *);
+	for (int i = 0; i < max_tiles; i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (tile->header != nullptr)
+		{
+			memory += tile->dataSize;
+		}
+	}
+	return memory;
+}
+
+/**
+ * Compressed tile array, tile lookup, obstacles and the compressed layers
+ */
+size_t NavmeshCapacity::get_tile_cache_memory(const dtTileCache *tile_cache)
+{
+	const dtTileCacheParams *params = tile_cache->getParams();
+	size_t memory = params->maxTiles * sizeof(dtCompressedTile) +
+					nextPow2((unsigned int)std::max(params->maxTiles / 4, 1)) * sizeof(dtCompressedTile *) +
+					params->maxObstacles * sizeof(dtTileCacheObstacle);
+	for (int i = 0; i < tile_cache->getTileCount(); i++)
+	{
+		const dtCompressedTile *tile = tile_cache->getTile(i);
+		if (tile->header != nullptr)
+		{
+			memory += tile->dataSize;
+		}
+	}
+	return memory;
+}
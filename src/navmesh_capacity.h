@@ -0,0 +1,45 @@
+#ifndef NAVMESH_CAPACITY_H
+#define NAVMESH_CAPACITY_H
+
+#include <cstddef>
+#include <string>
+#include "DetourNavMesh.h"
+#include "DetourTileCache.h"
+
+namespace godot
+{
+
+/**
+ * Tile and polygon id budget of a navmesh. Detour packs salt, tile and
+ * polygon index into 32 bit refs and needs 10 bits of salt, so tile and
+ * polygon bits share 22. Only tile slots cost memory, spare bits go to
+ * polygons so rebuilt tiles can grow.
+ */
+struct NavmeshCapacity
+{
+	static const int ID_BITS = 22;
+	/* Polygon bits kept while no tile is built yet */
+	static const int MIN_POLY_BITS = 8;
+
+	int tile_slots = 0;
+	int max_tile_polys = 0;
+	int tile_bits = 0;
+	int poly_bits = 0;
+	int max_tiles = 0;
+	/* false if the tiles and polygons needed don't fit in the 22 bits */
+	bool fits = true;
+
+	static NavmeshCapacity plan(int tile_slots, int max_tile_polys);
+	void apply(dtNavMeshParams &params) const;
+	bool matches(const dtNavMeshParams &params) const;
+	std::string describe() const;
+
+	static int get_used_tiles(const dtNavMesh *navmesh);
+	static int get_max_tile_polys(const dtNavMesh *navmesh);
+	static int get_max_tile_layers(const dtNavMesh *navmesh);
+	static size_t get_navmesh_memory(const dtNavMesh *navmesh);
+	static size_t get_tile_cache_memory(const dtTileCache *tile_cache);
+};
+
+} // namespace godot
+#endif
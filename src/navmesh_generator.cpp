@@ -38,14 +38,20 @@ DetourNavigationMeshGenerator::~DetourNavigationMeshGenerator()
 		delete collision_ids;
 		collision_ids = nullptr;
 	}
+	if (collision_layers != nullptr)
+	{
+		delete collision_layers;
+		collision_layers = nullptr;
+	}
 }
 
 void DetourNavigationMeshGenerator::build()
 {
-	joint_build();
+	joint_build(1);
 
 	unsigned int result = build_tiles(
 		0, 0, get_num_tiles_x() - 1, get_num_tiles_z() - 1);
+	fit_capacity(1);
 }
 
 void DetourNavigationMeshGenerator::setup_generator()
@@ -68,8 +74,10 @@ void DetourNavigationMeshGenerator::setup_generator()
 /**
  * Function that does mutual detour/recast logic for both
  * regular navmesh and cached navmesh
+ *
+ * @param layers_per_tile navmesh tiles that can be built at one tile position
  */
-void DetourNavigationMeshGenerator::joint_build()
+void DetourNavigationMeshGenerator::joint_build(int layers_per_tile)
 {
 	for (int i = 0; i < input_meshes->size(); i++)
 	{
@@ -87,20 +95,18 @@ void DetourNavigationMeshGenerator::joint_build()
 		Godot::print(tile_message.c_str());
 	}
 
-	/* Calculate how many bits are required to uniquely identify all tiles */
-	unsigned int tile_bits = (unsigned int)ilog2(nextPow2(get_num_tiles_x() * get_num_tiles_z() * navmesh_parameters->get_max_layers()));
-	tile_bits = std::min((int)tile_bits, 14);
-
-	/* Set dt navmesh parameters*/
-	unsigned int poly_bits = 22 - tile_bits;
-	unsigned int max_tiles = 1u << tile_bits;
-	unsigned int max_polys = 1 << poly_bits;
+	/* Polygon counts aren't known yet, fit_capacity trims this once tiles are built */
+	NavmeshCapacity capacity = NavmeshCapacity::plan(get_num_tiles_x() * get_num_tiles_z() * layers_per_tile, 0);
+	if (!capacity.fits)
+	{
+		std::string capacity_message = "Navmesh doesn't fit in Detour's tile ids: " + capacity.describe() + ", use a bigger tile_size";
+		ERR_PRINT(capacity_message.c_str());
+	}
 
 	dtNavMeshParams params;
 	params.tileWidth = tile_edge_length;
 	params.tileHeight = tile_edge_length;
-	params.maxTiles = max_tiles;
-	params.maxPolys = max_polys;
+	capacity.apply(params);
 	params.orig[0] = params.orig[1] = params.orig[2] = 0.f;
 
 	/* Initialize and allocate place for detour navmesh instance */
@@ -116,6 +122,72 @@ void DetourNavigationMeshGenerator::joint_build()
 	}
 }
 
+/**
+ * Sizes the navmesh for the tiles that were built: tile slots for every
+ * tile position times layers_per_tile, and polygon bits for the biggest
+ * tile. If that differs from the size it was created with, the tiles are
+ * moved to a navmesh of the right size. Warns if they can't fit.
+ */
+void DetourNavigationMeshGenerator::fit_capacity(int layers_per_tile)
+{
+	if (detour_navmesh == nullptr)
+	{
+		return;
+	}
+	int max_tile_polys = NavmeshCapacity::get_max_tile_polys(detour_navmesh);
+	NavmeshCapacity capacity = NavmeshCapacity::plan(get_num_tiles_x() * get_num_tiles_z() * layers_per_tile, max_tile_polys);
+	if (!capacity.fits)
+	{
+		std::string capacity_message = "Navmesh doesn't fit in Detour's tile and polygon ids: " + capacity.describe() + ", use a smaller tile_size or a bigger cell_size";
+		ERR_PRINT(capacity_message.c_str());
+	}
+
+	const dtNavMeshParams *current = detour_navmesh->getParams();
+	if (!capacity.matches(*current))
+	{
+		dtNavMeshParams params = *current;
+		capacity.apply(params);
+		dtNavMesh *resized = dtAllocNavMesh();
+		if (resized == nullptr || dtStatusFailed(resized->init(&params)))
+		{
+			dtFreeNavMesh(resized);
+			ERR_PRINT("Could not resize navmesh, keeping its capacity");
+			return;
+		}
+		const dtNavMesh *source = detour_navmesh;
+		for (int i = 0; i < source->getMaxTiles(); i++)
+		{
+			const dtMeshTile *tile = source->getTile(i);
+			if (tile->header == nullptr)
+			{
+				continue;
+			}
+			unsigned char *data = (unsigned char *)dtAlloc(tile->dataSize, DT_ALLOC_PERM);
+			if (data == nullptr)
+			{
+				continue;
+			}
+			memcpy(data, tile->data, tile->dataSize);
+			if (dtStatusFailed(resized->addTile(data, tile->dataSize, DT_TILE_FREE_DATA, 0, nullptr)))
+			{
+				dtFree(data);
+				ERR_PRINT("Navmesh tile dropped while resizing");
+			}
+		}
+		dtFreeNavMesh(detour_navmesh);
+		detour_navmesh = resized;
+	}
+
+	if (OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string capacity_message = "Navmesh capacity " + capacity.describe() + ", " +
+									   std::to_string(NavmeshCapacity::get_used_tiles(detour_navmesh)) + " tiles used, biggest has " +
+									   std::to_string(max_tile_polys) + " polygons, " +
+									   std::to_string(NavmeshCapacity::get_navmesh_memory(detour_navmesh)) + " bytes";
+		Godot::print(capacity_message.c_str());
+	}
+}
+
 unsigned int DetourNavigationMeshGenerator::build_tiles(
 	int x1, int z1, int x2, int z2)
 {
@@ -172,7 +244,7 @@ void DetourNavigationMeshGenerator::init_rc_config(rcConfig &config, Vector3 &bm
  */
 bool DetourNavigationMeshGenerator::init_tile_data(
 	rcConfig &config, Vector3 &bmin, Vector3 &bmax, std::vector<float> &points,
-	std::vector<int> &indices)
+	std::vector<int> &indices, std::vector<unsigned char> &areas)
 {
 	/* Set the tile AABB */
 	AABB expbox(bmin, bmax - bmin);
@@ -196,6 +268,10 @@ bool DetourNavigationMeshGenerator::init_tile_data(
 			continue;
 		}
 		add_meshdata(i, points, indices);
+
+		/* Every triangle of the mesh gets the area of its body's layers */
+		int layer = (collision_layers != nullptr && i < collision_layers->size()) ? collision_layers->at(i) : 0;
+		areas.resize(indices.size() / 3, navmesh_parameters->get_area_for_layer(layer));
 	}
 
 	if (points.size() == 0 || indices.size() == 0)
@@ -211,7 +287,8 @@ bool DetourNavigationMeshGenerator::init_tile_data(
  */
 bool DetourNavigationMeshGenerator::init_heightfield_context(
 	rcConfig &config, rcCompactHeightfield *compact_heightfield,
-	rcContext *ctx, std::vector<float> &points, std::vector<int> &indices)
+	rcContext *ctx, std::vector<float> &points, std::vector<int> &indices,
+	std::vector<unsigned char> &areas)
 {
 	// returns success value
 
@@ -239,6 +316,13 @@ bool DetourNavigationMeshGenerator::init_heightfield_context(
 	rcMarkWalkableTriangles(
 		ctx, config.walkableSlopeAngle, &points[0],
 		static_cast<int>(points.size() / 3), &indices[0], ntris, &tri_areas[0]);
+	for (int i = 0; i < ntris && i < (int)areas.size(); i++)
+	{
+		if (tri_areas[i] == RC_WALKABLE_AREA)
+		{
+			tri_areas[i] = areas[i];
+		}
+	}
 
 	rcRasterizeTriangles(
 		ctx, &points[0], static_cast<int>(points.size() / 3), &indices[0],
@@ -267,6 +351,7 @@ bool DetourNavigationMeshGenerator::init_heightfield_context(
 		ERR_PRINT("Could not erode walkable area.");
 		return false;
 	}
+	mark_area_volumes(ctx, config, *compact_heightfield);
 	if (navmesh_parameters->get_partition_type() == 0)
 	{ // TODO: Use enum
 		if (!rcBuildDistanceField(ctx, *compact_heightfield))
@@ -307,7 +392,8 @@ bool DetourNavigationMeshGenerator::build_tile(int x, int z)
 	init_rc_config(config, bmin, bmax);
 	std::vector<float> points;
 	std::vector<int> indices;
-	if (init_tile_data(config, bmin, bmax, points, indices))
+	std::vector<unsigned char> areas;
+	if (init_tile_data(config, bmin, bmax, points, indices, areas))
 	{
 		return true;
 	}
@@ -315,7 +401,7 @@ bool DetourNavigationMeshGenerator::build_tile(int x, int z)
 	rcContext *ctx = new rcContext(true);
 	rcCompactHeightfield *compact_heightfield = rcAllocCompactHeightfield();
 
-	if (!init_heightfield_context(config, compact_heightfield, ctx, points, indices))
+	if (!init_heightfield_context(config, compact_heightfield, ctx, points, indices, areas))
 	{
 		return false;
 	}
@@ -369,7 +455,7 @@ bool DetourNavigationMeshGenerator::build_tile(int x, int z)
 	{
 		if (poly_mesh->areas[i] != RC_NULL_AREA)
 		{
-			poly_mesh->flags[i] = 0x1;
+			poly_mesh->flags[i] = navmesh_parameters->get_flags_for_area(poly_mesh->areas[i]);
 		}
 	}
 
@@ -400,6 +486,10 @@ bool DetourNavigationMeshGenerator::build_tile(int x, int z)
 	params.ch = config.ch;
 	params.buildBvTree = true;
 
+	OffMeshTileData offmesh;
+	collect_offmesh_links(x, z, offmesh);
+	offmesh.apply(params);
+
 	if (!dtCreateNavMeshData(&params, &nav_data, &nav_data_size))
 	{
 		if (OS::get_singleton()->is_stdout_verbose())
@@ -466,6 +556,10 @@ void DetourNavigationMeshGenerator::remove_collision_shape(int64_t collision_id)
 		input_transforms->erase(input_transforms->begin() + start, input_transforms->begin() + end);
 		input_aabbs->erase(input_aabbs->begin() + start, input_aabbs->begin() + end);
 		collision_ids->erase(collision_ids->begin() + start, collision_ids->begin() + end);
+		if (collision_layers != nullptr && end <= collision_layers->size())
+		{
+			collision_layers->erase(collision_layers->begin() + start, collision_layers->begin() + end);
+		}
 	}
 }
 
@@ -510,26 +604,375 @@ void DetourNavigationMeshGenerator::mark_dirty(int start_index, int end_index)
 
 	for (int aabb_index = start_index; aabb_index < end_index; aabb_index++)
 	{
-		AABB changes_bounding_box = input_transforms->at(aabb_index).xform(input_aabbs->at(aabb_index));
-		const float tile_edge_length = (float)navmesh_parameters->get_tile_size() * navmesh_parameters->get_cell_size();
+		mark_dirty_box(input_transforms->at(aabb_index).xform(input_aabbs->at(aabb_index)));
+	}
+}
+
+/**
+ * Marks all tiles the box overlaps as dirty
+ */
+void DetourNavigationMeshGenerator::mark_dirty_box(const AABB &box)
+{
+	if (detour_navmesh == nullptr)
+	{
+		return;
+	}
+	if (dirty_tiles == nullptr)
+	{
+		init_dirty_tiles();
+	}
+
+	int min_x, min_z, max_x, max_z;
+	get_tile_range(box, min_x, min_z, max_x, max_z);
+	for (int i = min_x; i < max_x; i++)
+	{
+		for (int j = min_z; j < max_z; j++)
+		{
+			dirty_tiles[i][j] = 1;
+		}
+	}
+}
+
+/**
+ * Tiles overlapped by the box, clamped to the navmesh
+ *
+ * @param min_x and min_z are including, max_x and max_z excluding
+ */
+void DetourNavigationMeshGenerator::get_tile_range(const AABB &box, int &min_x, int &min_z, int &max_x, int &max_z)
+{
+	const float tile_edge_length = (float)navmesh_parameters->get_tile_size() * navmesh_parameters->get_cell_size();
+
+	Vector3 min = (box.position - bounding_box.position) / tile_edge_length;
+	Vector3 max = (box.position + box.size - bounding_box.position) / tile_edge_length;
+
+	min_x = std::max(0, int(std::floor(min.x)));
+	min_z = std::max(0, int(std::floor(min.z)));
+	max_x = std::min(int(std::ceil(max.x)), get_num_tiles_x());
+	max_z = std::min(int(std::ceil(max.z)), get_num_tiles_z());
+}
+
+/**
+ * Moves a global volume into the space of the DetourNavigation node, the
+ * space tiles are built in. Heights cover the transformed prism.
+ */
+AreaVolume DetourNavigationMeshGenerator::localize_area_volume(const AreaVolume &global_volume)
+{
+	AreaVolume volume = global_volume;
+	Transform base = global_transform.inverse();
+	volume.verts.clear();
+	for (size_t i = 0; i + 2 < global_volume.verts.size(); i += 3)
+	{
+		Vector3 low = base.xform(Vector3(global_volume.verts[i], global_volume.hmin, global_volume.verts[i + 2]));
+		Vector3 high = base.xform(Vector3(global_volume.verts[i], global_volume.hmax, global_volume.verts[i + 2]));
+		volume.verts.push_back(low.x);
+		volume.verts.push_back(low.y);
+		volume.verts.push_back(low.z);
+		if (i == 0)
+		{
+			volume.bounds = AABB(low, Vector3());
+		}
+		else
+		{
+			volume.bounds.expand_to(low);
+		}
+		volume.bounds.expand_to(high);
+	}
+	volume.hmin = volume.bounds.position.y;
+	volume.hmax = volume.bounds.position.y + volume.bounds.size.y;
+	return volume;
+}
+
+/**
+ * Adds the volume or replaces the one with the same id
+ *
+ * @param global_volume the volume with global points
+ * @param rebuild marks the tiles under the old and the new volume dirty
+ * @return false if the volume didn't change
+ */
+bool DetourNavigationMeshGenerator::set_area_volume(const AreaVolume &global_volume, bool rebuild)
+{
+	AreaVolume volume = localize_area_volume(global_volume);
+	auto existing = std::find_if(area_volumes.begin(), area_volumes.end(),
+								 [&volume](const AreaVolume &v) { return v.id == volume.id; });
+	if (existing != area_volumes.end())
+	{
+		if (existing->verts == volume.verts && existing->hmin == volume.hmin &&
+			existing->hmax == volume.hmax && existing->area == volume.area)
+		{
+			return false;
+		}
+		if (rebuild)
+		{
+			mark_dirty_box(existing->bounds);
+		}
+		*existing = volume;
+	}
+	else
+	{
+		area_volumes.push_back(volume);
+	}
+	if (rebuild)
+	{
+		mark_dirty_box(volume.bounds);
+	}
+	volume_cells_valid = false;
+	return true;
+}
 
-		Vector3 min = (changes_bounding_box.position - bounding_box.position) / tile_edge_length;
-		Vector3 max = (changes_bounding_box.position + changes_bounding_box.size -
-					   (bounding_box.position)) /
-					  tile_edge_length;
+void DetourNavigationMeshGenerator::remove_area_volume(int64_t id)
+{
+	auto existing = std::find_if(area_volumes.begin(), area_volumes.end(),
+								 [id](const AreaVolume &v) { return v.id == id; });
+	if (existing == area_volumes.end())
+	{
+		return;
+	}
+	mark_dirty_box(existing->bounds);
+	area_volumes.erase(existing);
+	volume_cells_valid = false;
+}
 
-		if (dirty_tiles == nullptr)
+/**
+ * Buckets the volumes by the tiles they overlap, so a tile build only
+ * looks at the volumes near it
+ */
+void DetourNavigationMeshGenerator::index_area_volumes()
+{
+	volume_cells.assign(get_num_tiles_x() * get_num_tiles_z(), std::vector<int>());
+	for (int v = 0; v < (int)area_volumes.size(); v++)
+	{
+		int min_x, min_z, max_x, max_z;
+		get_tile_range(area_volumes[v].bounds, min_x, min_z, max_x, max_z);
+		for (int i = min_x; i < max_x; i++)
 		{
-			init_dirty_tiles();
+			for (int j = min_z; j < max_z; j++)
+			{
+				volume_cells[i * get_num_tiles_z() + j].push_back(v);
+			}
 		}
-		for (int i = std::max(0, int(std::floor(min.x))); i < std::min(int(std::ceil(max.x)), get_num_tiles_x()); i++)
+	}
+	volume_cells_valid = true;
+}
+
+/**
+ * Applies the volumes overlapping the tile (border included) to the
+ * compact heightfield, before regions are built
+ */
+void DetourNavigationMeshGenerator::mark_area_volumes(rcContext *ctx, rcConfig &config, rcCompactHeightfield &compact_heightfield)
+{
+	if (area_volumes.empty())
+	{
+		return;
+	}
+	if (!volume_cells_valid)
+	{
+		index_area_volumes();
+	}
+
+	AABB tile_box(Vector3(config.bmin[0], config.bmin[1], config.bmin[2]),
+				  Vector3(config.bmax[0] - config.bmin[0], config.bmax[1] - config.bmin[1], config.bmax[2] - config.bmin[2]));
+	int min_x, min_z, max_x, max_z;
+	get_tile_range(tile_box, min_x, min_z, max_x, max_z);
+
+	/* The border reaches into neighbour tiles, a volume can be in several cells */
+	std::vector<int> overlapping;
+	for (int i = min_x; i < max_x; i++)
+	{
+		for (int j = min_z; j < max_z; j++)
 		{
-			for (int j = std::max(0, int(std::floor(min.z))); j < std::min(get_num_tiles_z(), int(std::ceil(max.z))); j++)
+			for (int v : volume_cells[i * get_num_tiles_z() + j])
 			{
-				dirty_tiles[i][j] = 1;
+				overlapping.push_back(v);
 			}
 		}
 	}
+	/* Later volumes win where they overlap, the same order in every tile */
+	std::sort(overlapping.begin(), overlapping.end());
+	overlapping.erase(std::unique(overlapping.begin(), overlapping.end()), overlapping.end());
+	for (int v : overlapping)
+	{
+		const AreaVolume &volume = area_volumes[v];
+		if (volume.verts.size() < 9)
+		{
+			continue;
+		}
+		rcMarkConvexPolyArea(ctx, volume.verts.data(), static_cast<int>(volume.verts.size() / 3),
+							 volume.hmin, volume.hmax, volume.area, compact_heightfield);
+	}
+}
+
+/**
+ * Finds the tile the position is in
+ *
+ * @return false if it's outside the navmesh
+ */
+bool DetourNavigationMeshGenerator::get_tile_at(const Vector3 &position, int &x, int &z)
+{
+	const float tile_edge_length = (float)navmesh_parameters->get_tile_size() * navmesh_parameters->get_cell_size();
+	x = int(std::floor((position.x - bounding_box.position.x) / tile_edge_length));
+	z = int(std::floor((position.z - bounding_box.position.z) / tile_edge_length));
+	return x >= 0 && z >= 0 && x < get_num_tiles_x() && z < get_num_tiles_z();
+}
+
+void DetourNavigationMeshGenerator::mark_dirty_point(const Vector3 &position)
+{
+	int x, z;
+	if (detour_navmesh == nullptr || !get_tile_at(position, x, z))
+	{
+		return;
+	}
+	if (dirty_tiles == nullptr)
+	{
+		init_dirty_tiles();
+	}
+	dirty_tiles[x][z] = 1;
+}
+
+/**
+ * Adds the link or replaces the one with the same id. Detour stores a
+ * link in the tile of its start point and connects the end when tiles
+ * are added, so only that tile is rebuilt.
+ *
+ * @param global_start, global_end link ends, moved into the space tiles are built in
+ * @param rebuild marks the tiles of the old and the new start dirty
+ * @return false if the link didn't change
+ */
+bool DetourNavigationMeshGenerator::set_offmesh_link(
+	int64_t id, Vector3 global_start, Vector3 global_end, float radius,
+	unsigned char area, bool bidirectional, bool rebuild)
+{
+	Transform base = global_transform.inverse();
+	Vector3 start = base.xform(global_start);
+	Vector3 end = base.xform(global_end);
+	unsigned char dir = bidirectional ? DT_OFFMESH_CON_BIDIR : 0;
+	unsigned short flags = navmesh_parameters->get_flags_for_area(area);
+
+	auto existing = std::find(offmesh_ids.begin(), offmesh_ids.end(), id);
+	if (existing != offmesh_ids.end())
+	{
+		int i = static_cast<int>(existing - offmesh_ids.begin());
+		if (offmesh_vertices[2 * i] == start && offmesh_vertices[2 * i + 1] == end &&
+			offmesh_radius[i] == radius && offmesh_areas[i] == area && offmesh_dir[i] == dir)
+		{
+			return false;
+		}
+		if (rebuild)
+		{
+			mark_dirty_point(offmesh_vertices[2 * i]);
+		}
+		offmesh_vertices[2 * i] = start;
+		offmesh_vertices[2 * i + 1] = end;
+		offmesh_radius[i] = radius;
+		offmesh_flags[i] = flags;
+		offmesh_areas[i] = area;
+		offmesh_dir[i] = dir;
+	}
+	else
+	{
+		offmesh_ids.push_back(id);
+		offmesh_vertices.push_back(start);
+		offmesh_vertices.push_back(end);
+		offmesh_radius.push_back(radius);
+		offmesh_flags.push_back(flags);
+		offmesh_areas.push_back(area);
+		offmesh_dir.push_back(dir);
+	}
+	if (rebuild)
+	{
+		mark_dirty_point(start);
+	}
+	offmesh_cells_valid = false;
+	return true;
+}
+
+void DetourNavigationMeshGenerator::remove_offmesh_link(int64_t id)
+{
+	auto existing = std::find(offmesh_ids.begin(), offmesh_ids.end(), id);
+	if (existing == offmesh_ids.end())
+	{
+		return;
+	}
+	int i = static_cast<int>(existing - offmesh_ids.begin());
+	mark_dirty_point(offmesh_vertices[2 * i]);
+
+	offmesh_ids.erase(existing);
+	offmesh_vertices.erase(offmesh_vertices.begin() + 2 * i, offmesh_vertices.begin() + 2 * i + 2);
+	offmesh_radius.erase(offmesh_radius.begin() + i);
+	offmesh_flags.erase(offmesh_flags.begin() + i);
+	offmesh_areas.erase(offmesh_areas.begin() + i);
+	offmesh_dir.erase(offmesh_dir.begin() + i);
+	offmesh_cells_valid = false;
+}
+
+/**
+ * Buckets the links by the tile of their start point
+ */
+void DetourNavigationMeshGenerator::index_offmesh_links()
+{
+	offmesh_cells.assign(get_num_tiles_x() * get_num_tiles_z(), std::vector<int>());
+	for (int i = 0; i < (int)offmesh_ids.size(); i++)
+	{
+		int x, z;
+		if (get_tile_at(offmesh_vertices[2 * i], x, z))
+		{
+			offmesh_cells[x * get_num_tiles_z() + z].push_back(i);
+		}
+	}
+	offmesh_cells_valid = true;
+}
+
+/**
+ * Fills data with the links starting in the tile, Detour drops the ones
+ * outside the height of a tile layer
+ */
+void DetourNavigationMeshGenerator::collect_offmesh_links(int x, int z, OffMeshTileData &data)
+{
+	data.clear();
+	if (offmesh_ids.empty() || x < 0 || z < 0 || x >= get_num_tiles_x() || z >= get_num_tiles_z())
+	{
+		return;
+	}
+	if (!offmesh_cells_valid)
+	{
+		index_offmesh_links();
+	}
+	for (int i : offmesh_cells[x * get_num_tiles_z() + z])
+	{
+		for (int j = 0; j < 2; j++)
+		{
+			const Vector3 &point = offmesh_vertices[2 * i + j];
+			data.verts.push_back(point.x);
+			data.verts.push_back(point.y);
+			data.verts.push_back(point.z);
+		}
+		data.radius.push_back(offmesh_radius[i]);
+		data.flags.push_back(offmesh_flags[i]);
+		data.areas.push_back(offmesh_areas[i]);
+		data.dir.push_back(offmesh_dir[i]);
+		/* Low bits of the node id, lets the game recognize the link */
+		data.user_ids.push_back((unsigned int)offmesh_ids[i]);
+	}
+}
+
+void OffMeshTileData::clear()
+{
+	verts.clear();
+	radius.clear();
+	flags.clear();
+	areas.clear();
+	dir.clear();
+	user_ids.clear();
+}
+
+void OffMeshTileData::apply(dtNavMeshCreateParams &params)
+{
+	params.offMeshConVerts = verts.data();
+	params.offMeshConRad = radius.data();
+	params.offMeshConFlags = flags.data();
+	params.offMeshConAreas = areas.data();
+	params.offMeshConDir = dir.data();
+	params.offMeshConUserID = user_ids.data();
+	params.offMeshConCount = static_cast<int>(radius.size());
 }
 
 /**
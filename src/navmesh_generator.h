@@ -20,6 +20,7 @@
 #include "navmesh_parameters.h"
 #include "helpers.h"
 #include "tilecache_helpers.h"
+#include "navmesh_capacity.h"
 #include "DetourNavMesh.h"
 #include "DetourNavMeshBuilder.h"
 #include "DetourTileCache.h"
@@ -27,6 +28,37 @@
 
 namespace godot
 {
+/**
+ * Convex volume that overrides the area of the walkable spans inside it.
+ * Nodes describe it with global points, the generator keeps it in the
+ * space tiles are built in. Only x and z of each point are used.
+ */
+struct AreaVolume
+{
+	int64_t id = 0;
+	std::vector<float> verts;
+	float hmin = 0.f;
+	float hmax = 0.f;
+	unsigned char area = RC_WALKABLE_AREA;
+	AABB bounds;
+};
+
+/**
+ * Off-mesh links of one tile in the layout dtNavMeshCreateParams wants
+ */
+struct OffMeshTileData
+{
+	std::vector<float> verts;
+	std::vector<float> radius;
+	std::vector<unsigned short> flags;
+	std::vector<unsigned char> areas;
+	std::vector<unsigned char> dir;
+	std::vector<unsigned int> user_ids;
+
+	void clear();
+	void apply(dtNavMeshCreateParams &params);
+};
+
 class DetourNavigationMeshGenerator
 {
 public:
@@ -37,6 +69,8 @@ public:
 	std::vector<Ref<Mesh>> *input_meshes;
 	std::vector<Transform> *input_transforms;
 	std::vector<AABB> *input_aabbs;
+	/* Collision layers of the bodies the meshes come from, 0 for mesh instances */
+	std::vector<int> *collision_layers = nullptr;
 
 	Ref<NavmeshParameters> navmesh_parameters;
 	Transform global_transform;
@@ -44,23 +78,42 @@ public:
 
 	int **dirty_tiles = nullptr;
 
+	std::vector<AreaVolume> area_volumes;
+	/* Indices of the volumes overlapping each tile, x * num_tiles_z + z */
+	std::vector<std::vector<int>> volume_cells;
+	bool volume_cells_valid = false;
+
+	/* Off-mesh links in the space tiles are built in, start and end of link i are offmesh_vertices[2 * i] and [2 * i + 1] */
+	std::vector<int64_t> offmesh_ids;
+	std::vector<Vector3> offmesh_vertices;
+	std::vector<float> offmesh_radius;
+	std::vector<unsigned short> offmesh_flags;
+	std::vector<unsigned char> offmesh_areas;
+	std::vector<unsigned char> offmesh_dir;
+	/* Indices of the links starting in each tile, x * num_tiles_z + z */
+	std::vector<std::vector<int>> offmesh_cells;
+	bool offmesh_cells_valid = false;
+
 	SETGET(initialized, bool);
 	SETGET(num_tiles_x, int);
 	SETGET(num_tiles_z, int);
 
 	void init_mesh_data(
 		std::vector<Ref<Mesh>> *meshes, std::vector<Transform> *transforms,
-		std::vector<AABB> *aabbs, Transform g_transform, std::vector<int64_t> *c_ids)
+		std::vector<AABB> *aabbs, Transform g_transform, std::vector<int64_t> *c_ids,
+		std::vector<int> *c_layers)
 	{
 		global_transform = g_transform;
 		input_aabbs = aabbs;
 		input_transforms = transforms;
 		input_meshes = meshes;
 		collision_ids = c_ids;
+		collision_layers = c_layers;
 	};
 
 	void build();
-	void joint_build();
+	void joint_build(int layers_per_tile);
+	void fit_capacity(int layers_per_tile);
 	void setup_generator();
 	bool alloc();
 	bool init(dtNavMeshParams *params);
@@ -89,11 +142,12 @@ public:
 
 	bool init_heightfield_context(
 		rcConfig &config, rcCompactHeightfield *compact_heightfield,
-		rcContext *ctx, std::vector<float> &points, std::vector<int> &indices);
+		rcContext *ctx, std::vector<float> &points, std::vector<int> &indices,
+		std::vector<unsigned char> &areas);
 
 	bool init_tile_data(
 		rcConfig &config, Vector3 &bmin, Vector3 &bmax, std::vector<float> &points,
-		std::vector<int> &indices);
+		std::vector<int> &indices, std::vector<unsigned char> &areas);
 
 	void get_tile_bounding_box(
 		int x, int z, Vector3 &bmin, Vector3 &bmax);
@@ -104,6 +158,33 @@ public:
 
 	void mark_dirty(int start_index, int end_index);
 
+	void mark_dirty_box(const AABB &box);
+
+	void get_tile_range(const AABB &box, int &min_x, int &min_z, int &max_x, int &max_z);
+
+	AreaVolume localize_area_volume(const AreaVolume &global_volume);
+
+	bool set_area_volume(const AreaVolume &global_volume, bool rebuild);
+
+	void remove_area_volume(int64_t id);
+
+	void index_area_volumes();
+
+	void mark_area_volumes(rcContext *ctx, rcConfig &config, rcCompactHeightfield &compact_heightfield);
+
+	bool get_tile_at(const Vector3 &position, int &x, int &z);
+
+	void mark_dirty_point(const Vector3 &position);
+
+	bool set_offmesh_link(int64_t id, Vector3 global_start, Vector3 global_end, float radius,
+						  unsigned char area, bool bidirectional, bool rebuild);
+
+	void remove_offmesh_link(int64_t id);
+
+	void index_offmesh_links();
+
+	void collect_offmesh_links(int x, int z, OffMeshTileData &data);
+
 	void recalculate_tiles();
 
 	void add_meshdata(
@@ -0,0 +1,232 @@
+#include <unordered_set>
+#include <unordered_map>
+#include "navmesh_islands.h"
+
+using namespace godot;
+
+void NavmeshIslands::clear()
+{
+	navmesh = nullptr;
+	tiles.clear();
+	next_label = 1;
+}
+
+/**
+ * Relabels polygons after tile changes. Changed tiles are found by comparing
+ * tile headers and salts, only islands that had polygons in them are flooded
+ * again, the rest of the navmesh keeps its labels.
+ * Has to be called while no other thread reads the labels.
+ */
+void NavmeshIslands::update(const dtNavMesh *nm)
+{
+	if (nm != navmesh)
+	{
+		clear();
+		navmesh = nm;
+	}
+	if (navmesh == nullptr)
+	{
+		return;
+	}
+
+	int max_tiles = navmesh->getMaxTiles();
+	tiles.resize(max_tiles);
+
+	std::unordered_set<unsigned int> affected;
+	bool changed = false;
+	for (int i = 0; i < max_tiles; i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		TileLabels &tile_labels = tiles[i];
+		if (tile_labels.header == tile->header && tile_labels.salt == tile->salt)
+		{
+			continue;
+		}
+		for (unsigned int label : tile_labels.labels)
+		{
+			affected.insert(label);
+		}
+		tile_labels.header = tile->header;
+		tile_labels.salt = tile->salt;
+		tile_labels.labels.assign(tile->header ? tile->header->polyCount : 0, 0);
+		changed = true;
+	}
+	if (!changed)
+	{
+		return;
+	}
+
+	/* Islands that touched a changed tile may have split, so they're labeled again */
+	if (!affected.empty())
+	{
+		for (TileLabels &tile_labels : tiles)
+		{
+			for (unsigned int &label : tile_labels.labels)
+			{
+				if (affected.count(label))
+				{
+					label = 0;
+				}
+			}
+		}
+	}
+
+	index_reverse_links();
+	for (int i = 0; i < max_tiles; i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; j++)
+		{
+			if (tiles[i].labels[j] == 0)
+			{
+				flood(base | (dtPolyRef)j, next_label++);
+			}
+		}
+	}
+	/* Only needed while flooding, replicas copy the labels */
+	reverse_links.clear();
+}
+
+/**
+ * Indexes off-mesh connections by the polygons they link to, the end of a
+ * one-way connection has no link back. Without following them backwards,
+ * a flood from that end would relabel an island the start belongs to too.
+ */
+void NavmeshIslands::index_reverse_links()
+{
+	reverse_links.clear();
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int j = tile->header->offMeshBase; j < tile->header->polyCount; j++)
+		{
+			const dtPoly *poly = &tile->polys[j];
+			if (poly->getType() != DT_POLYTYPE_OFFMESH_CONNECTION)
+			{
+				continue;
+			}
+			dtPolyRef connection = base | (dtPolyRef)j;
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				dtPolyRef end = tile->links[k].ref;
+				if (end)
+				{
+					reverse_links[end].push_back(connection);
+				}
+			}
+		}
+	}
+}
+
+/**
+ * Labels everything connected to start, following links both ways. Islands
+ * that were merged by the changed tiles are overwritten as the flood
+ * reaches them.
+ */
+void NavmeshIslands::flood(dtPolyRef start, unsigned int label)
+{
+	unsigned int salt, it, ip;
+	navmesh->decodePolyId(start, salt, it, ip);
+	tiles[it].labels[ip] = label;
+	stack.clear();
+	stack.push_back(start);
+
+	while (!stack.empty())
+	{
+		dtPolyRef ref = stack.back();
+		stack.pop_back();
+
+		const dtMeshTile *tile;
+		const dtPoly *poly;
+		navmesh->getTileAndPolyByRefUnsafe(ref, &tile, &poly);
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			visit(tile->links[k].ref, label);
+		}
+		std::unordered_map<dtPolyRef, std::vector<dtPolyRef>>::const_iterator reverse = reverse_links.find(ref);
+		if (reverse != reverse_links.end())
+		{
+			for (dtPolyRef connection : reverse->second)
+			{
+				visit(connection, label);
+			}
+		}
+	}
+}
+
+void NavmeshIslands::visit(dtPolyRef neighbour, unsigned int label)
+{
+	if (!neighbour)
+	{
+		return;
+	}
+	unsigned int salt, it, ip;
+	navmesh->decodePolyId(neighbour, salt, it, ip);
+	unsigned int &neighbour_label = tiles[it].labels[ip];
+	if (neighbour_label != label)
+	{
+		neighbour_label = label;
+		stack.push_back(neighbour);
+	}
+}
+
+unsigned int NavmeshIslands::get_island(dtPolyRef ref) const
+{
+	if (navmesh == nullptr || !ref)
+	{
+		return 0;
+	}
+	unsigned int salt, it, ip;
+	navmesh->decodePolyId(ref, salt, it, ip);
+	if (it >= tiles.size() || tiles[it].salt != salt || ip >= tiles[it].labels.size())
+	{
+		return 0;
+	}
+	return tiles[it].labels[ip];
+}
+
+/**
+ * @return false only if both polygons are labeled and on different islands
+ */
+bool NavmeshIslands::is_reachable(dtPolyRef from, dtPolyRef to) const
+{
+	unsigned int from_island = get_island(from);
+	unsigned int to_island = get_island(to);
+	return from_island == 0 || to_island == 0 || from_island == to_island;
+}
+
+dtPolyRef NavmeshIslands::get_largest_island_poly() const
+{
+	std::unordered_map<unsigned int, int> sizes;
+	dtPolyRef largest = 0;
+	int largest_size = 0;
+	for (int i = 0; i < (int)tiles.size(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (tiles[i].labels.empty() || tile->header != tiles[i].header)
+		{
+			continue;
+		}
+		dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int j = 0; j < (int)tiles[i].labels.size(); j++)
+		{
+			int size = ++sizes[tiles[i].labels[j]];
+			if (size > largest_size)
+			{
+				largest_size = size;
+				largest = base | (dtPolyRef)j;
+			}
+		}
+	}
+	return largest;
+}
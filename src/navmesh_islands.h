@@ -0,0 +1,50 @@
+#ifndef NAVMESH_ISLANDS_H
+#define NAVMESH_ISLANDS_H
+
+#include <vector>
+#include <unordered_map>
+#include "DetourNavMesh.h"
+
+namespace godot
+{
+
+/**
+ * Connected component (island) label for every polygon of a navmesh.
+ * Links are treated as undirected (one-way off-mesh links are followed
+ * back too) and query filters are ignored, so different labels always
+ * mean that no path exists.
+ */
+class NavmeshIslands
+{
+	struct TileLabels
+	{
+		const dtMeshHeader *header = nullptr;
+		unsigned int salt = 0;
+		std::vector<unsigned int> labels;
+	};
+
+	const dtNavMesh *navmesh = nullptr;
+	std::vector<TileLabels> tiles;
+	unsigned int next_label = 1;
+	std::vector<dtPolyRef> stack;
+	/* Off-mesh connections by the polygon of their one-way end, which has no link back */
+	std::unordered_map<dtPolyRef, std::vector<dtPolyRef>> reverse_links;
+
+	void index_reverse_links();
+
+	void flood(dtPolyRef start, unsigned int label);
+	void visit(dtPolyRef neighbour, unsigned int label);
+
+public:
+	void update(const dtNavMesh *nm);
+	void clear();
+
+	/* @return 0 if the polygon isn't labeled (yet) */
+	unsigned int get_island(dtPolyRef ref) const;
+	bool is_reachable(dtPolyRef from, dtPolyRef to) const;
+	/* @return any polygon of the island with most polygons */
+	dtPolyRef get_largest_island_poly() const;
+};
+
+} // namespace godot
+#endif
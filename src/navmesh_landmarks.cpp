@@ -0,0 +1,468 @@
+#include <queue>
+#include <functional>
+#include <algorithm>
+#include <cmath>
+#include <cfloat>
+#include "DetourCommon.h"
+#include "navmesh_landmarks.h"
+
+using namespace godot;
+
+static const int MAX_LANDMARKS = 32;
+static const int MAX_TILES_AT = 32;
+
+void NavmeshLandmarks::get_poly_center(const dtMeshTile *tile, const dtPoly *poly, float *center)
+{
+	center[0] = center[1] = center[2] = 0.f;
+	for (int i = 0; i < poly->vertCount; i++)
+	{
+		dtVadd(center, center, &tile->verts[poly->verts[i] * 3]);
+	}
+	dtVscale(center, center, 1.f / poly->vertCount);
+}
+
+void NavmeshLandmarks::clear()
+{
+	navmesh = nullptr;
+	landmarks.clear();
+	tiles.clear();
+	symmetric = true;
+}
+
+/**
+ * Picks landmarks with farthest point selection starting from the polygon
+ * farthest from seed, so they spread over the island of the seed.
+ * Called at bake time, the table is serialized with the navmesh.
+ */
+void NavmeshLandmarks::build(const dtNavMesh *nm, dtPolyRef seed, int landmark_count)
+{
+	clear();
+	navmesh = nm;
+	if (navmesh == nullptr || landmark_count <= 0 || !seed)
+	{
+		return;
+	}
+	landmarks.resize(std::min(landmark_count, MAX_LANDMARKS));
+	layout_tiles();
+
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		for (int j = 0; j < tile->header->offMeshConCount; j++)
+		{
+			if (!(tile->offMeshCons[j].flags & DT_OFFMESH_CON_BIDIR))
+			{
+				symmetric = false;
+			}
+		}
+	}
+
+	/* The first slot holds distances from the seed until the first landmark is picked */
+	landmarks[0].ref = seed;
+	compute(0);
+	int picked = 0;
+	while (picked < (int)landmarks.size())
+	{
+		dtPolyRef farthest = find_farthest(std::max(picked, 1));
+		if (!farthest)
+		{
+			break;
+		}
+		Landmark &landmark = landmarks[picked];
+		landmark.ref = farthest;
+		const dtMeshTile *tile;
+		const dtPoly *poly;
+		navmesh->getTileAndPolyByRefUnsafe(farthest, &tile, &poly);
+		get_poly_center(tile, poly, landmark.position);
+		compute(picked);
+		picked++;
+	}
+
+	if (picked == 0)
+	{
+		clear();
+		return;
+	}
+	if (picked < (int)landmarks.size())
+	{
+		repack(picked);
+	}
+}
+
+/**
+ * @return polygon with the largest distance to its nearest landmark,
+ * only the first slots are considered
+ */
+dtPolyRef NavmeshLandmarks::find_farthest(int slots) const
+{
+	dtPolyRef farthest = 0;
+	float farthest_distance = 0.f;
+	int stride = (int)landmarks.size();
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; j++)
+		{
+			const float *d = &tiles[i].distances[j * stride];
+			float nearest = d[0];
+			for (int k = 1; k < slots && nearest > 0.f; k++)
+			{
+				nearest = std::min(nearest, d[k]);
+			}
+			if (nearest > farthest_distance)
+			{
+				farthest_distance = nearest;
+				farthest = base | (dtPolyRef)j;
+			}
+		}
+	}
+	return farthest;
+}
+
+/* Shrinks the table stride when fewer landmarks than requested were found */
+void NavmeshLandmarks::repack(int count)
+{
+	int stride = (int)landmarks.size();
+	for (TileDistances &tile_distances : tiles)
+	{
+		int poly_count = (int)tile_distances.distances.size() / stride;
+		std::vector<float> packed(poly_count * count);
+		for (int j = 0; j < poly_count; j++)
+		{
+			std::copy_n(&tile_distances.distances[j * stride], count, &packed[j * count]);
+		}
+		tile_distances.distances.swap(packed);
+	}
+	landmarks.resize(count);
+}
+
+/**
+ * Resets the distances of tiles that changed since the last call
+ *
+ * @return indices of changed tiles
+ */
+std::vector<int> NavmeshLandmarks::layout_tiles()
+{
+	std::vector<int> changed;
+	int stride = (int)landmarks.size();
+	tiles.resize(navmesh->getMaxTiles());
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		TileDistances &tile_distances = tiles[i];
+		if (tile_distances.header == tile->header && tile_distances.salt == tile->salt)
+		{
+			continue;
+		}
+		tile_distances.header = tile->header;
+		tile_distances.salt = tile->salt;
+		tile_distances.distances.assign(tile->header ? tile->header->polyCount * stride : 0, UNREACHABLE);
+		changed.push_back(i);
+	}
+	return changed;
+}
+
+/**
+ * Recomputes the distances of a landmark in the table
+ */
+void NavmeshLandmarks::compute(int landmark)
+{
+	Refresh refresh;
+	refresh.landmark = landmark;
+	refresh.ref = landmarks[landmark].ref;
+	compute_distances(refresh);
+	store(refresh);
+}
+
+/**
+ * Dijkstra from the landmark polygon over polygon links. Only reads the
+ * navmesh and the table layout, the table itself isn't changed.
+ */
+void NavmeshLandmarks::compute_distances(Refresh &refresh) const
+{
+	int stride = (int)landmarks.size();
+	refresh.distances.resize(tiles.size());
+	for (size_t i = 0; i < tiles.size(); i++)
+	{
+		refresh.distances[i].assign(tiles[i].distances.size() / stride, UNREACHABLE);
+	}
+
+	float *start_distance = get_column_distance(refresh.distances, refresh.ref);
+	if (!start_distance)
+	{
+		return;
+	}
+
+	typedef std::pair<float, dtPolyRef> Entry;
+	std::priority_queue<Entry, std::vector<Entry>, std::greater<Entry>> open;
+	*start_distance = 0.f;
+	open.push(Entry(0.f, refresh.ref));
+	while (!open.empty())
+	{
+		Entry entry = open.top();
+		open.pop();
+		if (entry.first > *get_column_distance(refresh.distances, entry.second))
+		{
+			continue;
+		}
+
+		const dtMeshTile *tile;
+		const dtPoly *poly;
+		float center[3];
+		navmesh->getTileAndPolyByRefUnsafe(entry.second, &tile, &poly);
+		get_poly_center(tile, poly, center);
+		for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+		{
+			dtPolyRef neighbour = tile->links[k].ref;
+			float *neighbour_distance = neighbour ? get_column_distance(refresh.distances, neighbour) : nullptr;
+			if (!neighbour_distance)
+			{
+				continue;
+			}
+			const dtMeshTile *neighbour_tile;
+			const dtPoly *neighbour_poly;
+			float neighbour_center[3];
+			navmesh->getTileAndPolyByRefUnsafe(neighbour, &neighbour_tile, &neighbour_poly);
+			get_poly_center(neighbour_tile, neighbour_poly, neighbour_center);
+			float distance = entry.first + dtVdist(center, neighbour_center);
+			if (*neighbour_distance < 0.f || distance < *neighbour_distance)
+			{
+				*neighbour_distance = distance;
+				open.push(Entry(distance, neighbour));
+			}
+		}
+	}
+}
+
+/**
+ * Writes computed distances into the table, the landmark is up to date
+ * again. The tiles may not have changed since they were computed.
+ */
+void NavmeshLandmarks::store(const Refresh &refresh)
+{
+	int stride = (int)landmarks.size();
+	for (size_t i = 0; i < tiles.size() && i < refresh.distances.size(); i++)
+	{
+		std::vector<float> &distances = tiles[i].distances;
+		const std::vector<float> &column = refresh.distances[i];
+		for (size_t j = 0; j < column.size() && j * stride + refresh.landmark < distances.size(); j++)
+		{
+			distances[j * stride + refresh.landmark] = column[j];
+		}
+	}
+	landmarks[refresh.landmark].ref = refresh.ref;
+	landmarks[refresh.landmark].stale = false;
+}
+
+/**
+ * Marks landmarks stale after tile changes. A landmark is affected if it
+ * reached a changed tile before, or reaches one of the new polygons through
+ * an unchanged neighbour, its distances are ignored until it's refreshed.
+ * Has to be called while no other thread reads the table.
+ */
+void NavmeshLandmarks::update(const dtNavMesh *nm)
+{
+	if (nm != navmesh)
+	{
+		clear();
+		return;
+	}
+	if (navmesh == nullptr || landmarks.empty())
+	{
+		return;
+	}
+
+	int stride = (int)landmarks.size();
+	for (int i = 0; i < navmesh->getMaxTiles() && i < (int)tiles.size(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		TileDistances &tile_distances = tiles[i];
+		if (tile_distances.header == tile->header && tile_distances.salt == tile->salt)
+		{
+			continue;
+		}
+		for (size_t j = 0; j < tile_distances.distances.size(); j++)
+		{
+			if (tile_distances.distances[j] >= 0.f)
+			{
+				landmarks[j % stride].stale = true;
+			}
+		}
+	}
+
+	std::vector<int> changed = layout_tiles();
+	for (int i : changed)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (!tile->header)
+		{
+			continue;
+		}
+		for (int j = 0; j < tile->header->polyCount; j++)
+		{
+			const dtPoly *poly = &tile->polys[j];
+			for (unsigned int k = poly->firstLink; k != DT_NULL_LINK; k = tile->links[k].next)
+			{
+				const float *d = tile->links[k].ref ? get_distances(tile->links[k].ref) : nullptr;
+				for (int l = 0; d && l < stride; l++)
+				{
+					if (d[l] >= 0.f)
+					{
+						landmarks[l].stale = true;
+					}
+				}
+			}
+		}
+	}
+
+	for (Landmark &landmark : landmarks)
+	{
+		if (landmark.ref && !navmesh->isValidPolyRef(landmark.ref))
+		{
+			landmark.stale = true;
+		}
+	}
+}
+
+/**
+ * Computes the distances of the first stale landmark, landmarks whose
+ * polygon was removed are moved to the closest polygon. Doesn't change
+ * the table, so readers of it don't wait for the search; store the result
+ * before the next tile change. Meant to be called once per frame.
+ *
+ * @return false if no landmark is stale
+ */
+bool NavmeshLandmarks::compute_stale(Refresh &refresh) const
+{
+	for (int l = 0; l < (int)landmarks.size(); l++)
+	{
+		const Landmark &landmark = landmarks[l];
+		if (!landmark.stale)
+		{
+			continue;
+		}
+		refresh.landmark = l;
+		refresh.ref = landmark.ref;
+		if (!refresh.ref || !navmesh->isValidPolyRef(refresh.ref))
+		{
+			refresh.ref = find_poly_near(landmark.position);
+		}
+		compute_distances(refresh);
+		return true;
+	}
+	return false;
+}
+
+bool NavmeshLandmarks::has_stale() const
+{
+	return std::any_of(landmarks.begin(), landmarks.end(), [](const Landmark &landmark) { return landmark.stale; });
+}
+
+dtPolyRef NavmeshLandmarks::find_poly_near(const float *position) const
+{
+	dtPolyRef nearest = 0;
+	float nearest_distance = FLT_MAX;
+	auto check_tile = [&](const dtMeshTile *tile) {
+		dtPolyRef base = navmesh->getPolyRefBase(tile);
+		for (int j = 0; j < tile->header->polyCount; j++)
+		{
+			float center[3];
+			get_poly_center(tile, &tile->polys[j], center);
+			float distance = dtVdistSqr(center, position);
+			if (distance < nearest_distance)
+			{
+				nearest_distance = distance;
+				nearest = base | (dtPolyRef)j;
+			}
+		}
+	};
+
+	int tx, ty;
+	navmesh->calcTileLoc(position, &tx, &ty);
+	const dtMeshTile *tiles_at[MAX_TILES_AT];
+	int count = navmesh->getTilesAt(tx, ty, tiles_at, MAX_TILES_AT);
+	for (int i = 0; i < count; i++)
+	{
+		check_tile(tiles_at[i]);
+	}
+	if (nearest)
+	{
+		return nearest;
+	}
+	for (int i = 0; i < navmesh->getMaxTiles(); i++)
+	{
+		const dtMeshTile *tile = navmesh->getTile(i);
+		if (tile->header)
+		{
+			check_tile(tile);
+		}
+	}
+	return nearest;
+}
+
+float *NavmeshLandmarks::get_column_distance(std::vector<std::vector<float>> &column, dtPolyRef ref) const
+{
+	unsigned int salt, it, ip;
+	navmesh->decodePolyId(ref, salt, it, ip);
+	if (it >= tiles.size() || it >= column.size() || tiles[it].salt != salt || ip >= column[it].size())
+	{
+		return nullptr;
+	}
+	return &column[it][ip];
+}
+
+const float *NavmeshLandmarks::get_distances(dtPolyRef ref) const
+{
+	if (!ref)
+	{
+		return nullptr;
+	}
+	unsigned int salt, it, ip;
+	navmesh->decodePolyId(ref, salt, it, ip);
+	if (it >= tiles.size() || tiles[it].salt != salt)
+	{
+		return nullptr;
+	}
+	const TileDistances &tile_distances = tiles[it];
+	size_t stride = landmarks.size();
+	if ((ip + 1) * stride > tile_distances.distances.size())
+	{
+		return nullptr;
+	}
+	return &tile_distances.distances[ip * stride];
+}
+
+/**
+ * ALT lower bound of the path cost between two polygons, 0 if no
+ * up to date landmark reaches both of them
+ */
+float NavmeshLandmarks::get_lower_bound(dtPolyRef from, dtPolyRef to) const
+{
+	const float *from_distances = get_distances(from);
+	const float *to_distances = get_distances(to);
+	if (!from_distances || !to_distances)
+	{
+		return 0.f;
+	}
+	float bound = 0.f;
+	for (int l = 0; l < (int)landmarks.size(); l++)
+	{
+		if (landmarks[l].stale || !landmarks[l].ref || from_distances[l] < 0.f || to_distances[l] < 0.f)
+		{
+			continue;
+		}
+		/* d(L, to) <= d(L, from) + d(from, to), the reverse needs symmetric links */
+		float difference = to_distances[l] - from_distances[l];
+		bound = std::max(bound, symmetric ? std::fabs(difference) : difference);
+	}
+	return bound;
+}
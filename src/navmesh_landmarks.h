@@ -0,0 +1,77 @@
+#ifndef NAVMESH_LANDMARKS_H
+#define NAVMESH_LANDMARKS_H
+
+#include <vector>
+#include "DetourNavMesh.h"
+
+namespace godot
+{
+
+/**
+ * Distances from a few landmark polygons to every polygon, used for ALT
+ * (A*, landmarks, triangle inequality) lower bounds in path queries.
+ * Distances are measured between polygon centers, the same way the
+ * landmark path search measures its costs.
+ */
+class NavmeshLandmarks
+{
+	friend class Serializer;
+
+	struct Landmark
+	{
+		dtPolyRef ref = 0;
+		float position[3];
+		bool stale = false;
+	};
+
+	struct TileDistances
+	{
+		const dtMeshHeader *header = nullptr;
+		unsigned int salt = 0;
+		/* polyCount * landmark count, landmark index changes fastest */
+		std::vector<float> distances;
+	};
+
+	const dtNavMesh *navmesh = nullptr;
+	std::vector<Landmark> landmarks;
+	std::vector<TileDistances> tiles;
+	/* One way off-mesh links only allow the forward bound */
+	bool symmetric = true;
+
+	std::vector<int> layout_tiles();
+	dtPolyRef find_farthest(int slots) const;
+	void repack(int count);
+	void compute(int landmark);
+	float *get_column_distance(std::vector<std::vector<float>> &column, dtPolyRef ref) const;
+	dtPolyRef find_poly_near(const float *position) const;
+	const float *get_distances(dtPolyRef ref) const;
+
+public:
+	/* Distance value of polygons the landmark can't reach */
+	static constexpr float UNREACHABLE = -1.f;
+
+	/* Distances of one landmark per tile and polygon, computed apart from the table */
+	struct Refresh
+	{
+		int landmark = -1;
+		dtPolyRef ref = 0;
+		std::vector<std::vector<float>> distances;
+	};
+
+	static void get_poly_center(const dtMeshTile *tile, const dtPoly *poly, float *center);
+
+	void build(const dtNavMesh *nm, dtPolyRef seed, int landmark_count);
+	void update(const dtNavMesh *nm);
+	bool compute_stale(Refresh &refresh) const;
+	void compute_distances(Refresh &refresh) const;
+	void store(const Refresh &refresh);
+	bool has_stale() const;
+	void clear();
+
+	bool is_empty() const { return landmarks.empty(); }
+	int get_landmark_count() const { return static_cast<int>(landmarks.size()); }
+	float get_lower_bound(dtPolyRef from, dtPolyRef to) const;
+};
+
+} // namespace godot
+#endif
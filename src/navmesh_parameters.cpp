@@ -1,3 +1,5 @@
+#include <algorithm>
+#include "Recast.h"
 #include "navmesh_parameters.h"
 
 static const int DEFAULT_TILE_SIZE = 64;
@@ -15,10 +17,21 @@ static const float DEFAULT_DETAIL_SAMPLE_DISTANCE = 6.0f;
 static const float DEFAULT_DETAIL_SAMPLE_MAX_ERROR = 1.0f;
 
 static const int DEFAULT_MAX_OBSTACLES = 1000;
+/* FastLZ level 1, what tile caches used before the codec was selectable */
+static const int DEFAULT_TILE_COMPRESSION = 1;
 static const int DEFAULT_MAX_LAYERS = 8;
+static const int DEFAULT_LANDMARK_COUNT = 0;
+static const int DEFAULT_QUERY_MAX_NODES = 2048;
+static const int DEFAULT_MAX_PATH_POLYS = 256;
+static const int DEFAULT_MAX_PATH_POINTS = 256;
+static const unsigned short DEFAULT_AREA_FLAGS = 0x1;
+/* Areas 1 - 62, 63 is Recast's default walkable area */
+static const int MAX_AREA_TYPES = RC_WALKABLE_AREA - 1;
 
 using namespace godot;
 
+static const Vector3 DEFAULT_MAX_SEARCH_EXTENTS = Vector3(50.f, 50.f, 50.f);
+
 void NavmeshParameters::_register_methods()
 {
 	register_property<NavmeshParameters, real_t>("cell_size", &NavmeshParameters::set_cell_size, &NavmeshParameters::get_cell_size, DEFAULT_CELL_SIZE);
@@ -39,6 +52,13 @@ void NavmeshParameters::_register_methods()
 	register_property<NavmeshParameters, real_t>("detail_sample_max_error", &NavmeshParameters::set_detail_sample_max_error, &NavmeshParameters::get_detail_sample_max_error, DEFAULT_DETAIL_SAMPLE_MAX_ERROR);
 	// register_property<NavmeshParameters, Vector3>("padding", &NavmeshParameters::set_padding, &NavmeshParameters::get_padding, Vector3(1.0f, 1.0f, 1.0f));
 	register_property<NavmeshParameters, int>("max_layers", &NavmeshParameters::set_max_layers, &NavmeshParameters::get_max_layers, DEFAULT_MAX_LAYERS);
+	register_property<NavmeshParameters, Vector3>("max_search_extents", &NavmeshParameters::set_max_search_extents, &NavmeshParameters::get_max_search_extents, DEFAULT_MAX_SEARCH_EXTENTS);
+	register_property<NavmeshParameters, int>("landmark_count", &NavmeshParameters::set_landmark_count, &NavmeshParameters::get_landmark_count, DEFAULT_LANDMARK_COUNT);
+	register_property<NavmeshParameters, int>("query_max_nodes", &NavmeshParameters::set_query_max_nodes, &NavmeshParameters::get_query_max_nodes, DEFAULT_QUERY_MAX_NODES);
+	register_property<NavmeshParameters, int>("max_path_polys", &NavmeshParameters::set_max_path_polys, &NavmeshParameters::get_max_path_polys, DEFAULT_MAX_PATH_POLYS);
+	register_property<NavmeshParameters, int>("max_path_points", &NavmeshParameters::set_max_path_points, &NavmeshParameters::get_max_path_points, DEFAULT_MAX_PATH_POINTS);
+	register_property<NavmeshParameters, PoolIntArray>("area_layers", &NavmeshParameters::set_area_layers, &NavmeshParameters::get_area_layers, PoolIntArray());
+	register_property<NavmeshParameters, PoolIntArray>("area_flags", &NavmeshParameters::set_area_flags, &NavmeshParameters::get_area_flags, PoolIntArray());
 }
 
 NavmeshParameters::NavmeshParameters()
@@ -70,12 +90,43 @@ void NavmeshParameters::_init()
 	detail_sample_max_error = DEFAULT_DETAIL_SAMPLE_MAX_ERROR;
 	padding = Vector3(1.f, 1.f, 1.f);
 	max_layers = DEFAULT_MAX_LAYERS;
+	max_search_extents = DEFAULT_MAX_SEARCH_EXTENTS;
+	landmark_count = DEFAULT_LANDMARK_COUNT;
+	query_max_nodes = DEFAULT_QUERY_MAX_NODES;
+	max_path_polys = DEFAULT_MAX_PATH_POLYS;
+	max_path_points = DEFAULT_MAX_PATH_POINTS;
 }
 
 void NavmeshParameters::_ready()
 {
 }
 
+/**
+ * @return the first area whose layers overlap the body layers,
+ * the default walkable area if none does
+ */
+unsigned char NavmeshParameters::get_area_for_layer(int layer)
+{
+	int count = std::min(area_layers.size(), MAX_AREA_TYPES);
+	for (int i = 0; i < count && layer != 0; i++)
+	{
+		if (area_layers[i] & layer)
+		{
+			return (unsigned char)(i + 1);
+		}
+	}
+	return RC_WALKABLE_AREA;
+}
+
+unsigned short NavmeshParameters::get_flags_for_area(unsigned char area)
+{
+	if (area >= 1 && area <= area_flags.size())
+	{
+		return (unsigned short)area_flags[area - 1];
+	}
+	return DEFAULT_AREA_FLAGS;
+}
+
 NavmeshParameters::~NavmeshParameters()
 {
 }
@@ -92,6 +143,7 @@ void CachedNavmeshParameters::_init()
 {
 	NavmeshParameters::_init();
 	max_obstacles = DEFAULT_MAX_OBSTACLES;
+	tile_compression = DEFAULT_TILE_COMPRESSION;
 	max_layers = DEFAULT_MAX_LAYERS;
 }
 
@@ -120,5 +172,14 @@ void CachedNavmeshParameters::_register_methods()
 	// register_property<CachedNavmeshParameters, Vector3>("padding", &NavmeshParameters::set_padding, &NavmeshParameters::get_padding, Vector3(1.0f, 1.0f, 1.0f));
 
 	register_property<CachedNavmeshParameters, int>("max_obstacles", &CachedNavmeshParameters::set_max_obstacles, &CachedNavmeshParameters::get_max_obstacles, DEFAULT_MAX_OBSTACLES);
+	register_property<CachedNavmeshParameters, int>("tile_compression", &CachedNavmeshParameters::set_tile_compression, &CachedNavmeshParameters::get_tile_compression, DEFAULT_TILE_COMPRESSION,
+													GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_DEFAULT, GODOT_PROPERTY_HINT_ENUM, "Uncompressed,Fast,Small");
 	register_property<CachedNavmeshParameters, int>("max_layers", &CachedNavmeshParameters::set_max_layers, &CachedNavmeshParameters::get_max_layers, DEFAULT_MAX_LAYERS);
+	register_property<CachedNavmeshParameters, Vector3>("max_search_extents", &CachedNavmeshParameters::set_max_search_extents, &CachedNavmeshParameters::get_max_search_extents, DEFAULT_MAX_SEARCH_EXTENTS);
+	register_property<CachedNavmeshParameters, int>("landmark_count", &CachedNavmeshParameters::set_landmark_count, &CachedNavmeshParameters::get_landmark_count, DEFAULT_LANDMARK_COUNT);
+	register_property<CachedNavmeshParameters, int>("query_max_nodes", &CachedNavmeshParameters::set_query_max_nodes, &CachedNavmeshParameters::get_query_max_nodes, DEFAULT_QUERY_MAX_NODES);
+	register_property<CachedNavmeshParameters, int>("max_path_polys", &CachedNavmeshParameters::set_max_path_polys, &CachedNavmeshParameters::get_max_path_polys, DEFAULT_MAX_PATH_POLYS);
+	register_property<CachedNavmeshParameters, int>("max_path_points", &CachedNavmeshParameters::set_max_path_points, &CachedNavmeshParameters::get_max_path_points, DEFAULT_MAX_PATH_POINTS);
+	register_property<CachedNavmeshParameters, PoolIntArray>("area_layers", &CachedNavmeshParameters::set_area_layers, &CachedNavmeshParameters::get_area_layers, PoolIntArray());
+	register_property<CachedNavmeshParameters, PoolIntArray>("area_flags", &CachedNavmeshParameters::set_area_flags, &CachedNavmeshParameters::get_area_flags, PoolIntArray());
 }
\ No newline at end of file
@@ -37,12 +37,31 @@ public:
 	SETGET(detail_sample_max_error, float);
 	SETGET(padding, Vector3);
 	SETGET(max_layers, int);
+	SETGET(max_search_extents, Vector3);
+	/* Each landmark costs 4 bytes per polygon, and a search over the whole navmesh per frame while tile changes leave it stale */
+	SETGET(landmark_count, int);
+	SETGET(query_max_nodes, int);
+	SETGET(max_path_polys, int);
+	SETGET(max_path_points, int);
+	/* Area i + 1 is given to bodies in layers area_layers[i], its polygons get flags area_flags[i] */
+	SETGET(area_layers, PoolIntArray);
+	SETGET(area_flags, PoolIntArray);
+
+	unsigned char get_area_for_layer(int layer);
+	unsigned short get_flags_for_area(unsigned char area);
 
 	inline real_t get_tile_edge_length()
 	{
 		return (real_t)(get_tile_size() * get_cell_size());
 	};
 
+	/* Half extents the nearest polygon search starts with, sized to the agent */
+	inline Vector3 get_search_extents()
+	{
+		real_t horizontal = get_agent_radius() + get_cell_size();
+		return Vector3(horizontal, get_agent_height(), horizontal);
+	};
+
 	enum partition_t
 	{
 		PARTITION_WATERSHED,
@@ -65,6 +84,8 @@ public:
 	static void _register_methods();
 
 	SETGET(max_obstacles, int);
+	/* TileCacheCompression of the layers, a baked tile cache keeps the codec it was baked with */
+	SETGET(tile_compression, int);
 };
 } // namespace godot
 
@@ -0,0 +1,169 @@
+#include <cstring>
+#include <vector>
+#include "DetourAlloc.h"
+#include "navmesh_replicas.h"
+
+using namespace godot;
+
+NavmeshReplicas::~NavmeshReplicas()
+{
+	clear();
+}
+
+/**
+ * Pins the published replica. The published index is checked again after
+ * registering as a reader, so the writer never changes a replica that a
+ * reader has started on.
+ *
+ * @return nullptr if nothing was published yet
+ */
+NavmeshReplicas::Replica *NavmeshReplicas::acquire()
+{
+	while (true)
+	{
+		int index = published.load();
+		if (index < 0)
+		{
+			return nullptr;
+		}
+		Replica &replica = replicas[index];
+		replica.readers.fetch_add(1);
+		if (published.load() == index)
+		{
+			return &replica;
+		}
+		replica.readers.fetch_sub(1);
+	}
+}
+
+void NavmeshReplicas::release(Replica *replica)
+{
+	if (replica != nullptr)
+	{
+		replica->readers.fetch_sub(1);
+	}
+}
+
+/**
+ * Brings the replica that isn't published up to date with the source
+ * navmesh and publishes it. If readers of an older epoch still use that
+ * replica, nothing is changed and publishing is retried on the next call.
+ *
+ * @return true if the replicas are up to date
+ */
+bool NavmeshReplicas::publish(const dtNavMesh *source, const NavmeshIslands &islands, const NavmeshLandmarks &landmarks)
+{
+	if (source != copied_from)
+	{
+		if (replicas[0].readers.load() > 0 || replicas[1].readers.load() > 0)
+		{
+			return false;
+		}
+		clear();
+		copied_from = source;
+	}
+	if (!dirty || source == nullptr)
+	{
+		return !dirty;
+	}
+	int current = published.load();
+	int next = current < 0 ? 0 : 1 - current;
+	Replica &replica = replicas[next];
+	if (replica.readers.load() > 0)
+	{
+		return false;
+	}
+	if (!sync(replica, source))
+	{
+		return false;
+	}
+	replica.islands = islands;
+	replica.landmarks = landmarks;
+	replica.epoch = epoch.fetch_add(1) + 1;
+	published.store(next);
+	dirty = false;
+	return true;
+}
+
+/**
+ * Copies tiles that differ from the source. Tiles are added with the
+ * source tile ref, so polygon refs are the same in all copies.
+ */
+bool NavmeshReplicas::sync(Replica &replica, const dtNavMesh *source)
+{
+	if (replica.navmesh == nullptr)
+	{
+		replica.navmesh = dtAllocNavMesh();
+		if (replica.navmesh == nullptr || dtStatusFailed(replica.navmesh->init(source->getParams())))
+		{
+			dtFreeNavMesh(replica.navmesh);
+			replica.navmesh = nullptr;
+			return false;
+		}
+	}
+
+	dtNavMesh *target = replica.navmesh;
+	std::vector<int> changed;
+	for (int i = 0; i < source->getMaxTiles(); i++)
+	{
+		const dtMeshTile *source_tile = source->getTile(i);
+		const dtMeshTile *target_tile = target->getTile(i);
+		bool source_used = source_tile->header != nullptr;
+		bool target_used = target_tile->header != nullptr;
+		if (source_used != target_used || (source_used && source_tile->salt != target_tile->salt))
+		{
+			changed.push_back(i);
+		}
+	}
+
+	/* Removed first, a rebuilt tile can come back at another index */
+	for (int i : changed)
+	{
+		const dtMeshTile *target_tile = target->getTile(i);
+		if (target_tile->header != nullptr)
+		{
+			target->removeTile(target->getTileRef(target_tile), nullptr, nullptr);
+		}
+	}
+	for (int i : changed)
+	{
+		const dtMeshTile *source_tile = source->getTile(i);
+		if (source_tile->header == nullptr)
+		{
+			continue;
+		}
+		unsigned char *data = (unsigned char *)dtAlloc(source_tile->dataSize, DT_ALLOC_PERM);
+		if (!data)
+		{
+			return false;
+		}
+		memcpy(data, source_tile->data, source_tile->dataSize);
+		dtStatus status = target->addTile(data, source_tile->dataSize, DT_TILE_FREE_DATA, source->getTileRef(source_tile), nullptr);
+		if (dtStatusFailed(status))
+		{
+			dtFree(data);
+		}
+	}
+	return true;
+}
+
+/**
+ * Frees both replicas, no reader may be running
+ */
+void NavmeshReplicas::clear()
+{
+	published.store(-1);
+	for (Replica &replica : replicas)
+	{
+		if (replica.navmesh != nullptr)
+		{
+			dtFreeNavMesh(replica.navmesh);
+			replica.navmesh = nullptr;
+		}
+		replica.islands.clear();
+		replica.landmarks.clear();
+		replica.epoch = 0;
+	}
+	copied_from = nullptr;
+	dirty = true;
+}
@@ -0,0 +1,56 @@
+#ifndef NAVMESH_REPLICAS_H
+#define NAVMESH_REPLICAS_H
+
+#include <atomic>
+#include <cstdint>
+#include "DetourNavMesh.h"
+#include "navmesh_islands.h"
+#include "navmesh_landmarks.h"
+
+namespace godot
+{
+
+/**
+ * Two read-only copies of a navmesh for worker threads. The main thread
+ * keeps changing its own navmesh, changed tiles are copied to the replica
+ * nobody reads and it's published with a new epoch. A replica is only
+ * changed again (and its old tiles freed) once all readers that pinned
+ * it have finished, so readers never wait for navmesh maintenance.
+ */
+class NavmeshReplicas
+{
+public:
+	struct Replica
+	{
+		dtNavMesh *navmesh = nullptr;
+		NavmeshIslands islands;
+		NavmeshLandmarks landmarks;
+		std::atomic<int> readers{0};
+		uint64_t epoch = 0;
+	};
+
+	~NavmeshReplicas();
+
+	/* Reader side, any thread */
+	Replica *acquire();
+	void release(Replica *replica);
+
+	/* Writer side, main thread */
+	void mark_dirty() { dirty = true; }
+	bool publish(const dtNavMesh *source, const NavmeshIslands &islands, const NavmeshLandmarks &landmarks);
+	void clear();
+	uint64_t get_epoch() const { return epoch.load(); }
+
+private:
+	Replica replicas[2];
+	std::atomic<int> published{-1};
+	std::atomic<uint64_t> epoch{0};
+	bool dirty = true;
+	/* Navmesh the replicas were copied from, a new one starts over */
+	const dtNavMesh *copied_from = nullptr;
+
+	bool sync(Replica &replica, const dtNavMesh *source);
+};
+
+} // namespace godot
+#endif
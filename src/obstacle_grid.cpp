@@ -0,0 +1,69 @@
+#include <algorithm>
+#include "obstacle_grid.h"
+
+using namespace godot;
+
+void ObstacleGrid::init(int tiles_x, int tiles_z)
+{
+	width = std::max(tiles_x, 0);
+	height = std::max(tiles_z, 0);
+	cells.assign(width * height, std::vector<int64_t>());
+	ranges.clear();
+}
+
+void ObstacleGrid::clear()
+{
+	init(0, 0);
+}
+
+void ObstacleGrid::insert(int64_t owner, int min_x, int min_z, int max_x, int max_z)
+{
+	remove(owner);
+	Range range;
+	range.min_x = std::max(min_x, 0);
+	range.min_z = std::max(min_z, 0);
+	range.max_x = std::min(max_x, width);
+	range.max_z = std::min(max_z, height);
+	for (int x = range.min_x; x < range.max_x; x++)
+	{
+		for (int z = range.min_z; z < range.max_z; z++)
+		{
+			cells[z * width + x].push_back(owner);
+		}
+	}
+	ranges[owner] = range;
+}
+
+void ObstacleGrid::remove(int64_t owner)
+{
+	auto found = ranges.find(owner);
+	if (found == ranges.end())
+	{
+		return;
+	}
+	const Range &range = found->second;
+	for (int x = range.min_x; x < range.max_x; x++)
+	{
+		for (int z = range.min_z; z < range.max_z; z++)
+		{
+			std::vector<int64_t> &cell = cells[z * width + x];
+			auto it = std::find(cell.begin(), cell.end(), owner);
+			if (it != cell.end())
+			{
+				*it = cell.back();
+				cell.pop_back();
+			}
+		}
+	}
+	ranges.erase(found);
+}
+
+void ObstacleGrid::collect(int x, int z, std::vector<int64_t> &owners) const
+{
+	if (x < 0 || z < 0 || x >= width || z >= height)
+	{
+		return;
+	}
+	const std::vector<int64_t> &cell = cells[z * width + x];
+	owners.insert(owners.end(), cell.begin(), cell.end());
+}
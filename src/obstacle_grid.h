@@ -0,0 +1,44 @@
+#ifndef OBSTACLE_GRID_H
+#define OBSTACLE_GRID_H
+
+#include <cstdint>
+#include <vector>
+#include <unordered_map>
+
+namespace godot
+{
+
+/**
+ * Obstacle owners per navmesh tile, so the obstacles a rebuilt tile has
+ * to get back are found without asking the physics server. An owner is
+ * listed in every tile its obstacle bounds overlap.
+ */
+class ObstacleGrid
+{
+public:
+	void init(int tiles_x, int tiles_z);
+	void clear();
+	bool is_sized(int tiles_x, int tiles_z) const { return tiles_x == width && tiles_z == height; }
+
+	/* Replaces the tiles of the owner, max_x and max_z are excluding */
+	void insert(int64_t owner, int min_x, int min_z, int max_x, int max_z);
+	void remove(int64_t owner);
+	/* Appends the owners listed in the tile, an owner can be appended again for other tiles */
+	void collect(int x, int z, std::vector<int64_t> &owners) const;
+
+	int get_count() const { return static_cast<int>(ranges.size()); }
+
+private:
+	struct Range
+	{
+		int min_x, min_z, max_x, max_z;
+	};
+
+	int width = 0;
+	int height = 0;
+	std::vector<std::vector<int64_t>> cells;
+	std::unordered_map<int64_t, Range> ranges;
+};
+
+} // namespace godot
+#endif
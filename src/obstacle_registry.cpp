@@ -0,0 +1,170 @@
+#include <algorithm>
+#include "obstacle_registry.h"
+
+using namespace godot;
+
+static inline size_t hash_owner(int64_t owner)
+{
+	uint64_t h = (uint64_t)owner;
+	h ^= h >> 33;
+	h *= 0xff51afd7ed558ccdULL;
+	h ^= h >> 33;
+	return (size_t)h;
+}
+
+int ObstacleRegistry::find_slot(int64_t owner) const
+{
+	if (slots.empty())
+	{
+		return -1;
+	}
+	size_t mask = slots.size() - 1;
+	for (size_t i = hash_owner(owner) & mask;; i = (i + 1) & mask)
+	{
+		int index = slots[i];
+		if (index == EMPTY)
+		{
+			return -1;
+		}
+		if (index != DELETED && entries[index].owner == owner)
+		{
+			return (int)i;
+		}
+	}
+}
+
+ObstacleRegistry::Entry *ObstacleRegistry::find(int64_t owner)
+{
+	int slot = find_slot(owner);
+	return slot < 0 ? nullptr : &entries[slots[slot]];
+}
+
+/**
+ * @return the existing entry of the owner or a new one without obstacles
+ */
+ObstacleRegistry::Entry &ObstacleRegistry::insert(int64_t owner)
+{
+	int slot = find_slot(owner);
+	if (slot >= 0)
+	{
+		return entries[slots[slot]];
+	}
+	/* Deleted slots count as used, so probing always finds an empty one */
+	if ((used_slots + 1) * 4 > (int)slots.size() * 3)
+	{
+		rehash(std::max(16, (int)slots.size() * ((int)entries.size() * 2 >= (int)slots.size() ? 2 : 1)));
+	}
+	size_t mask = slots.size() - 1;
+	size_t i = hash_owner(owner) & mask;
+	while (slots[i] >= 0)
+	{
+		i = (i + 1) & mask;
+	}
+	if (slots[i] == EMPTY)
+	{
+		used_slots++;
+	}
+	slots[i] = (int)entries.size();
+	entries.emplace_back();
+	entries.back().owner = owner;
+	return entries.back();
+}
+
+/**
+ * Moves the last entry into the hole, so entries stay dense
+ */
+bool ObstacleRegistry::erase(int64_t owner)
+{
+	int slot = find_slot(owner);
+	if (slot < 0)
+	{
+		return false;
+	}
+	int index = slots[slot];
+	slots[slot] = DELETED;
+	int last = (int)entries.size() - 1;
+	if (index != last)
+	{
+		slots[find_slot(entries[last].owner)] = index;
+		entries[index] = entries[last];
+	}
+	entries.pop_back();
+	return true;
+}
+
+/**
+ * Forgets all obstacles, the journal starts over so navmeshes compare
+ * everything they placed on their next update
+ */
+void ObstacleRegistry::clear()
+{
+	entries.clear();
+	slots.clear();
+	used_slots = 0;
+	changes.clear();
+	trimmed = ++serial;
+}
+
+void ObstacleRegistry::mark_changed(int64_t owner)
+{
+	Change change;
+	change.serial = ++serial;
+	change.owner = owner;
+	changes.push_back(change);
+}
+
+/**
+ * Owners changed after since, an owner changed twice is listed twice
+ *
+ * @return false if those changes were trimmed, the caller has to compare all obstacles
+ */
+bool ObstacleRegistry::get_changes(uint64_t since, std::vector<int64_t> &owners) const
+{
+	if (since < trimmed)
+	{
+		return false;
+	}
+	std::vector<Change>::const_iterator first = std::upper_bound(changes.begin(), changes.end(), since,
+																  [](uint64_t value, const Change &change) { return value < change.serial; });
+	for (std::vector<Change>::const_iterator it = first; it != changes.end(); ++it)
+	{
+		owners.push_back(it->owner);
+	}
+	return true;
+}
+
+/**
+ * Drops changes every navmesh has applied
+ */
+void ObstacleRegistry::trim(uint64_t applied)
+{
+	if (applied <= trimmed)
+	{
+		return;
+	}
+	std::vector<Change>::iterator last = std::upper_bound(changes.begin(), changes.end(), applied,
+														  [](uint64_t value, const Change &change) { return value < change.serial; });
+	changes.erase(changes.begin(), last);
+	trimmed = applied;
+}
+
+void ObstacleRegistry::rehash(int capacity)
+{
+	slots.assign(capacity, EMPTY);
+	size_t mask = slots.size() - 1;
+	for (int index = 0; index < (int)entries.size(); index++)
+	{
+		size_t i = hash_owner(entries[index].owner) & mask;
+		while (slots[i] != EMPTY)
+		{
+			i = (i + 1) & mask;
+		}
+		slots[i] = index;
+	}
+	used_slots = (int)entries.size();
+}
+
+size_t ObstacleRegistry::get_memory_usage() const
+{
+	return entries.capacity() * sizeof(Entry) + slots.capacity() * sizeof(int) + changes.capacity() * sizeof(Change);
+}
@@ -0,0 +1,79 @@
+#ifndef OBSTACLE_REGISTRY_H
+#define OBSTACLE_REGISTRY_H
+
+#include <cstdint>
+#include <vector>
+#include <Godot.hpp>
+#include <CollisionShape.hpp>
+#include "tilecache_navmesh.h"
+
+namespace godot
+{
+
+/**
+ * Obstacles of collision shapes, described once for all cached navmeshes.
+ * Entries are stored densely and found through an open addressing table
+ * keyed by the shape's instance id. Every change is journaled with a
+ * serial, each cached navmesh catches up from the serial it last applied
+ * and keeps the refs of its own tile cache obstacles. Pointers returned
+ * by find are only valid until the next insert or erase.
+ */
+class ObstacleRegistry
+{
+public:
+	struct Entry
+	{
+		/* Instance id of the collision shape, check it still resolves before using the pointer */
+		int64_t owner = 0;
+		CollisionShape *collision_shape = nullptr;
+		int collision_layer = 0;
+		/* Where the obstacle was placed last, compared when tracking moving bodies */
+		Vector3 position;
+		float rotation = 0.f;
+		double last_update = 0.0;
+		bool tracked = false;
+		/* The obstacle as the navmeshes should have it, ref and owner aren't used */
+		DetourNavigationMeshCached::ObstacleRequest obstacle;
+	};
+
+	Entry *find(int64_t owner);
+	Entry &insert(int64_t owner);
+	bool erase(int64_t owner);
+	void clear();
+
+	/* Journals a new, changed or erased obstacle */
+	void mark_changed(int64_t owner);
+	uint64_t get_serial() const { return serial; }
+	bool get_changes(uint64_t since, std::vector<int64_t> &owners) const;
+	void trim(uint64_t applied);
+
+	std::vector<Entry> &get_entries() { return entries; }
+	int get_count() const { return static_cast<int>(entries.size()); }
+	int get_pending_changes() const { return static_cast<int>(changes.size()); }
+	size_t get_memory_usage() const;
+
+private:
+	static const int EMPTY = -1;
+	static const int DELETED = -2;
+
+	struct Change
+	{
+		uint64_t serial;
+		int64_t owner;
+	};
+
+	std::vector<Entry> entries;
+	/* Entry index per slot, the size is a power of two */
+	std::vector<int> slots;
+	int used_slots = 0;
+	/* Changes after trimmed, in serial order */
+	std::vector<Change> changes;
+	uint64_t serial = 0;
+	uint64_t trimmed = 0;
+
+	int find_slot(int64_t owner) const;
+	void rehash(int capacity);
+};
+
+} // namespace godot
+#endif
@@ -0,0 +1,140 @@
+#include <algorithm>
+#include "offmesh_link.h"
+#include "navigation.h"
+
+using namespace godot;
+
+static const Vector3 DEFAULT_END = Vector3(0.f, 0.f, 2.f);
+static const float DEFAULT_RADIUS = 0.5f;
+
+void DetourOffMeshLink::_register_methods()
+{
+	register_method("_notification", &DetourOffMeshLink::_notification);
+	register_method("get_global_start", &DetourOffMeshLink::get_global_start);
+	register_method("get_global_end", &DetourOffMeshLink::get_global_end);
+
+	register_property<DetourOffMeshLink, Vector3>("end", &DetourOffMeshLink::set_end, &DetourOffMeshLink::get_end, DEFAULT_END);
+	register_property<DetourOffMeshLink, float>("radius", &DetourOffMeshLink::set_radius, &DetourOffMeshLink::get_radius, DEFAULT_RADIUS);
+	register_property<DetourOffMeshLink, bool>("bidirectional", &DetourOffMeshLink::set_bidirectional, &DetourOffMeshLink::get_bidirectional, true);
+	register_property<DetourOffMeshLink, int>("area", &DetourOffMeshLink::set_area, &DetourOffMeshLink::get_area, RC_WALKABLE_AREA);
+}
+
+DetourOffMeshLink::DetourOffMeshLink()
+{
+}
+
+DetourOffMeshLink::~DetourOffMeshLink()
+{
+}
+
+void DetourOffMeshLink::_init()
+{
+	end = DEFAULT_END;
+	radius = DEFAULT_RADIUS;
+	bidirectional = true;
+	area = RC_WALKABLE_AREA;
+	set_notify_transform(true);
+}
+
+void DetourOffMeshLink::_notification(int p_what)
+{
+	switch (p_what)
+	{
+	case NOTIFICATION_ENTER_TREE:
+	case NOTIFICATION_TRANSFORM_CHANGED:
+	{
+		changed();
+	}
+	break;
+	case NOTIFICATION_EXIT_TREE:
+	{
+		DetourNavigation *navigation = find_navigation();
+		if (navigation != nullptr)
+		{
+			navigation->remove_offmesh_link(this);
+		}
+	}
+	break;
+	}
+}
+
+void DetourOffMeshLink::set_end(Vector3 p_end)
+{
+	end = p_end;
+	changed();
+}
+
+Vector3 DetourOffMeshLink::get_end()
+{
+	return end;
+}
+
+void DetourOffMeshLink::set_radius(float p_radius)
+{
+	radius = std::max(p_radius, 0.01f);
+	changed();
+}
+
+float DetourOffMeshLink::get_radius()
+{
+	return radius;
+}
+
+void DetourOffMeshLink::set_bidirectional(bool p_bidirectional)
+{
+	bidirectional = p_bidirectional;
+	changed();
+}
+
+bool DetourOffMeshLink::get_bidirectional()
+{
+	return bidirectional;
+}
+
+/* Area 0 would make the link unusable, it's kept walkable */
+void DetourOffMeshLink::set_area(int p_area)
+{
+	area = std::min(std::max(p_area, 1), (int)RC_WALKABLE_AREA);
+	changed();
+}
+
+int DetourOffMeshLink::get_area()
+{
+	return area;
+}
+
+Vector3 DetourOffMeshLink::get_global_start()
+{
+	return get_global_transform().origin;
+}
+
+Vector3 DetourOffMeshLink::get_global_end()
+{
+	return get_global_transform().xform(end);
+}
+
+DetourNavigation *DetourOffMeshLink::find_navigation()
+{
+	for (Node *node = get_parent(); node != nullptr; node = node->get_parent())
+	{
+		DetourNavigation *navigation = Object::cast_to<DetourNavigation>(node);
+		if (navigation != nullptr)
+		{
+			return navigation;
+		}
+	}
+	return nullptr;
+}
+
+void DetourOffMeshLink::changed()
+{
+	if (!is_inside_tree())
+	{
+		return;
+	}
+	DetourNavigation *navigation = find_navigation();
+	if (navigation != nullptr)
+	{
+		navigation->update_offmesh_link(this);
+	}
+}
@@ -0,0 +1,53 @@
+#ifndef OFFMESH_LINK_H
+#define OFFMESH_LINK_H
+
+#include <Godot.hpp>
+#include <Spatial.hpp>
+
+namespace godot
+{
+
+class DetourNavigation;
+
+/**
+ * Off-mesh connection like a ladder, jump or teleport. It starts at the
+ * node and ends at end, which is relative to the node. Must be a child
+ * (at any depth) of DetourNavigation, adding or moving it rebuilds only
+ * the tile its start is in.
+ */
+class DetourOffMeshLink : public Spatial
+{
+	GODOT_CLASS(DetourOffMeshLink, Spatial);
+
+public:
+	DetourOffMeshLink();
+	~DetourOffMeshLink();
+
+	void _init();
+	static void _register_methods();
+	void _notification(int p_what);
+
+	void set_end(Vector3 p_end);
+	Vector3 get_end();
+	void set_radius(float p_radius);
+	float get_radius();
+	void set_bidirectional(bool p_bidirectional);
+	bool get_bidirectional();
+	void set_area(int p_area);
+	int get_area();
+
+	Vector3 get_global_start();
+	Vector3 get_global_end();
+
+private:
+	Vector3 end;
+	float radius;
+	bool bidirectional;
+	int area;
+
+	DetourNavigation *find_navigation();
+	void changed();
+};
+
+} // namespace godot
+#endif
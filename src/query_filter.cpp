@@ -0,0 +1,48 @@
+#include <algorithm>
+#include "query_filter.h"
+
+using namespace godot;
+
+static const int DEFAULT_INCLUDE_FLAGS = 0xffff;
+static const int DEFAULT_EXCLUDE_FLAGS = 0;
+
+void DetourQueryFilter::_register_methods()
+{
+	register_property<DetourQueryFilter, PoolRealArray>("area_costs", &DetourQueryFilter::set_area_costs, &DetourQueryFilter::get_area_costs, PoolRealArray());
+	register_property<DetourQueryFilter, int>("include_flags", &DetourQueryFilter::set_include_flags, &DetourQueryFilter::get_include_flags, DEFAULT_INCLUDE_FLAGS);
+	register_property<DetourQueryFilter, int>("exclude_flags", &DetourQueryFilter::set_exclude_flags, &DetourQueryFilter::get_exclude_flags, DEFAULT_EXCLUDE_FLAGS);
+}
+
+DetourQueryFilter::DetourQueryFilter()
+{
+}
+
+DetourQueryFilter::~DetourQueryFilter()
+{
+}
+
+void DetourQueryFilter::_init()
+{
+	include_flags = DEFAULT_INCLUDE_FLAGS;
+	exclude_flags = DEFAULT_EXCLUDE_FLAGS;
+}
+
+/**
+ * Copies costs and flags to a Detour filter, areas without a cost keep 1
+ */
+void DetourQueryFilter::apply(dtQueryFilter *filter)
+{
+	for (int i = 0; i < DT_MAX_AREAS; i++)
+	{
+		filter->setAreaCost(i, 1.f);
+	}
+	PoolRealArray::Read costs = area_costs.read();
+	int count = std::min(area_costs.size(), DT_MAX_AREAS - 1);
+	for (int i = 0; i < count; i++)
+	{
+		/* Negative costs would break A*, the cheapest area is free */
+		filter->setAreaCost(i + 1, std::max(costs[i], 0.f));
+	}
+	filter->setIncludeFlags((unsigned short)include_flags);
+	filter->setExcludeFlags((unsigned short)exclude_flags);
+}
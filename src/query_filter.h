@@ -0,0 +1,38 @@
+#ifndef QUERY_FILTER_H
+#define QUERY_FILTER_H
+
+#include <Godot.hpp>
+#include <Resource.hpp>
+#include <PoolArrays.hpp>
+#include "DetourNavMeshQuery.h"
+#include "helpers.h"
+
+namespace godot
+{
+
+/**
+ * Area costs and polygon flags used by path queries. Add it to a
+ * navigation mesh with add_query_filter and pass the returned handle
+ * to the queries, the values are copied to a native filter once.
+ */
+class DetourQueryFilter : public Resource
+{
+	GODOT_CLASS(DetourQueryFilter, Resource);
+
+public:
+	DetourQueryFilter();
+	~DetourQueryFilter();
+
+	void _init();
+	static void _register_methods();
+
+	/* Cost of area i + 1, the same numbering as area_layers in navmesh parameters */
+	SETGET(area_costs, PoolRealArray);
+	SETGET(include_flags, int);
+	SETGET(exclude_flags, int);
+
+	void apply(dtQueryFilter *filter);
+};
+
+} // namespace godot
+#endif
@@ -5,9 +5,8 @@ using namespace godot;
 
 DetourNavigationMeshCacheGenerator::DetourNavigationMeshCacheGenerator()
 {
-	tile_cache_alloc = new LinearAllocator(64000);
-	tile_cache_compressor = new FastLZCompressor();
 	mesh_process = new NavMeshProcess();
+	mesh_process->generator = this;
 }
 
 DetourNavigationMeshCacheGenerator::~DetourNavigationMeshCacheGenerator()
@@ -22,7 +21,8 @@ void DetourNavigationMeshCacheGenerator::build()
 {
 	DetourNavigationMeshGenerator::navmesh_parameters = navmesh_parameters;
 
-	joint_build();
+	int max_layers = navmesh_parameters->get_max_layers();
+	joint_build(max_layers);
 	dtTileCacheParams tile_cache_params;
 	memset(&tile_cache_params, 0, sizeof(tile_cache_params));
 	rcVcopy(tile_cache_params.orig, &bounding_box.position[0]);
@@ -31,18 +31,39 @@ void DetourNavigationMeshCacheGenerator::build()
 	tile_cache_params.width = navmesh_parameters->get_tile_size();
 	tile_cache_params.height = navmesh_parameters->get_tile_size();
 	tile_cache_params.maxSimplificationError = navmesh_parameters->get_edge_max_error();
-	tile_cache_params.maxTiles = get_num_tiles_x() * get_num_tiles_z() * navmesh_parameters->get_max_layers() * 10;
+	/* One compressed layer per navmesh tile, the tile cache ids share 22 bits with the salt too */
+	tile_cache_params.maxTiles = get_num_tiles_x() * get_num_tiles_z() * max_layers;
+	if (ilog2(nextPow2(tile_cache_params.maxTiles)) > NavmeshCapacity::ID_BITS)
+	{
+		std::string capacity_message = "Tile cache needs " + std::to_string(tile_cache_params.maxTiles) + " tiles, more than its ids allow, use a bigger tile_size or fewer max_layers";
+		ERR_PRINT(capacity_message.c_str());
+	}
 	tile_cache_params.maxObstacles = navmesh_parameters->get_max_obstacles();
 	tile_cache_params.walkableClimb = navmesh_parameters->get_agent_max_climb();
 	tile_cache_params.walkableHeight = navmesh_parameters->get_agent_height();
 	tile_cache_params.walkableRadius = navmesh_parameters->get_agent_radius();
 
+	mesh_process->set_area_flags(navmesh_parameters.ptr());
+	tile_cache_compressor = create_tile_cache_compressor(navmesh_parameters->get_tile_compression());
+	tile_cache_alloc = new ChunkedAllocator(get_tile_scratch_size());
 	if (!alloc_tile_cache())
 		return;
 	if (!init_tile_cache(&tile_cache_params))
 		return;
 	unsigned int result = build_tiles(
 		0, 0, get_num_tiles_x() - 1, get_num_tiles_z() - 1);
+	if (get_detour_navmesh() != nullptr)
+	{
+		/* Room for one layer more than any position has now */
+		fit_capacity(std::min(max_layers, NavmeshCapacity::get_max_tile_layers(get_detour_navmesh()) + 1));
+	}
+
+	if (OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string capacity_message = "Tile cache capacity " + std::to_string(tile_cache_params.maxTiles) + " tiles, " +
+									   std::to_string(NavmeshCapacity::get_tile_cache_memory(tile_cache)) + " bytes";
+		Godot::print(capacity_message.c_str());
+	}
 }
 
 unsigned int DetourNavigationMeshCacheGenerator::build_tiles(
@@ -63,7 +84,11 @@ unsigned int DetourNavigationMeshCacheGenerator::build_tiles(
 	return ret;
 }
 
-bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
+/**
+ * @param build_navmesh swaps the navmesh tiles too, otherwise only the tile
+ * cache layers are replaced and the caller builds the navmesh tiles from them
+ */
+bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z, bool build_navmesh)
 {
 	Vector3 bmin, bmax;
 	get_tile_bounding_box(x, z, bmin, bmax);
@@ -77,7 +102,8 @@ bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
 
 	std::vector<float> points;
 	std::vector<int> indices;
-	if (init_tile_data(config, bmin, bmax, points, indices))
+	std::vector<unsigned char> areas;
+	if (init_tile_data(config, bmin, bmax, points, indices, areas))
 	{
 		return true;
 	}
@@ -85,7 +111,7 @@ bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
 	rcContext *ctx = new rcContext(true);
 	rcCompactHeightfield *compact_heightfield = rcAllocCompactHeightfield();
 
-	if (!init_heightfield_context(config, compact_heightfield, ctx, points, indices))
+	if (!init_heightfield_context(config, compact_heightfield, ctx, points, indices, areas))
 	{
 		return false;
 	}
@@ -109,8 +135,11 @@ bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
 		if (cTileRef)
 		{
 			dtStatus status = tile_cache->removeTile(cTileRef, NULL, NULL);
-			dtTileRef ref = detour_navmesh->getTileRefAt(x, z, i);
-			detour_navmesh->removeTile(ref, 0, 0);
+			if (build_navmesh)
+			{
+				dtTileRef ref = detour_navmesh->getTileRefAt(x, z, i);
+				detour_navmesh->removeTile(ref, 0, 0);
+			}
 		}
 	}
 
@@ -157,6 +186,10 @@ bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
 		}
 	}
 
+	if (!build_navmesh)
+	{
+		return true;
+	}
 	int st = tile_cache->buildNavMeshTilesAt(x, z, nav);
 	if (dtStatusFailed(st))
 	{
@@ -165,6 +198,18 @@ bool DetourNavigationMeshCacheGenerator::build_tile(int x, int z)
 	return true;
 }
 
+/**
+ * Scratch memory dtTileCache needs to build one layer into a navmesh tile:
+ * the decompressed layer, regions, contours and the polygon mesh take
+ * about 16 bytes per cell of a layer with its border
+ */
+size_t DetourNavigationMeshCacheGenerator::get_tile_scratch_size()
+{
+	int border = (int)ceilf(navmesh_parameters->get_agent_radius() / navmesh_parameters->get_cell_size()) + 3;
+	size_t layer_width = (size_t)(navmesh_parameters->get_tile_size() + 2 * border);
+	return layer_width * layer_width * 16;
+}
+
 /* Tile Cache */
 bool DetourNavigationMeshCacheGenerator::alloc_tile_cache()
 {
@@ -8,14 +8,22 @@ namespace godot
 {
 struct NavMeshProcess : public dtTileCacheMeshProcess
 {
+	/* Polygon flags per area, copied from the navmesh parameters */
+	unsigned short area_flags[DT_MAX_AREAS];
+	/* Source of the off-mesh links, set by the generator that owns the tile cache */
+	DetourNavigationMeshGenerator *generator = nullptr;
+	OffMeshTileData offmesh;
+
+	NavMeshProcess();
+	void set_area_flags(NavmeshParameters *np);
 	virtual void process(struct dtNavMeshCreateParams *params,
 						 unsigned char *polyAreas, unsigned short *polyFlags);
 };
 class DetourNavigationMeshCacheGenerator : public DetourNavigationMeshGenerator
 {
 	dtTileCache *tile_cache = nullptr;
-	dtTileCacheAlloc *tile_cache_alloc = nullptr;
-	dtTileCacheCompressor *tile_cache_compressor = nullptr;
+	ChunkedAllocator *tile_cache_alloc = nullptr;
+	TileCacheCompressor *tile_cache_compressor = nullptr;
 	friend struct NavMeshProcess;
 	NavMeshProcess *mesh_process = nullptr;
 
@@ -26,15 +34,10 @@ public:
 	Ref<CachedNavmeshParameters> navmesh_parameters = nullptr;
 
 	std::vector<int> tile_queue;
-	std::vector<Vector3> offmesh_vertices;
-	std::vector<float> offmesh_radius;
-	std::vector<unsigned short> offmesh_flags;
-	std::vector<unsigned char> offmesh_areas;
-	std::vector<unsigned char> offmesh_dir;
 
 	unsigned int build_tiles(
 		int x1, int z1, int x2, int z2);
-	bool build_tile(int x, int z);
+	bool build_tile(int x, int z, bool build_navmesh = true);
 
 	/* Tile cache */
 	void init_values();
@@ -61,6 +64,7 @@ public:
 	void set_mesh_process(NavMeshProcess *nmp)
 	{
 		mesh_process = nmp;
+		mesh_process->generator = this;
 	}
 
 	dtTileCache *get_tile_cache()
@@ -73,10 +77,23 @@ public:
 		return mesh_process;
 	}
 
-	dtTileCacheCompressor *get_tile_cache_compressor()
+	TileCacheCompressor *get_tile_cache_compressor()
 	{
 		return tile_cache_compressor;
 	}
+
+	ChunkedAllocator *get_tile_cache_alloc()
+	{
+		return tile_cache_alloc;
+	}
+
+	size_t get_tile_scratch_size();
+
+	/* The codec of a loaded tile cache, owned by the navmesh */
+	void set_tile_cache_compressor(TileCacheCompressor *tcc)
+	{
+		tile_cache_compressor = tcc;
+	}
 };
 
 } // namespace godot
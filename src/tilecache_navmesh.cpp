@@ -1,8 +1,37 @@
+#include <algorithm>
+#include <cstdint>
+#include <iterator>
+#include "DetourNavMeshBuilder.h"
 #include "tilecache_navmesh.h"
 #include "navigation.h"
 
 using namespace godot;
 
+/* Requests and tile updates dtTileCache can queue (MAX_REQUESTS and MAX_UPDATE in DetourTileCache.cpp) */
+static const int TILE_CACHE_QUEUE_SIZE = 64;
+/* Tiles one obstacle can touch (DT_MAX_TOUCHED_TILES) */
+static const int MAX_TOUCHED_TILES = 8;
+
+NavMeshProcess::NavMeshProcess()
+{
+	for (int i = 0; i < DT_MAX_AREAS; i++)
+	{
+		area_flags[i] = 0x1;
+	}
+}
+
+void NavMeshProcess::set_area_flags(NavmeshParameters *np)
+{
+	if (np == nullptr)
+	{
+		return;
+	}
+	for (int i = 0; i < DT_MAX_AREAS; i++)
+	{
+		area_flags[i] = np->get_flags_for_area((unsigned char)i);
+	}
+}
+
 void NavMeshProcess::process(struct dtNavMeshCreateParams *params,
 							 unsigned char *polyAreas, unsigned short *polyFlags)
 {
@@ -10,9 +39,15 @@ void NavMeshProcess::process(struct dtNavMeshCreateParams *params,
 	{
 		if (polyAreas[i] != RC_NULL_AREA)
 		{
-			polyFlags[i] = RC_WALKABLE_AREA;
+			polyFlags[i] = area_flags[polyAreas[i] & (DT_MAX_AREAS - 1)];
 		}
 	}
+	if (generator != nullptr)
+	{
+		/* The buffers stay alive until the tile cache has created the tile */
+		generator->collect_offmesh_links(params->tileX, params->tileY, offmesh);
+		offmesh.apply(*params);
+	}
 }
 
 DetourNavigationMeshCached::DetourNavigationMeshCached()
@@ -21,6 +56,8 @@ DetourNavigationMeshCached::DetourNavigationMeshCached()
 
 DetourNavigationMeshCached::~DetourNavigationMeshCached()
 {
+	stop_tile_workers();
+
 	if (tile_cache != nullptr)
 	{
 		dtFreeTileCache(tile_cache);
@@ -31,6 +68,11 @@ DetourNavigationMeshCached::~DetourNavigationMeshCached()
 		delete tile_cache_compressor;
 	}
 
+	if (tile_cache_alloc != nullptr)
+	{
+		delete tile_cache_alloc;
+	}
+
 	if (mesh_process != nullptr)
 	{
 		delete mesh_process;
@@ -60,12 +102,24 @@ void DetourNavigationMeshCached::_register_methods()
 	register_method("add_box_obstacle", &DetourNavigationMeshCached::add_box_obstacle);
 	register_method("add_cylinder_obstacle", &DetourNavigationMeshCached::add_cylinder_obstacle);
 	register_method("remove_obstacle", &DetourNavigationMeshCached::remove_obstacle);
+	register_method("add_box_obstacles", &DetourNavigationMeshCached::add_box_obstacles);
+	register_method("add_cylinder_obstacles", &DetourNavigationMeshCached::add_cylinder_obstacles);
+	register_method("remove_obstacles", &DetourNavigationMeshCached::remove_obstacles);
 	register_method("save_navmesh", &DetourNavigationMeshCached::save_mesh);
 	register_method("update_obstacle", &DetourNavigationMeshCached::refresh_obstacle);
+	register_method("get_rebuild_stats", &DetourNavigationMeshCached::get_rebuild_stats);
+	register_method("get_compression_stats", &DetourNavigationMeshCached::get_compression_stats);
+	register_method("get_allocator_stats", &DetourNavigationMeshCached::get_allocator_stats);
+
+	register_signal<DetourNavigationMeshCached>("paths_ready", "callback_ids", GODOT_VARIANT_TYPE_POOL_INT_ARRAY,
+												"offsets", GODOT_VARIANT_TYPE_POOL_INT_ARRAY, "points", GODOT_VARIANT_TYPE_POOL_VECTOR3_ARRAY,
+												"statuses", GODOT_VARIANT_TYPE_POOL_INT_ARRAY, "nodes_expanded", GODOT_VARIANT_TYPE_POOL_INT_ARRAY);
 
 	register_property<DetourNavigationMeshCached, int>("collision_mask", &DetourNavigationMeshCached::set_collision_mask, &DetourNavigationMeshCached::get_collision_mask, 1,
 													   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_DEFAULT, GODOT_PROPERTY_HINT_LAYERS_3D_PHYSICS);
 
+	register_property<DetourNavigationMeshCached, bool>("parallel_tile_updates", &DetourNavigationMeshCached::set_parallel_tile_updates, &DetourNavigationMeshCached::get_parallel_tile_updates, false);
+
 	register_property<DetourNavigationMeshCached, int>("dynamic_objects_collision_mask", &DetourNavigationMeshCached::set_dynamic_collision_mask, &DetourNavigationMeshCached::get_dynamic_collision_mask, 1,
 													   GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_DEFAULT, GODOT_PROPERTY_HINT_LAYERS_3D_PHYSICS);
 
@@ -75,11 +129,15 @@ void DetourNavigationMeshCached::_register_methods()
 														 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 	register_property<DetourNavigationMeshCached, Array>("input_aabbs_storage", &DetourNavigationMeshCached::set_input_aabbs_storage, &DetourNavigationMeshCached::get_input_aabbs_storage, Array(),
 														 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
+	register_property<DetourNavigationMeshCached, Array>("collision_layers_storage", &DetourNavigationMeshCached::set_collision_layers_storage, &DetourNavigationMeshCached::get_collision_layers_storage, Array(),
+														 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 	register_property<DetourNavigationMeshCached, Array>("collision_ids_storage", &DetourNavigationMeshCached::set_collision_ids_storage, &DetourNavigationMeshCached::get_collision_ids_storage, Array(),
 														 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 
 	register_property<DetourNavigationMeshCached, PoolByteArray>("serialized_navmesh_data", &DetourNavigationMeshCached::set_serialized_navmesh_data, &DetourNavigationMeshCached::get_serialized_navmesh_data, PoolByteArray(),
 																 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
+	register_property<DetourNavigationMeshCached, PoolByteArray>("landmark_data", &DetourNavigationMeshCached::set_landmark_data, &DetourNavigationMeshCached::get_landmark_data, PoolByteArray(),
+																 GODOT_METHOD_RPC_MODE_DISABLED, GODOT_PROPERTY_USAGE_STORAGE, GODOT_PROPERTY_HINT_NONE);
 
 	register_property<DetourNavigationMeshCached, Color>(
 		"debug_mesh_color", &DetourNavigationMeshCached::set_debug_mesh_color, &DetourNavigationMeshCached::get_debug_mesh_color, Color(0.1f, 1.0f, 0.7f, 0.4f));
@@ -94,6 +152,7 @@ void DetourNavigationMeshCached::_init()
 {
 	DetourNavigationMesh::_init();
 	dynamic_collision_mask = 2;
+	parallel_tile_updates = false;
 }
 
 void DetourNavigationMeshCached::_exit_tree()
@@ -107,6 +166,8 @@ void DetourNavigationMeshCached::_ready()
 void DetourNavigationMeshCached::set_dynamic_collision_mask(int cm)
 {
 	dynamic_collision_mask = cm;
+	/* All obstacles are compared on the next update, some may (not) belong here now */
+	obstacle_serial = 0;
 	Node *parent = get_parent();
 	DetourNavigation *navigation = Object::cast_to<DetourNavigation>(parent);
 
@@ -124,6 +185,7 @@ void DetourNavigationMeshCached::build_navmesh()
 	}
 	clear_navmesh();
 	dtmi->build_navmesh_cached(this);
+	build_landmarks();
 	save_mesh();
 }
 
@@ -142,6 +204,7 @@ void DetourNavigationMeshCached::clear_navmesh()
 
 void DetourNavigationMeshCached::release_navmesh()
 {
+	stop_tile_workers();
 	DetourNavigationMesh::release_navmesh();
 
 	if (tile_cache != nullptr)
@@ -149,6 +212,11 @@ void DetourNavigationMeshCached::release_navmesh()
 		dtFreeTileCache(tile_cache);
 		tile_cache = nullptr;
 	}
+	obstacle_grid.clear();
+	obstacle_refs.clear();
+	obstacle_serial = 0;
+	convex_obstacles.clear();
+	pending_layers.clear();
 
 	if (tile_cache_compressor != nullptr)
 	{
@@ -156,6 +224,12 @@ void DetourNavigationMeshCached::release_navmesh()
 		tile_cache_compressor = nullptr;
 	}
 
+	if (tile_cache_alloc != nullptr)
+	{
+		delete tile_cache_alloc;
+		tile_cache_alloc = nullptr;
+	}
+
 	if (mesh_process != nullptr)
 	{
 		delete mesh_process;
@@ -177,20 +251,28 @@ bool DetourNavigationMeshCached::load_mesh()
 	mesh_process = new NavMeshProcess();
 
 	init_generator(((Spatial *)get_parent())->get_global_transform());
+	mesh_process->set_area_flags(navmesh_parameters.ptr());
 	generator->detour_navmesh = detour_navmesh;
 	generator->set_mesh_process(mesh_process);
 	generator->set_tile_cache(tile_cache);
-	bool success = Serializer::deserializeNavigationMeshCached(serialized_navmesh_data, tile_cache, detour_navmesh, mesh_process);
+	tile_cache_alloc = new ChunkedAllocator(generator->get_tile_scratch_size());
+	bool success = Serializer::deserializeNavigationMeshCached(serialized_navmesh_data, tile_cache, detour_navmesh, mesh_process, tile_cache_alloc, &tile_cache_compressor);
+	generator->set_tile_cache_compressor(tile_cache_compressor);
 
 	if (!success)
 	{
 		dtFreeTileCache(tile_cache);
 		dtFreeNavMesh(detour_navmesh);
 		delete mesh_process;
+		delete tile_cache_compressor;
+		delete tile_cache_alloc;
 
 		mesh_process = nullptr;
 		tile_cache = nullptr;
+		tile_cache_compressor = nullptr;
+		tile_cache_alloc = nullptr;
 		generator->set_tile_cache(nullptr);
+		generator->set_tile_cache_compressor(nullptr);
 		generator->detour_navmesh = nullptr;
 		detour_navmesh = nullptr;
 		ERR_PRINT("No baked navmesh found for " + get_name());
@@ -198,15 +280,21 @@ bool DetourNavigationMeshCached::load_mesh()
 	}
 	else
 	{
+		Serializer::deserializeLandmarks(landmark_data, &landmarks, detour_navmesh);
 		if (!load_inputs())
 		{
 			dtFreeTileCache(tile_cache);
 			dtFreeNavMesh(detour_navmesh);
 			delete mesh_process;
+			delete tile_cache_compressor;
+			delete tile_cache_alloc;
 
 			mesh_process = nullptr;
 			tile_cache = nullptr;
+			tile_cache_compressor = nullptr;
+			tile_cache_alloc = nullptr;
 			generator->set_tile_cache(nullptr);
+			generator->set_tile_cache_compressor(nullptr);
 			generator->detour_navmesh = nullptr;
 			detour_navmesh = nullptr;
 			return false;
@@ -221,7 +309,9 @@ bool DetourNavigationMeshCached::load_mesh()
 
 void DetourNavigationMeshCached::save_mesh()
 {
-	serialized_navmesh_data = Serializer::serializeNavigationMeshCached(tile_cache, get_detour_navmesh());
+	int compression = tile_cache_compressor != nullptr ? tile_cache_compressor->get_type() : TILE_COMPRESSION_FAST;
+	serialized_navmesh_data = Serializer::serializeNavigationMeshCached(tile_cache, get_detour_navmesh(), compression);
+	landmark_data = Serializer::serializeLandmarks(&landmarks);
 	store_inputs();
 }
 
@@ -267,17 +357,301 @@ void DetourNavigationMeshCached::remove_obstacle(int id)
 		ERR_PRINT("failed to remove obstacle");
 }
 
-Dictionary DetourNavigationMeshCached::find_path(Variant from, Variant to)
+/**
+ * Adds many box obstacles in one coalesced tile cache update
+ *
+ * @return obstacle ids in the order of positions, 0 where adding failed
+ */
+PoolIntArray DetourNavigationMeshCached::add_box_obstacles(PoolVector3Array positions, PoolVector3Array extents, PoolRealArray rotations)
 {
+	PoolIntArray ids;
+	if (extents.size() != positions.size() || rotations.size() != positions.size())
+	{
+		ERR_PRINT("add_box_obstacles needs as many extents and rotations as positions");
+		return ids;
+	}
+	std::vector<ObstacleRequest> requests(positions.size());
+	{
+		PoolVector3Array::Read positions_read = positions.read();
+		PoolVector3Array::Read extents_read = extents.read();
+		PoolRealArray::Read rotations_read = rotations.read();
+		for (int i = 0; i < positions.size(); i++)
+		{
+			requests[i].type = ObstacleRequest::ADD_BOX;
+			requests[i].position = positions_read[i];
+			requests[i].extents = extents_read[i];
+			requests[i].rotation = rotations_read[i];
+		}
+	}
+	apply_obstacle_batch(requests);
+
+	ids.resize((int)requests.size());
+	PoolIntArray::Write ids_write = ids.write();
+	for (int i = 0; i < (int)requests.size(); i++)
+	{
+		ids_write[i] = (int)requests[i].ref;
+	}
+	return ids;
+}
+
+/**
+ * Adds many cylinder obstacles in one coalesced tile cache update,
+ * positions are the bottom centers
+ *
+ * @return obstacle ids in the order of positions, 0 where adding failed
+ */
+PoolIntArray DetourNavigationMeshCached::add_cylinder_obstacles(PoolVector3Array positions, PoolRealArray radii, PoolRealArray heights)
+{
+	PoolIntArray ids;
+	if (radii.size() != positions.size() || heights.size() != positions.size())
+	{
+		ERR_PRINT("add_cylinder_obstacles needs as many radii and heights as positions");
+		return ids;
+	}
+	std::vector<ObstacleRequest> requests(positions.size());
+	{
+		PoolVector3Array::Read positions_read = positions.read();
+		PoolRealArray::Read radii_read = radii.read();
+		PoolRealArray::Read heights_read = heights.read();
+		for (int i = 0; i < positions.size(); i++)
+		{
+			requests[i].type = ObstacleRequest::ADD_CYLINDER;
+			requests[i].position = positions_read[i];
+			requests[i].radius = radii_read[i];
+			requests[i].height = heights_read[i];
+		}
+	}
+	apply_obstacle_batch(requests);
+
+	ids.resize((int)requests.size());
+	PoolIntArray::Write ids_write = ids.write();
+	for (int i = 0; i < (int)requests.size(); i++)
+	{
+		ids_write[i] = (int)requests[i].ref;
+	}
+	return ids;
+}
+
+void DetourNavigationMeshCached::remove_obstacles(PoolIntArray ids)
+{
+	std::vector<ObstacleRequest> requests(ids.size());
+	PoolIntArray::Read ids_read = ids.read();
+	for (int i = 0; i < ids.size(); i++)
+	{
+		requests[i].type = ObstacleRequest::REMOVE;
+		requests[i].ref = (dtObstacleRef)ids_read[i];
+	}
+	apply_obstacle_batch(requests);
+}
+
+/**
+ * Applies obstacle changes so that every touched tile is rebuilt once.
+ * dtTileCache drops requests beyond its queue of 64 and forgets tiles
+ * beyond 64 pending updates, so requests are sorted by the tiles they
+ * touch and handed over in chunks that stay within both limits. Each
+ * chunk is collected before the next, the touched tiles are built once
+ * after the last chunk.
+ *
+ * @param wait builds the touched tiles now, otherwise it's left to update_tilecache
+ */
+void DetourNavigationMeshCached::apply_obstacle_batch(std::vector<ObstacleRequest> &requests, bool wait)
+{
+	if (requests.empty() || tile_cache == nullptr || get_detour_navmesh() == nullptr)
+	{
+		return;
+	}
+	/* Requests queued by single obstacle calls would count against the limits */
+	collect_tile_updates();
+
+	/* Touched tiles of every request, the same bounds dtTileCache uses */
+	std::vector<std::vector<dtCompressedTileRef>> touched(requests.size());
+	std::vector<AABB> bounds(requests.size());
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		ObstacleRequest &request = requests[i];
+		float bmin[3], bmax[3];
+		if (request.type == ObstacleRequest::REMOVE)
+		{
+			const dtTileCacheObstacle *obstacle = tile_cache->getObstacleByRef(request.ref);
+			if (obstacle == nullptr)
+			{
+				continue;
+			}
+			tile_cache->getObstacleBounds(obstacle, bmin, bmax);
+		}
+		else if (request.type == ObstacleRequest::ADD_CONVEX)
+		{
+			if (request.footprint.size() < 9)
+			{
+				continue;
+			}
+			bmin[0] = bmax[0] = request.footprint[0];
+			bmin[2] = bmax[2] = request.footprint[2];
+			for (size_t j = 3; j + 2 < request.footprint.size(); j += 3)
+			{
+				bmin[0] = std::min(bmin[0], request.footprint[j]);
+				bmin[2] = std::min(bmin[2], request.footprint[j + 2]);
+				bmax[0] = std::max(bmax[0], request.footprint[j]);
+				bmax[2] = std::max(bmax[2], request.footprint[j + 2]);
+			}
+			bmin[1] = request.position.y;
+			bmax[1] = request.position.y + request.height;
+		}
+		else if (request.type == ObstacleRequest::ADD_BOX)
+		{
+			float max_extent = 1.41f * std::max(request.extents.x, request.extents.z);
+			bmin[0] = request.position.x - max_extent;
+			bmin[1] = request.position.y - request.extents.y;
+			bmin[2] = request.position.z - max_extent;
+			bmax[0] = request.position.x + max_extent;
+			bmax[1] = request.position.y + request.extents.y;
+			bmax[2] = request.position.z + max_extent;
+		}
+		else
+		{
+			bmin[0] = request.position.x - request.radius;
+			bmin[1] = request.position.y;
+			bmin[2] = request.position.z - request.radius;
+			bmax[0] = request.position.x + request.radius;
+			bmax[1] = request.position.y + request.height;
+			bmax[2] = request.position.z + request.radius;
+		}
+		bounds[i] = AABB(Vector3(bmin[0], bmin[1], bmin[2]), Vector3(bmax[0] - bmin[0], bmax[1] - bmin[1], bmax[2] - bmin[2]));
+		dtCompressedTileRef tiles[MAX_TOUCHED_TILES];
+		int tile_count = 0;
+		tile_cache->queryTiles(bmin, bmax, tiles, &tile_count, MAX_TOUCHED_TILES);
+		touched[i].assign(tiles, tiles + tile_count);
+		std::sort(touched[i].begin(), touched[i].end());
+	}
 
-	if (!nav_query)
+	std::vector<int> order(requests.size());
+	for (int i = 0; i < (int)order.size(); i++)
 	{
-		nav_query = new DetourNavigationQuery();
-		nav_query->init(get_detour_navmesh(), get_global_transform());
-		query_filter = new DetourNavigationQueryFilter();
+		order[i] = i;
 	}
+	std::stable_sort(order.begin(), order.end(), [&touched](int a, int b) {
+		dtCompressedTileRef first_a = touched[a].empty() ? 0 : touched[a][0];
+		dtCompressedTileRef first_b = touched[b].empty() ? 0 : touched[b][0];
+		return first_a < first_b;
+	});
+
+	std::vector<dtCompressedTileRef> chunk_tiles;
+	int chunk_requests = 0;
+	int chunks = 0;
+	for (int index : order)
+	{
+		ObstacleRequest &request = requests[index];
 
-	Dictionary result = nav_query->find_path((Vector3)from, (Vector3)to, Vector3(50.0f, 50.f, 50.f), query_filter);
+		std::vector<dtCompressedTileRef> merged;
+		std::set_union(chunk_tiles.begin(), chunk_tiles.end(), touched[index].begin(), touched[index].end(), std::back_inserter(merged));
+		if (chunk_requests > 0 && (chunk_requests == TILE_CACHE_QUEUE_SIZE || (int)merged.size() > TILE_CACHE_QUEUE_SIZE))
+		{
+			collect_tile_updates();
+			chunks++;
+			chunk_tiles = touched[index];
+			chunk_requests = 0;
+		}
+		else
+		{
+			chunk_tiles.swap(merged);
+		}
+
+		dtStatus status = DT_SUCCESS;
+		if (request.type == ObstacleRequest::ADD_BOX)
+		{
+			status = tile_cache->addBoxObstacle(&request.position.coord[0], &request.extents.coord[0], request.rotation, &request.ref);
+		}
+		else if (request.type == ObstacleRequest::ADD_CYLINDER)
+		{
+			status = tile_cache->addObstacle(&request.position.coord[0], request.radius, request.height, &request.ref);
+		}
+		else if (request.type == ObstacleRequest::ADD_CONVEX)
+		{
+			if (request.footprint.size() < 9)
+			{
+				status = DT_FAILURE;
+			}
+			else
+			{
+				Vector3 bmin = bounds[index].position;
+				Vector3 bmax = bounds[index].position + bounds[index].size;
+				status = tile_cache->addBoxObstacle(&bmin.coord[0], &bmax.coord[0], &request.ref);
+			}
+			if (dtStatusSucceed(status))
+			{
+				ConvexObstacle &convex = convex_obstacles[request.ref];
+				convex.verts = request.footprint;
+				convex.hmin = request.position.y;
+				convex.hmax = request.position.y + request.height;
+			}
+		}
+		else if (request.ref != 0)
+		{
+			status = tile_cache->removeObstacle(request.ref);
+			convex_obstacles.erase(request.ref);
+		}
+		if (dtStatusFailed(status))
+		{
+			ERR_PRINT("Can't apply obstacle change");
+			request.ref = 0;
+		}
+		chunk_requests++;
+	}
+	if (wait)
+	{
+		drain_tile_cache();
+	}
+	else
+	{
+		tilecache_up_to_date = false;
+	}
+	chunks++;
+
+	/* In request order, so the removal of an owner's old obstacle comes before its new one */
+	if (!obstacle_grid.is_sized(generator->get_num_tiles_x(), generator->get_num_tiles_z()))
+	{
+		obstacle_grid.init(generator->get_num_tiles_x(), generator->get_num_tiles_z());
+	}
+	for (size_t i = 0; i < requests.size(); i++)
+	{
+		ObstacleRequest &request = requests[i];
+		if (request.owner == 0)
+		{
+			continue;
+		}
+		if (request.type == ObstacleRequest::REMOVE)
+		{
+			obstacle_grid.remove(request.owner);
+		}
+		else if (request.ref != 0)
+		{
+			int min_x, min_z, max_x, max_z;
+			generator->get_tile_range(bounds[i], min_x, min_z, max_x, max_z);
+			obstacle_grid.insert(request.owner, min_x, min_z, max_x, max_z);
+		}
+	}
+
+	debug_navmesh_dirty = true;
+	if (OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string batch_message = "Obstacle batch of " + std::to_string(requests.size()) + " applied in " + std::to_string(chunks) + " tile cache updates";
+		Godot::print(batch_message.c_str());
+	}
+}
+
+/**
+ * Processes queued obstacle requests and rebuilds every tile they touched
+ */
+void DetourNavigationMeshCached::drain_tile_cache()
+{
+	collect_tile_updates();
+	build_pending_layers(UINT64_MAX);
+	tilecache_up_to_date = pending_layers.empty();
+}
+
+Dictionary DetourNavigationMeshCached::find_path(Variant from, Variant to)
+{
+	Dictionary result = get_nav_query()->find_path((Vector3)from, (Vector3)to, query_filter);
 	return result;
 }
 
@@ -290,9 +664,10 @@ DetourNavigationMeshCacheGenerator *DetourNavigationMeshCached::init_generator(T
 	std::vector<Transform> *transforms = new std::vector<Transform>();
 	std::vector<AABB> *aabbs = new std::vector<AABB>();
 	std::vector<int64_t> *cids = new std::vector<int64_t>();
+	std::vector<int> *clayers = new std::vector<int>();
 
 	dtnavmesh_gen->init_mesh_data(meshes, transforms, aabbs,
-								  global_transform, cids);
+								  global_transform, cids, clayers);
 
 	dtnavmesh_gen->set_navmesh_parameters(navmesh_parameters);
 	set_generator(dtnavmesh_gen);
@@ -300,7 +675,10 @@ DetourNavigationMeshCacheGenerator *DetourNavigationMeshCached::init_generator(T
 }
 
 /**
- * Rebuilds all the tiles that were marked as dirty
+ * Rebuilds all the tiles that were marked as dirty. Each tile is
+ * rasterized once into the tile cache, the navmesh keeps the old tile
+ * until the tile cache update builds the new layers. The obstacles on
+ * them are queued again first, so no tile is published without them.
  */
 void DetourNavigationMeshCached::recalculate_tiles()
 {
@@ -309,136 +687,497 @@ void DetourNavigationMeshCached::recalculate_tiles()
 		return;
 	}
 
-	Ref<BoxShape> tile_box = BoxShape::_new();
-	float tile_edge_length = navmesh_parameters->get_tile_edge_length();
-	tile_box->set_extents(Vector3(tile_edge_length * 0.52f, bounding_box.get_size().y, tile_edge_length * 0.52f));
-
-	Ref<PhysicsShapeQueryParameters> query = PhysicsShapeQueryParameters::_new();
-	query->set_shape(tile_box);
-	Transform t = Transform();
-	Array all_results;
-
-	query->set_collision_mask(get_dynamic_collision_mask());
-	std::vector<int> to_rebuild_x;
-	std::vector<int> to_rebuild_z;
-
+	rebuild_stats = RebuildStats();
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	dtNavMesh *navmesh = get_detour_navmesh();
 	for (int i = 0; i < generator->get_num_tiles_x(); i++)
 	{
 		for (int j = 0; j < generator->get_num_tiles_z(); j++)
 		{
 			if (generator->dirty_tiles[i][j] == 1)
 			{
-				t.origin = Vector3(
-					(i + static_cast<real_t>(0.5)) * tile_edge_length + bounding_box.position.x,
-					static_cast<real_t>(0.5) * (bounding_box.position.y + bounding_box.size.y),
-					(j + static_cast<real_t>(0.5)) * tile_edge_length + bounding_box.position.z
-				);
-
-				query->set_transform(t);
-
-				Array results = get_world()->get_direct_space_state()->intersect_shape(query);
-				for (int k = 0; k < results.size(); k++)
+				obstacle_grid.collect(i, j, obstacles_to_refresh);
+				generator->build_tile(i, j, false);
+				/* Layers the tile lost are queued too, to remove their navmesh tiles */
+				for (int layer = 0; layer < navmesh_parameters->get_max_layers(); layer++)
 				{
-					Dictionary result = results[k];
-					PhysicsBody *physics_body = Object::cast_to<PhysicsBody>(result["collider"]);
-					if (physics_body)
+					if (tile_cache->getTileAt(i, j, layer) != nullptr || navmesh->getTileAt(i, j, layer) != nullptr)
 					{
-						for (int l = 0; l < physics_body->get_child_count(); ++l)
-						{
-							CollisionShape *collision_shape = Object::cast_to<CollisionShape>(physics_body->get_child(l));
-							if (collision_shape)
-							{
-								collision_shapes_to_refresh.push_back(collision_shape);
-							}
-						}
+						queue_layer(i, j, layer);
 					}
 				}
-
-				generator->build_tile(i, j);
-				to_rebuild_x.push_back(i);
-				to_rebuild_z.push_back(j);
 				generator->dirty_tiles[i][j] = 0;
+				rebuild_stats.tiles++;
 			}
 		}
 	}
-	tile_box.unref();
-	query.unref();
+	if (rebuild_stats.tiles == 0)
+	{
+		return;
+	}
+	uint64_t rasterized = OS::get_singleton()->get_ticks_usec();
+	rebuild_stats.rasterize_usec = rasterized - start;
+
+	/* Obstacles wider than a tile are listed in every tile they overlap */
+	std::sort(obstacles_to_refresh.begin(), obstacles_to_refresh.end());
+	obstacles_to_refresh.erase(std::unique(obstacles_to_refresh.begin(), obstacles_to_refresh.end()), obstacles_to_refresh.end());
+	rebuild_stats.obstacles = (int)obstacles_to_refresh.size();
 	refresh_obstacles();
-	collision_shapes_to_refresh.clear();
+	obstacles_to_refresh.clear();
+	rebuild_stats.obstacles_usec = OS::get_singleton()->get_ticks_usec() - rasterized;
+
+	rebuild_stats.pending = true;
+	tilecache_up_to_date = false;
+}
 
-	for (int i = 0; i < to_rebuild_x.size(); i++)
+/**
+ * Rebuilds tiles touched by queued obstacle changes until the tile cache
+ * is up to date or the budget is used up. At least one tile is built per
+ * call, so the update can't stall. With parallel_tile_updates all queued
+ * tiles are built at once on the tile workers.
+ *
+ * @param budget_usec time the update may take this frame
+ */
+void DetourNavigationMeshCached::update_tilecache(uint64_t budget_usec)
+{
+	if (get_tile_cache() == nullptr || get_detour_navmesh() == nullptr)
 	{
-		generator->build_tile(to_rebuild_x[i], to_rebuild_z[i]);
+		return;
 	}
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	collect_tile_updates();
+	uint64_t collected = OS::get_singleton()->get_ticks_usec() - start;
+	build_pending_layers(collected < budget_usec ? budget_usec - collected : 0);
+	tilecache_up_to_date = pending_layers.empty();
+	uint64_t elapsed = OS::get_singleton()->get_ticks_usec() - start;
 
-	do
+	if (!rebuild_stats.pending)
+	{
+		return;
+	}
+	rebuild_stats.update_usec += elapsed;
+	rebuild_stats.update_frames++;
+	if (tilecache_up_to_date)
 	{
-		update_tilecache();
-	} while (!tilecache_up_to_date);
+		rebuild_stats.pending = false;
+		if (OS::get_singleton()->is_stdout_verbose())
+		{
+			std::string rebuild_message = "Rebuilt " + std::to_string(rebuild_stats.tiles) + " cached tiles: rasterize " + std::to_string(rebuild_stats.rasterize_usec) +
+										  " us, " + std::to_string(rebuild_stats.obstacles) + " obstacles " + std::to_string(rebuild_stats.obstacles_usec) +
+										  " us, tile cache " + std::to_string(rebuild_stats.update_usec) +
+										  " us over " + std::to_string(rebuild_stats.update_frames) + " frames";
+			Godot::print(rebuild_message.c_str());
+		}
+	}
+}
+
+void DetourNavigationMeshCached::start_tile_workers()
+{
+	if (tile_workers != nullptr)
+	{
+		return;
+	}
+	tile_workers = new WorkerPool(WorkerPool::default_thread_count());
+	for (int i = 0; i < tile_workers->get_thread_count(); i++)
+	{
+		TileWorker worker;
+		worker.alloc = new ChunkedAllocator(generator->get_tile_scratch_size());
+		worker.compressor = create_tile_cache_compressor(tile_cache_compressor->get_type());
+		worker.mesh_process = new NavMeshProcess(*mesh_process);
+		tile_worker_state.push_back(worker);
+	}
 }
 
 /**
- * Update tilecache and set if debug mesh needs to be updated
+ * Frees the tile workers and their scratch, they hold the generator and
+ * codec of the current tile cache
  */
-void DetourNavigationMeshCached::update_tilecache()
+void DetourNavigationMeshCached::stop_tile_workers()
 {
-	bool previous_value = tilecache_up_to_date;
-
-	get_tile_cache()->update(0, get_detour_navmesh(), &tilecache_up_to_date);
-	if (!tilecache_up_to_date || tilecache_up_to_date && previous_value != true)
+	if (tile_workers != nullptr)
 	{
-		debug_navmesh_dirty = true;
+		delete tile_workers;
+		tile_workers = nullptr;
 	}
+	for (TileWorker &worker : tile_worker_state)
+	{
+		delete worker.alloc;
+		delete worker.compressor;
+		delete worker.mesh_process;
+	}
+	tile_worker_state.clear();
 }
 
 /**
- * Finds affected obstacles and refreshes them
+ * Same steps as dtTileCache::buildNavMeshTile up to the navmesh tile data,
+ * with the scratch of the worker and convex obstacles marked by their
+ * outline. Only reads the tile cache and convex_obstacles, on tile workers
+ * the main thread doesn't change them until all builds are done.
  */
-void DetourNavigationMeshCached::refresh_obstacles()
+void DetourNavigationMeshCached::build_tile_layer(TileBuild &build, TileWorker &worker)
 {
-	for (int i = 0; i < collision_shapes_to_refresh.size(); i++)
+	const dtTileCacheParams *params = tile_cache->getParams();
+	const dtCompressedTile *tile = tile_cache->getTileAt(build.tx, build.ty, build.tlayer);
+	if (tile == nullptr)
+	{
+		/* The layer is gone after a rebuild, so is its navmesh tile */
+		build.success = true;
+		return;
+	}
+	dtCompressedTileRef ref = tile_cache->getTileRef(tile);
+	const int walkable_climb_vx = (int)(params->walkableClimb / params->ch);
+	worker.alloc->reset();
+
+	dtTileCacheLayer *layer = nullptr;
+	if (dtStatusFailed(dtDecompressTileCacheLayer(worker.alloc, worker.compressor, tile->data, tile->dataSize, &layer)))
 	{
-		refresh_obstacle(collision_shapes_to_refresh[i]);
+		return;
 	}
+	for (int i = 0; i < tile_cache->getObstacleCount(); i++)
+	{
+		const dtTileCacheObstacle *obstacle = tile_cache->getObstacle(i);
+		if (obstacle->state == DT_OBSTACLE_EMPTY || obstacle->state == DT_OBSTACLE_REMOVING ||
+			std::find(obstacle->touched, obstacle->touched + obstacle->ntouched, ref) == obstacle->touched + obstacle->ntouched)
+		{
+			continue;
+		}
+		if (obstacle->type == DT_OBSTACLE_CYLINDER)
+		{
+			dtMarkCylinderArea(*layer, tile->header->bmin, params->cs, params->ch,
+							   obstacle->cylinder.pos, obstacle->cylinder.radius, obstacle->cylinder.height, 0);
+		}
+		else if (obstacle->type == DT_OBSTACLE_BOX)
+		{
+			std::unordered_map<dtObstacleRef, ConvexObstacle>::const_iterator convex = convex_obstacles.find(tile_cache->getObstacleRef(obstacle));
+			if (convex != convex_obstacles.end())
+			{
+				mark_convex_area(*layer, tile->header->bmin, params->cs, params->ch, convex->second.verts.data(),
+								 (int)convex->second.verts.size() / 3, convex->second.hmin, convex->second.hmax, 0);
+			}
+			else
+			{
+				dtMarkBoxArea(*layer, tile->header->bmin, params->cs, params->ch, obstacle->box.bmin, obstacle->box.bmax, 0);
+			}
+		}
+		else if (obstacle->type == DT_OBSTACLE_ORIENTED_BOX)
+		{
+			dtMarkBoxArea(*layer, tile->header->bmin, params->cs, params->ch,
+						  obstacle->orientedBox.center, obstacle->orientedBox.halfExtents, obstacle->orientedBox.rotAux, 0);
+		}
+	}
+
+	dtTileCacheContourSet *contours = nullptr;
+	dtTileCachePolyMesh *poly_mesh = nullptr;
+	if (dtStatusSucceed(dtBuildTileCacheRegions(worker.alloc, *layer, walkable_climb_vx)) &&
+		(contours = dtAllocTileCacheContourSet(worker.alloc)) != nullptr &&
+		dtStatusSucceed(dtBuildTileCacheContours(worker.alloc, *layer, walkable_climb_vx, params->maxSimplificationError, *contours)) &&
+		(poly_mesh = dtAllocTileCachePolyMesh(worker.alloc)) != nullptr &&
+		dtStatusSucceed(dtBuildTileCachePolyMesh(worker.alloc, *contours, *poly_mesh)))
+	{
+		/* An empty layer only removes the old tile */
+		build.success = true;
+		if (poly_mesh->npolys > 0)
+		{
+			dtNavMeshCreateParams create_params;
+			memset(&create_params, 0, sizeof(create_params));
+			create_params.verts = poly_mesh->verts;
+			create_params.vertCount = poly_mesh->nverts;
+			create_params.polys = poly_mesh->polys;
+			create_params.polyAreas = poly_mesh->areas;
+			create_params.polyFlags = poly_mesh->flags;
+			create_params.polyCount = poly_mesh->npolys;
+			create_params.nvp = DT_VERTS_PER_POLYGON;
+			create_params.walkableHeight = params->walkableHeight;
+			create_params.walkableRadius = params->walkableRadius;
+			create_params.walkableClimb = params->walkableClimb;
+			create_params.tileX = tile->header->tx;
+			create_params.tileY = tile->header->ty;
+			create_params.tileLayer = tile->header->tlayer;
+			create_params.cs = params->cs;
+			create_params.ch = params->ch;
+			create_params.buildBvTree = false;
+			dtVcopy(create_params.bmin, tile->header->bmin);
+			dtVcopy(create_params.bmax, tile->header->bmax);
+			worker.mesh_process->process(&create_params, poly_mesh->areas, poly_mesh->flags);
+			build.success = dtCreateNavMeshData(&create_params, &build.data, &build.data_size);
+		}
+	}
+	dtFreeTileCachePolyMesh(worker.alloc, poly_mesh);
+	dtFreeTileCacheContourSet(worker.alloc, contours);
+	dtFreeTileCacheLayer(worker.alloc, layer);
 }
 
-void DetourNavigationMeshCached::refresh_obstacle(CollisionShape *collision_shape)
+/**
+ * Lets dtTileCache process its queued requests and obstacle states without
+ * building tiles. The layers it would have built are recorded by the codec
+ * and added to pending_layers, unless they're pending already.
+ */
+void DetourNavigationMeshCached::collect_tile_updates()
 {
-	if (!dynamic_obstacles.has(collision_shape->get_instance_id()))
+	if (tile_cache == nullptr || tile_cache_compressor == nullptr)
 	{
 		return;
 	}
-	remove_obstacle(dynamic_obstacles[collision_shape->get_instance_id()]);
+	std::vector<const dtTileCacheLayerHeader *> headers;
+	tile_cache_compressor->deferred = &headers;
+	bool up_to_date = false;
+	while (!up_to_date)
+	{
+		tile_cache->update(0, get_detour_navmesh(), &up_to_date);
+	}
+	tile_cache_compressor->deferred = nullptr;
 
-	Transform transform = collision_shape->get_global_transform();
+	for (const dtTileCacheLayerHeader *header : headers)
+	{
+		queue_layer(header->tx, header->ty, header->tlayer);
+	}
+}
+
+/**
+ * Adds a layer to pending_layers, unless it's pending already
+ */
+void DetourNavigationMeshCached::queue_layer(int tx, int ty, int tlayer)
+{
+	for (const TileBuild &build : pending_layers)
+	{
+		if (build.tx == tx && build.ty == ty && build.tlayer == tlayer)
+		{
+			return;
+		}
+	}
+	TileBuild build;
+	build.tx = tx;
+	build.ty = ty;
+	build.tlayer = tlayer;
+	pending_layers.push_back(build);
+}
+
+/**
+ * Loading builds the navmesh tiles from the tile cache before the parent
+ * registers the off-mesh links, so the tiles links start in are built
+ * again once they're known.
+ */
+void DetourNavigationMeshCached::rebuild_offmesh_tiles()
+{
+	if (tile_cache == nullptr || generator == nullptr || generator->offmesh_ids.empty())
+	{
+		return;
+	}
+	generator->index_offmesh_links();
+	std::vector<dtCompressedTileRef> refs(std::max(navmesh_parameters->get_max_layers(), 1));
+	for (int x = 0; x < generator->get_num_tiles_x(); x++)
+	{
+		for (int z = 0; z < generator->get_num_tiles_z(); z++)
+		{
+			if (generator->offmesh_cells[x * generator->get_num_tiles_z() + z].empty())
+			{
+				continue;
+			}
+			int count = tile_cache->getTilesAt(x, z, refs.data(), (int)refs.size());
+			for (int i = 0; i < count; i++)
+			{
+				const dtCompressedTile *tile = tile_cache->getTileByRef(refs[i]);
+				if (tile != nullptr && tile->header != nullptr)
+				{
+					queue_layer(tile->header->tx, tile->header->ty, tile->header->tlayer);
+				}
+			}
+		}
+	}
+	build_pending_layers(UINT64_MAX);
+	tilecache_up_to_date = pending_layers.empty();
+}
 
-	Ref<Shape> s = collision_shape->get_shape();
-	int obst_id = 0;
-	if (s->get_class() == "BoxShape")
+/**
+ * Builds pending layers and swaps them into the navmesh. With
+ * parallel_tile_updates they're built on the tile workers in slices of one
+ * layer per worker while the main thread waits, otherwise here one after
+ * another. Either way until the budget is used up, at least once per call.
+ */
+void DetourNavigationMeshCached::build_pending_layers(uint64_t budget_usec)
+{
+	if (pending_layers.empty() || generator == nullptr || mesh_process == nullptr)
 	{
-		Ref<BoxShape> box = Object::cast_to<BoxShape>(*s);
-		obst_id = add_box_obstacle(
-			transform.get_origin(),
-			box->get_extents() * transform.get_basis().get_scale(),
-			transform.basis.orthonormalized().get_euler().y);
-		box.unref();
+		return;
 	}
-	else if (s->get_class() == "CylinderShape")
+	/* Off-mesh links are indexed lazily, builds only read the index */
+	if (!generator->offmesh_cells_valid)
 	{
-		Ref<CylinderShape> cylinder = Object::cast_to<CylinderShape>(*s);
-		obst_id = add_cylinder_obstacle(
-			transform.get_origin() - Vector3(0.f,
-											 cylinder->get_height() * 0.5f, 0.f),
-			cylinder->get_radius() * std::max(
-										 transform.get_basis().get_scale().x,
-										 transform.get_basis().get_scale().z),
-			cylinder->get_height() * transform.get_basis().get_scale().y);
-		cylinder.unref();
+		generator->index_offmesh_links();
+	}
+
+	uint64_t start = OS::get_singleton()->get_ticks_usec();
+	size_t count = 0;
+	if (parallel_tile_updates)
+	{
+		/* One layer per worker at a time, the budget is checked between slices */
+		start_tile_workers();
+		size_t slice = (size_t)tile_workers->get_thread_count();
+		do
+		{
+			size_t end = std::min(count + slice, pending_layers.size());
+			for (; count < end; count++)
+			{
+				TileBuild *build = &pending_layers[count];
+				tile_workers->push([this, build](int worker) {
+					build_tile_layer(*build, tile_worker_state[worker]);
+				});
+			}
+			tile_workers->wait_idle();
+		} while (count < pending_layers.size() && OS::get_singleton()->get_ticks_usec() - start < budget_usec);
 	}
 	else
 	{
-		dynamic_obstacles.erase(collision_shape->get_instance_id());
+		TileWorker main_thread;
+		main_thread.alloc = tile_cache_alloc;
+		main_thread.compressor = tile_cache_compressor;
+		main_thread.mesh_process = mesh_process;
+		do
+		{
+			build_tile_layer(pending_layers[count++], main_thread);
+		} while (count < pending_layers.size() && OS::get_singleton()->get_ticks_usec() - start < budget_usec);
+	}
+	uint64_t built = OS::get_singleton()->get_ticks_usec();
+
+	{
+		std::unique_lock<std::shared_mutex> guard(navmesh_lock);
+		dtNavMesh *navmesh = get_detour_navmesh();
+		for (size_t i = 0; i < count; i++)
+		{
+			TileBuild &build = pending_layers[i];
+			/* Like dtTileCache, a failed build keeps the old tile */
+			if (!build.success)
+			{
+				continue;
+			}
+			navmesh->removeTile(navmesh->getTileRefAt(build.tx, build.ty, build.tlayer), nullptr, nullptr);
+			if (build.data != nullptr && dtStatusFailed(navmesh->addTile(build.data, build.data_size, DT_TILE_FREE_DATA, 0, nullptr)))
+			{
+				dtFree(build.data);
+			}
+		}
+		islands.update(navmesh);
+		landmarks.update(navmesh);
+		replicas.mark_dirty();
+	}
+	pending_layers.erase(pending_layers.begin(), pending_layers.begin() + count);
+	debug_navmesh_dirty = true;
+
+	if (parallel_tile_updates && OS::get_singleton()->is_stdout_verbose())
+	{
+		std::string parallel_message = "Built " + std::to_string(count) + " tile cache layers on " + std::to_string(tile_workers->get_thread_count()) +
+									   " workers in " + std::to_string(built - start) + " us, swapped in " +
+									   std::to_string(OS::get_singleton()->get_ticks_usec() - built) + " us";
+		Godot::print(parallel_message.c_str());
 	}
-	s.unref();
-	dynamic_obstacles[collision_shape->get_instance_id()] = obst_id;
-}
\ No newline at end of file
+}
+
+/**
+ * Timing of the last recalculate_tiles per stage, the tile cache stage
+ * keeps growing until pending is false
+ */
+Dictionary DetourNavigationMeshCached::get_rebuild_stats()
+{
+	Dictionary stats;
+	stats["tiles"] = rebuild_stats.tiles;
+	stats["obstacles"] = rebuild_stats.obstacles;
+	stats["rasterize_usec"] = (int64_t)rebuild_stats.rasterize_usec;
+	stats["obstacles_usec"] = (int64_t)rebuild_stats.obstacles_usec;
+	stats["update_usec"] = (int64_t)rebuild_stats.update_usec;
+	stats["update_frames"] = rebuild_stats.update_frames;
+	stats["pending"] = rebuild_stats.pending;
+	return stats;
+}
+
+/**
+ * Codec of the tile cache with the bytes it compressed since the navmesh was
+ * baked or loaded, the bytes its tiles take now and the time spent
+ * decompressing them for obstacle updates
+ */
+Dictionary DetourNavigationMeshCached::get_compression_stats()
+{
+	Dictionary stats;
+	if (tile_cache == nullptr || tile_cache_compressor == nullptr)
+	{
+		return stats;
+	}
+	int64_t stored_bytes = 0;
+	for (int i = 0; i < tile_cache->getTileCount(); i++)
+	{
+		const dtCompressedTile *tile = tile_cache->getTile(i);
+		if (tile != nullptr && tile->header != nullptr)
+		{
+			stored_bytes += tile->dataSize;
+		}
+	}
+	stats["codec"] = (int)tile_cache_compressor->get_type();
+	stats["stored_bytes"] = stored_bytes;
+	stats["raw_bytes"] = (int64_t)tile_cache_compressor->raw_bytes.load();
+	stats["compressed_bytes"] = (int64_t)tile_cache_compressor->compressed_bytes.load();
+	/* Tile workers decompress with codecs of their own */
+	int64_t decompressions = (int64_t)tile_cache_compressor->decompressions.load();
+	int64_t decompress_usec = (int64_t)tile_cache_compressor->decompress_usec.load();
+	for (const TileWorker &worker : tile_worker_state)
+	{
+		decompressions += (int64_t)worker.compressor->decompressions.load();
+		decompress_usec += (int64_t)worker.compressor->decompress_usec.load();
+	}
+	stats["decompressions"] = decompressions;
+	stats["decompress_usec"] = decompress_usec;
+	return stats;
+}
+
+/**
+ * Scratch memory of building navmesh tiles from the tile cache, of the
+ * main thread and all tile workers: bytes reserved, the most one tile
+ * needed and how often it had to grow
+ */
+Dictionary DetourNavigationMeshCached::get_allocator_stats()
+{
+	Dictionary stats;
+	if (tile_cache_alloc == nullptr)
+	{
+		return stats;
+	}
+	/* Tile workers build with allocators of their own, reserved memory and grows add up */
+	size_t capacity = tile_cache_alloc->get_capacity();
+	size_t peak = tile_cache_alloc->get_peak();
+	size_t grows = tile_cache_alloc->grows;
+	for (const TileWorker &worker : tile_worker_state)
+	{
+		capacity += worker.alloc->get_capacity();
+		peak = std::max(peak, worker.alloc->get_peak());
+		grows += worker.alloc->grows;
+	}
+	stats["capacity"] = (int64_t)capacity;
+	stats["peak"] = (int64_t)peak;
+	stats["grows"] = (int64_t)grows;
+	return stats;
+}
+
+/**
+ * Places the affected obstacles again, as one batch
+ */
+void DetourNavigationMeshCached::refresh_obstacles()
+{
+	DetourNavigation *navigation = Object::cast_to<DetourNavigation>(get_parent());
+	if (navigation == nullptr || obstacles_to_refresh.empty())
+	{
+		return;
+	}
+	navigation->refresh_obstacles(this, obstacles_to_refresh);
+}
+
+/**
+ * Describes the obstacle of the shape again where it is now, every cached
+ * navmesh it belongs to picks it up on its next update
+ */
+void DetourNavigationMeshCached::refresh_obstacle(CollisionShape *collision_shape)
+{
+	DetourNavigation *navigation = Object::cast_to<DetourNavigation>(get_parent());
+	if (navigation == nullptr)
+	{
+		return;
+	}
+	navigation->update_obstacle(collision_shape);
+}
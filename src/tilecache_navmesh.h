@@ -1,8 +1,10 @@
 #ifndef TILECACHE_NAVMESH_H
 #define TILECACHE_NAVMESH_H
 
+#include <unordered_map>
 #include "navigation_mesh.h"
 #include "tilecache_generator.h"
+#include "obstacle_grid.h"
 
 namespace godot
 {
@@ -21,18 +23,25 @@ public:
 		return dynamic_collision_mask;
 	}
 
+	/* Tiles touched by obstacle changes are built on tile workers, only the swap into the navmesh stays on the main thread */
+	SETGET(parallel_tile_updates, bool);
+
 	DetourNavigationMeshCacheGenerator *generator = nullptr;
 	dtTileCache *tile_cache = nullptr;
-	dtTileCacheAlloc *tile_cache_alloc = nullptr;
-	dtTileCacheCompressor *tile_cache_compressor = nullptr;
+	ChunkedAllocator *tile_cache_alloc = nullptr;
+	TileCacheCompressor *tile_cache_compressor = nullptr;
 	NavMeshProcess *mesh_process = nullptr;
 	bool tilecache_up_to_date = true;
 
 	DetourNavigationMeshCached();
 	~DetourNavigationMeshCached();
 
-	Dictionary dynamic_obstacles;
-	std::vector<CollisionShape *> collision_shapes_to_refresh;
+	/* Owners of the obstacles on rebuilt tiles, placed again afterwards */
+	std::vector<int64_t> obstacles_to_refresh;
+	ObstacleGrid obstacle_grid;
+	/* Refs of the obstacles placed from the registry of DetourNavigation, by owner, and its serial they're up to date with */
+	std::unordered_map<int64_t, dtObstacleRef> obstacle_refs;
+	uint64_t obstacle_serial = 0;
 
 	void _init();
 	void _exit_tree();
@@ -87,13 +96,95 @@ public:
 	Ref<CachedNavmeshParameters> navmesh_parameters = nullptr;
 
 	std::vector<int> tile_queue;
-	std::vector<Vector3> offmesh_vertices;
-	std::vector<float> offmesh_radius;
-	std::vector<unsigned short> offmesh_flags;
-	std::vector<unsigned char> offmesh_areas;
-	std::vector<unsigned char> offmesh_dir;
 
-	void update_tilecache();
+	/* One obstacle change of a batch, ref is the result of adds and the input of removals */
+	struct ObstacleRequest
+	{
+		enum Type
+		{
+			ADD_BOX = 0,
+			ADD_CYLINDER = 1,
+			REMOVE = 2,
+			ADD_CONVEX = 3
+		};
+		Type type;
+		Vector3 position;
+		Vector3 extents;
+		float rotation = 0.f;
+		float radius = 0.f;
+		float height = 0.f;
+		/* Convex outline, x y z per point in order, from position.y up to height */
+		std::vector<float> footprint;
+		dtObstacleRef ref = 0;
+		/* Instance id of the collision shape, obstacles with an owner are kept in obstacle_grid */
+		int64_t owner = 0;
+	};
+
+	/**
+	 * Convex obstacles sit in the tile cache as boxes around their outline,
+	 * tile builds mark the outline instead of the box
+	 */
+	struct ConvexObstacle
+	{
+		std::vector<float> verts;
+		float hmin = 0.f;
+		float hmax = 0.f;
+	};
+	std::unordered_map<dtObstacleRef, ConvexObstacle> convex_obstacles;
+
+	PoolIntArray add_box_obstacles(PoolVector3Array positions, PoolVector3Array extents, PoolRealArray rotations);
+	PoolIntArray add_cylinder_obstacles(PoolVector3Array positions, PoolRealArray radii, PoolRealArray heights);
+	void remove_obstacles(PoolIntArray ids);
+	void apply_obstacle_batch(std::vector<ObstacleRequest> &requests, bool wait = true);
+	void drain_tile_cache();
+
+	/* Stages of the last recalculate_tiles */
+	struct RebuildStats
+	{
+		int tiles = 0;
+		int obstacles = 0;
+		uint64_t rasterize_usec = 0;
+		uint64_t obstacles_usec = 0;
+		uint64_t update_usec = 0;
+		int update_frames = 0;
+		/* Rebuilt tiles still wait for the tile cache update to be swapped in */
+		bool pending = false;
+	};
+	RebuildStats rebuild_stats;
+	Dictionary get_rebuild_stats();
+	Dictionary get_compression_stats();
+	Dictionary get_allocator_stats();
+
+	void update_tilecache(uint64_t budget_usec);
+
+	/* Scratch of one tile worker, so workers share nothing while building */
+	struct TileWorker
+	{
+		ChunkedAllocator *alloc = nullptr;
+		TileCacheCompressor *compressor = nullptr;
+		NavMeshProcess *mesh_process = nullptr;
+	};
+	/* One tile cache layer to build, data is handed to the navmesh on the main thread */
+	struct TileBuild
+	{
+		int tx = 0;
+		int ty = 0;
+		int tlayer = 0;
+		unsigned char *data = nullptr;
+		int data_size = 0;
+		bool success = false;
+	};
+	WorkerPool *tile_workers = nullptr;
+	std::vector<TileWorker> tile_worker_state;
+	void start_tile_workers();
+	void stop_tile_workers();
+	/* Layers the tile cache wants rebuilt, in the order it asked for them */
+	std::vector<TileBuild> pending_layers;
+	void build_tile_layer(TileBuild &build, TileWorker &worker);
+	void collect_tile_updates();
+	void queue_layer(int tx, int ty, int tlayer);
+	void rebuild_offmesh_tiles();
+	void build_pending_layers(uint64_t budget_usec);
 	void recalculate_tiles();
 	void refresh_obstacles();
 	void refresh_obstacle(CollisionShape *collision_shape);